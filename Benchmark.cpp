@@ -0,0 +1,92 @@
+#include "Benchmark.h"
+
+void BenchmarkRecorder::AddCpuTime(double milliseconds)
+{
+	m_CpuTimes.push_back(milliseconds);
+}
+
+void BenchmarkRecorder::AddGpuTime(double milliseconds)
+{
+	m_GpuTimes.push_back(milliseconds);
+}
+
+size_t BenchmarkRecorder::GetCpuFrameCount()
+{
+	return m_CpuTimes.size();
+}
+
+size_t BenchmarkRecorder::GetGpuFrameCount()
+{
+	return m_GpuTimes.size();
+}
+
+void BenchmarkRecorder::Clear()
+{
+	m_CpuTimes.clear();
+	m_GpuTimes.clear();
+}
+
+bool BenchmarkRecorder::Export(const std::string& path, double timeStep, uint32_t warmupFrames)
+{
+	std::ofstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "Benchmark export to " << path << " failed !" << '\n';
+		return false;
+	}
+
+	file << "{\n\t\"time_step_s\": " << timeStep << ",\n\t\"warmup_frames\": " << warmupFrames << ",\n";
+
+	WriteSeries(file, "cpu", m_CpuTimes);
+	file << ",\n";
+	WriteSeries(file, "gpu", m_GpuTimes);
+
+	file << "\n}\n";
+
+	return true;
+}
+
+void BenchmarkRecorder::WriteSeries(std::ofstream& file, const std::string& name, const std::vector<double>& samples)
+{
+	std::vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	double mean = 0.;
+	for (double sample : sorted)
+		mean += sample;
+	mean = sorted.empty() ? 0. : mean / static_cast<double>(sorted.size());
+
+	double minimum = sorted.empty() ? 0. : sorted.front();
+	double maximum = sorted.empty() ? 0. : sorted.back();
+	// A run of identical frames still gets a bin to land in
+	double binWidth = std::max((maximum - minimum) / BENCHMARK_HISTOGRAM_BINS, 1e-6);
+
+	std::vector<uint32_t> histogram(BENCHMARK_HISTOGRAM_BINS, 0);
+	for (double sample : sorted)
+		histogram[std::min(static_cast<size_t>((sample - minimum) / binWidth), histogram.size() - 1)]++;
+
+	file << "\t\"" << name << "\": {\n\t\t\"frames\": " << sorted.size() << ", \"mean_ms\": " << mean
+		<< ", \"p50_ms\": " << Percentile(sorted, 50.) << ", \"p95_ms\": " << Percentile(sorted, 95.) << ", \"p99_ms\": " << Percentile(sorted, 99.)
+		<< ", \"min_ms\": " << minimum << ", \"max_ms\": " << maximum << ",\n";
+
+	file << "\t\t\"histogram\": { \"start_ms\": " << minimum << ", \"bin_width_ms\": " << binWidth << ", \"counts\": [";
+	for (size_t i = 0; i < histogram.size(); i++)
+		file << (i > 0 ? ", " : "") << histogram[i];
+	file << "] },\n";
+
+	file << "\t\t\"samples\": [";
+	for (size_t i = 0; i < samples.size(); i++)
+		file << (i > 0 ? ", " : "") << samples[i];
+	file << "]\n\t}";
+}
+
+double BenchmarkRecorder::Percentile(const std::vector<double>& sorted, double percent)
+{
+	if (sorted.empty())
+		return 0.;
+
+	size_t rank = static_cast<size_t>(std::ceil(percent / 100. * static_cast<double>(sorted.size())));
+
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
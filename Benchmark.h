@@ -0,0 +1,39 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+
+// Equal width bins between the fastest and the slowest measured frame
+#define BENCHMARK_HISTOGRAM_BINS 32
+
+// Frame times of the measured frames of a benchmark run, the warm up is left to the caller
+class BenchmarkRecorder
+{
+public:
+	void AddCpuTime(double milliseconds);
+
+	// Spans of frames come back from the GPU a few frames late, in submission order
+	void AddGpuTime(double milliseconds);
+
+	size_t GetCpuFrameCount();
+
+	size_t GetGpuFrameCount();
+
+	void Clear();
+
+	// Mean, p50, p95, p99 and histogram of both series followed by their samples
+	bool Export(const std::string& path, double timeStep, uint32_t warmupFrames);
+
+private:
+	static void WriteSeries(std::ofstream& file, const std::string& name, const std::vector<double>& samples);
+
+	// Nearest rank on sorted samples
+	static double Percentile(const std::vector<double>& sorted, double percent);
+
+	std::vector<double> m_CpuTimes;
+	std::vector<double> m_GpuTimes;
+};
@@ -48,6 +48,16 @@ void Camera::SetAspect(double aspect)
     UpdateProjectionMatrix();
 }
 
+void Camera::LookAt(const glm::vec3& position, const glm::vec3& target)
+{
+    m_Position = position;
+    m_Forward = glm::normalize(target - position);
+    m_Left = glm::normalize(glm::cross(m_WorldUp, m_Forward));
+    m_Up = glm::cross(m_Forward, m_Left);
+
+    UpdateViewMatrix();
+}
+
 const glm::mat4& Camera::GetView()
 {
     return m_View;
@@ -63,6 +73,31 @@ const glm::vec3& Camera::GetPosition()
     return m_Position;
 }
 
+const glm::vec3& Camera::GetForward()
+{
+    return m_Forward;
+}
+
+double Camera::GetFov()
+{
+    return m_Fov;
+}
+
+double Camera::GetAspect()
+{
+    return m_Aspect;
+}
+
+double Camera::GetNear()
+{
+    return m_Near;
+}
+
+double Camera::GetFar()
+{
+    return m_Far;
+}
+
 float* Camera::GetSpeed()
 {
     return &m_Speed;
@@ -35,9 +35,18 @@ public:
 	void SetSpeed(float speed);
 	void SetAspect(double aspect);
 
+	// Place the camera from a script, the next mouse move starts again from the accumulated yaw and pitch
+	void LookAt(const glm::vec3& position, const glm::vec3& target);
+
 	const glm::mat4& GetView();
 	const glm::mat4& GetProjection();
 	const glm::vec3& GetPosition();
+	const glm::vec3& GetForward();
+
+	double GetFov();
+	double GetAspect();
+	double GetNear();
+	double GetFar();
 
 	float* GetSpeed();
 
@@ -0,0 +1,165 @@
+#include "CameraPath.h"
+#include "json.hpp"
+#include <algorithm>
+#include <fstream>
+
+bool CameraPath::Load(const std::string& path)
+{
+	std::ifstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "Camera path " << path << " opening failed !" << '\n';
+		return false;
+	}
+
+	nlohmann::json document = nlohmann::json::parse(file, nullptr, false);
+
+	if (document.is_discarded() || !document.contains("keyframes") || !document["keyframes"].is_array())
+	{
+		std::cout << "Camera path " << path << " parsing failed !" << '\n';
+		return false;
+	}
+
+	m_Keyframes.clear();
+
+	for (const auto& entry : document["keyframes"])
+	{
+		const auto& position = entry.value("position", nlohmann::json::array());
+		const auto& target = entry.value("target", nlohmann::json::array());
+
+		if (position.size() != 3 || target.size() != 3)
+		{
+			std::cout << "Camera path " << path << " keyframe without position or target skipped !" << '\n';
+			continue;
+		}
+
+		CameraKeyframe keyframe;
+		keyframe.time = entry.value("time", 0.);
+		keyframe.position = glm::vec3(position[0].get<float>(), position[1].get<float>(), position[2].get<float>());
+		keyframe.target = glm::vec3(target[0].get<float>(), target[1].get<float>(), target[2].get<float>());
+
+		AddKeyframe(keyframe);
+	}
+
+	return !m_Keyframes.empty();
+}
+
+bool CameraPath::Save(const std::string& path)
+{
+	std::ofstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "Camera path " << path << " saving failed !" << '\n';
+		return false;
+	}
+
+	nlohmann::json keyframes = nlohmann::json::array();
+
+	for (const CameraKeyframe& keyframe : m_Keyframes)
+	{
+		keyframes.push_back({
+			{ "time", keyframe.time },
+			{ "position", { keyframe.position.x, keyframe.position.y, keyframe.position.z } },
+			{ "target", { keyframe.target.x, keyframe.target.y, keyframe.target.z } }
+		});
+	}
+
+	nlohmann::json document;
+	document["keyframes"] = keyframes;
+
+	file << document.dump(4) << '\n';
+
+	return true;
+}
+
+void CameraPath::AddKeyframe(const CameraKeyframe& keyframe)
+{
+	auto position = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), keyframe.time, [](double time, const CameraKeyframe& k) { return time < k.time; });
+	m_Keyframes.insert(position, keyframe);
+}
+
+void CameraPath::Clear()
+{
+	m_Keyframes.clear();
+}
+
+bool CameraPath::IsEmpty()
+{
+	return m_Keyframes.empty();
+}
+
+size_t CameraPath::GetKeyframeCount()
+{
+	return m_Keyframes.size();
+}
+
+double CameraPath::GetDuration()
+{
+	if (m_Keyframes.empty())
+		return 0.;
+
+	return m_Keyframes.back().time - m_Keyframes.front().time;
+}
+
+void CameraPath::Evaluate(double time, glm::vec3& position, glm::vec3& target)
+{
+	if (m_Keyframes.empty())
+		return;
+
+	time = std::clamp(m_Keyframes.front().time + time, m_Keyframes.front().time, m_Keyframes.back().time);
+
+	// Last keyframe starting at or before time
+	auto next = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), time, [](double t, const CameraKeyframe& k) { return t < k.time; });
+	size_t i = next == m_Keyframes.begin() ? 0 : static_cast<size_t>(next - m_Keyframes.begin()) - 1;
+
+	if (i + 1 >= m_Keyframes.size())
+	{
+		position = m_Keyframes.back().position;
+		target = m_Keyframes.back().target;
+		return;
+	}
+
+	std::vector<glm::vec3> points(m_Keyframes.size());
+	std::vector<double> times(m_Keyframes.size());
+
+	for (size_t k = 0; k < m_Keyframes.size(); k++)
+	{
+		points[k] = m_Keyframes[k].position;
+		times[k] = m_Keyframes[k].time;
+	}
+	position = Interpolate(points.data(), times.data(), points.size(), i, time);
+
+	for (size_t k = 0; k < m_Keyframes.size(); k++)
+		points[k] = m_Keyframes[k].target;
+	target = Interpolate(points.data(), times.data(), points.size(), i, time);
+}
+
+glm::vec3 CameraPath::Interpolate(const glm::vec3* points, const double* times, size_t count, size_t i, double time)
+{
+	double duration = times[i + 1] - times[i];
+
+	if (duration <= 0.)
+		return points[i + 1];
+
+	// Velocities at both ends, one sided on the first and last keyframe
+	auto tangent = [&](size_t k)
+	{
+		size_t previous = k > 0 ? k - 1 : k;
+		size_t following = k + 1 < count ? k + 1 : k;
+		double span = times[following] - times[previous];
+		return span > 0. ? (points[following] - points[previous]) / static_cast<float>(span) : glm::vec3(0.);
+	};
+
+	float u = static_cast<float>((time - times[i]) / duration);
+	float u2 = u * u;
+	float u3 = u2 * u;
+
+	float h00 = 2.f * u3 - 3.f * u2 + 1.f;
+	float h10 = u3 - 2.f * u2 + u;
+	float h01 = -2.f * u3 + 3.f * u2;
+	float h11 = u3 - u2;
+
+	return h00 * points[i] + h10 * static_cast<float>(duration) * tangent(i) + h01 * points[i + 1] + h11 * static_cast<float>(duration) * tangent(i + 1);
+}
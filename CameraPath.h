@@ -0,0 +1,44 @@
+#pragma once
+
+#include "VkGLM.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct CameraKeyframe
+{
+	// Seconds from the start of the path
+	double time = 0.;
+	glm::vec3 position = glm::vec3(0.);
+	glm::vec3 target = glm::vec3(0.);
+};
+
+// Camera spline replayed by the benchmark, stored as
+// { "keyframes": [ { "time": 0.0, "position": [x, y, z], "target": [x, y, z] }, ... ] }
+class CameraPath
+{
+public:
+	bool Load(const std::string& path);
+
+	bool Save(const std::string& path);
+
+	// Keyframes are kept sorted by time
+	void AddKeyframe(const CameraKeyframe& keyframe);
+
+	void Clear();
+
+	bool IsEmpty();
+
+	size_t GetKeyframeCount();
+
+	double GetDuration();
+
+	// Catmull-Rom through the keyframes, time is clamped to the path
+	void Evaluate(double time, glm::vec3& position, glm::vec3& target);
+
+private:
+	// Hermite segment between keyframes i and i + 1, tangents from the neighbouring keyframes so uneven spacing keeps its speed
+	static glm::vec3 Interpolate(const glm::vec3* points, const double* times, size_t count, size_t i, double time);
+
+	std::vector<CameraKeyframe> m_Keyframes;
+};
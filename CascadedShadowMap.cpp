@@ -0,0 +1,349 @@
+#include "CascadedShadowMap.h"
+#include "VulkanUtils.h"
+
+// Mix between logarithmic and uniform splits (practical split scheme)
+constexpr float cascadeSplitLambda = 0.75f;
+
+CascadedShadowMap::CascadedShadowMap(VkPhysicalDevice physicalDevice, VkDevice device, VmaAllocator allocator, uint32_t graphicsFamily, uint32_t resolution, VkDescriptorSetLayout perMeshLayout)
+{
+    m_Resolution = resolution;
+
+    CreateShadowImage(physicalDevice, device, allocator, graphicsFamily);
+    CreateSampler(device);
+    CreatePipeline(device, perMeshLayout);
+}
+
+void CascadedShadowMap::CreateShadowImage(VkPhysicalDevice physicalDevice, VkDevice device, VmaAllocator allocator, uint32_t graphicsFamily)
+{
+    m_DepthFormat = Image::findSupportedFormat(physicalDevice, { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+    m_ShadowImage.CreateImage(allocator, m_Resolution, m_Resolution, m_DepthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { graphicsFamily }, 1, SHADOW_CASCADE_COUNT);
+    m_ShadowImage.CreateImageView(device, m_DepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+    {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_ShadowImage.GetImage();
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = m_DepthFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = i;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &viewInfo, nullptr, &m_CascadeImageViews[i]) != VK_SUCCESS)
+            std::cout << "Shadow cascade image view creation failed !" << '\n';
+    }
+}
+
+void CascadedShadowMap::CreateSampler(VkDevice device)
+{
+    // Hardware depth comparison, the linear filter gives a bilinear PCF per tap
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = 1.f;
+    samplerInfo.maxAnisotropy = 1.f;
+
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS)
+        std::cout << "Shadow sampler creation failed !" << '\n';
+}
+
+void CascadedShadowMap::CreatePipeline(VkDevice device, VkDescriptorSetLayout perMeshLayout)
+{
+    Shader vertexShader;
+    vertexShader.createModule(device, ".\\Shader\\shadowDepthVert.spv");
+
+    VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo;
+    vertexShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertexShaderStageCreateInfo.pNext = NULL;
+    vertexShaderStageCreateInfo.flags = 0;
+    vertexShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertexShaderStageCreateInfo.module = vertexShader.getShaderModule();
+    vertexShaderStageCreateInfo.pName = "main";
+    vertexShaderStageCreateInfo.pSpecializationInfo = NULL;
+
+    // Only the position is read, the mesh vertex buffers are bound as they are
+    auto vertexInputBindingDescription = Vertex::getVertexInputBindingDescription();
+    auto vertexInputAttributeDescription = Vertex::getVertexInputAttributeDescription();
+
+    VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo{};
+    pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+    pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexInputBindingDescription;
+    pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = 1;
+    pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = &vertexInputAttributeDescription[0];
+
+    VkPipelineInputAssemblyStateCreateInfo pipelineInputAssemblyStateCreateInfo{};
+    pipelineInputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    pipelineInputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    pipelineInputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo{};
+    pipelineViewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    pipelineViewportStateCreateInfo.viewportCount = 1;
+    pipelineViewportStateCreateInfo.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo{};
+    pipelineRasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    pipelineRasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
+    pipelineRasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    pipelineRasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    pipelineRasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;
+    pipelineRasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    pipelineRasterizationStateCreateInfo.depthBiasEnable = VK_TRUE;
+    pipelineRasterizationStateCreateInfo.depthBiasConstantFactor = 1.25f;
+    pipelineRasterizationStateCreateInfo.depthBiasClamp = 0.0f;
+    pipelineRasterizationStateCreateInfo.depthBiasSlopeFactor = 1.75f;
+    pipelineRasterizationStateCreateInfo.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo pipelineMultisampleStateCreateInfo{};
+    pipelineMultisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    pipelineMultisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo pipelineDepthStencilStateCreateInfo{};
+    pipelineDepthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    pipelineDepthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    pipelineDepthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+    pipelineDepthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineDepthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    pipelineDepthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo{};
+    pipelineColorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    pipelineColorBlendStateCreateInfo.attachmentCount = 0;
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo{};
+    pipelineDynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    pipelineDynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    pipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(glm::mat4);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &perMeshLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &m_PipelineLayout) != VK_SUCCESS)
+        std::cout << "Shadow pipeline layout creation failed !" << '\n';
+
+    VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
+    pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    pipelineRenderingCreateInfo.colorAttachmentCount = 0;
+    pipelineRenderingCreateInfo.depthAttachmentFormat = m_DepthFormat;
+
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    graphicsPipelineCreateInfo.pNext = &pipelineRenderingCreateInfo;
+    graphicsPipelineCreateInfo.stageCount = 1;
+    graphicsPipelineCreateInfo.pStages = &vertexShaderStageCreateInfo;
+    graphicsPipelineCreateInfo.pVertexInputState = &pipelineVertexInputStateCreateInfo;
+    graphicsPipelineCreateInfo.pInputAssemblyState = &pipelineInputAssemblyStateCreateInfo;
+    graphicsPipelineCreateInfo.pViewportState = &pipelineViewportStateCreateInfo;
+    graphicsPipelineCreateInfo.pRasterizationState = &pipelineRasterizationStateCreateInfo;
+    graphicsPipelineCreateInfo.pMultisampleState = &pipelineMultisampleStateCreateInfo;
+    graphicsPipelineCreateInfo.pDepthStencilState = &pipelineDepthStencilStateCreateInfo;
+    graphicsPipelineCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
+    graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
+    graphicsPipelineCreateInfo.layout = m_PipelineLayout;
+    graphicsPipelineCreateInfo.renderPass = VK_NULL_HANDLE;
+    graphicsPipelineCreateInfo.subpass = 0;
+    graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    graphicsPipelineCreateInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, NULL, &m_Pipeline) != VK_SUCCESS)
+        std::cout << "Shadow pipeline creation failed !" << '\n';
+
+    vertexShader.cleanup(device);
+}
+
+void CascadedShadowMap::Update(Camera* camera, const glm::vec3& lightDirection, float shadowDistance)
+{
+    float nearClip = static_cast<float>(camera->GetNear());
+    float farClip = std::min(static_cast<float>(camera->GetFar()), shadowDistance);
+    float ratio = farClip / nearClip;
+    float range = farClip - nearClip;
+
+    float tanHalfFovY = static_cast<float>(tan(glm::radians(camera->GetFov()) * 0.5));
+    float tanHalfFovX = tanHalfFovY * static_cast<float>(camera->GetAspect());
+
+    glm::mat4 invView = glm::inverse(camera->GetView());
+
+    glm::vec3 L = glm::normalize(lightDirection);
+    glm::vec3 up = abs(L.y) > 0.9f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+
+    float lastSplit = nearClip;
+
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+    {
+        float p = static_cast<float>(i + 1) / static_cast<float>(SHADOW_CASCADE_COUNT);
+        float logSplit = nearClip * std::pow(ratio, p);
+        float uniformSplit = nearClip + range * p;
+        float split = cascadeSplitLambda * logSplit + (1.f - cascadeSplitLambda) * uniformSplit;
+
+        std::array<glm::vec3, 8> corners;
+        for (uint32_t c = 0; c < 8; c++)
+        {
+            float depth = (c < 4) ? lastSplit : split;
+            float x = ((c & 1) ? 1.f : -1.f) * depth * tanHalfFovX;
+            float y = ((c & 2) ? 1.f : -1.f) * depth * tanHalfFovY;
+            corners[c] = glm::vec3(invView * glm::vec4(x, y, -depth, 1.f));
+        }
+
+        glm::vec3 center = glm::vec3(0.f);
+        for (const auto& corner : corners)
+            center += corner;
+        center /= 8.f;
+
+        // Bounding sphere so the cascade size does not change when the camera rotates
+        float radius = 0.f;
+        for (const auto& corner : corners)
+            radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        // Casters behind the camera frustum still have to land in the map
+        float casterDistance = radius + shadowDistance;
+
+        glm::mat4 lightView = glm::lookAt(center - L * casterDistance, center, up);
+        glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.f, casterDistance + radius);
+
+        // Snap to texel increments to avoid shimmering while the camera moves
+        glm::mat4 viewProjection = lightProjection * lightView;
+        glm::vec4 origin = viewProjection * glm::vec4(0.f, 0.f, 0.f, 1.f) * (static_cast<float>(m_Resolution) * 0.5f);
+        glm::vec4 offset = (glm::round(origin) - origin) * (2.f / static_cast<float>(m_Resolution));
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+
+        m_ViewProjections[i] = lightProjection * lightView;
+        m_Splits[i] = split;
+        m_TexelSizes[i] = 2.f * radius / static_cast<float>(m_Resolution);
+
+        lastSplit = split;
+    }
+}
+
+void CascadedShadowMap::RecordCmdDraw(VkCommandBuffer commandBuffer, const std::vector<Mesh*>& meshes, VkDescriptorSet perMeshDescriptorSet, uint32_t modelsOffset)
+{
+    VkClearValue clearValue{};
+    clearValue.depthStencil = { 1.0f, 0 };
+
+    VkViewport viewport;
+    viewport.x = 0.0;
+    viewport.y = 0.0;
+    viewport.width = static_cast<float>(m_Resolution);
+    viewport.height = static_cast<float>(m_Resolution);
+    viewport.minDepth = 0.0;
+    viewport.maxDepth = 1.f;
+
+    VkRect2D scissor;
+    scissor.offset = { 0, 0 };
+    scissor.extent = { m_Resolution, m_Resolution };
+
+    for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++)
+    {
+        VkRenderingAttachmentInfo depthAttachment = VulkanUtils::RenderingAttachmentInfo(m_CascadeImageViews[cascade], VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, clearValue);
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = { m_Resolution, m_Resolution };
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 0;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
+        vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &m_ViewProjections[cascade]);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &perMeshDescriptorSet, 1, &modelsOffset);
+
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            auto mesh = meshes[i];
+
+            if (!mesh->IsOccluder())
+                continue;
+
+            mesh->BindVertexBuffer(commandBuffer);
+            mesh->BindIndexBuffer(commandBuffer);
+
+            const std::vector<Primitive>& primitives = mesh->GetPrimitives();
+
+            // The first instance indexes the model matrices, as in the G-buffer pass. Same level as the camera sees, the
+            // shadow matches the occluder
+            for (size_t j = 0; j < primitives.size(); j++)
+            {
+                PrimitiveLod lod = mesh->GetPrimitiveLod(j, mesh->GetLod());
+                vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, static_cast<int32_t>(primitives[j].vertexOffset), static_cast<uint32_t>(i));
+            }
+        }
+
+        vkCmdEndRendering(commandBuffer);
+    }
+}
+
+const std::array<glm::mat4, SHADOW_CASCADE_COUNT>& CascadedShadowMap::GetViewProjections()
+{
+    return m_ViewProjections;
+}
+
+const glm::vec4& CascadedShadowMap::GetSplits()
+{
+    return m_Splits;
+}
+
+const glm::vec4& CascadedShadowMap::GetTexelSizes()
+{
+    return m_TexelSizes;
+}
+
+VkImage CascadedShadowMap::GetImage()
+{
+    return m_ShadowImage.GetImage();
+}
+
+VkImageView CascadedShadowMap::GetImageView()
+{
+    return m_ShadowImage.GetImageView();
+}
+
+VkSampler CascadedShadowMap::GetSampler()
+{
+    return m_Sampler;
+}
+
+void CascadedShadowMap::Cleanup(VkDevice device, VmaAllocator allocator)
+{
+    vkDestroyPipeline(device, m_Pipeline, NULL);
+    vkDestroyPipelineLayout(device, m_PipelineLayout, NULL);
+
+    vkDestroySampler(device, m_Sampler, NULL);
+
+    for (auto imageView : m_CascadeImageViews)
+        vkDestroyImageView(device, imageView, NULL);
+
+    m_ShadowImage.Cleanup(allocator, device);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include "Image.h"
+#include "Mesh.h"
+#include "Camera.h"
+#include "Shader.h"
+#include <array>
+
+#define SHADOW_CASCADE_COUNT 4
+
+class CascadedShadowMap
+{
+public:
+
+    CascadedShadowMap(VkPhysicalDevice physicalDevice, VkDevice device, VmaAllocator allocator, uint32_t graphicsFamily, uint32_t resolution, VkDescriptorSetLayout perMeshLayout);
+
+    // Fit the cascades to the camera frustum, clamped to shadowDistance
+    void Update(Camera* camera, const glm::vec3& lightDirection, float shadowDistance);
+
+    // Every cascade layer is expected in DEPTH_STENCIL_ATTACHMENT_OPTIMAL, the render graph transitions the image
+    void RecordCmdDraw(VkCommandBuffer commandBuffer, const std::vector<Mesh*>& meshes, VkDescriptorSet perMeshDescriptorSet, uint32_t modelsOffset);
+
+    const std::array<glm::mat4, SHADOW_CASCADE_COUNT>& GetViewProjections();
+
+    const glm::vec4& GetSplits();
+
+    const glm::vec4& GetTexelSizes();
+
+    VkImage GetImage();
+
+    VkImageView GetImageView();
+
+    VkSampler GetSampler();
+
+    void Cleanup(VkDevice device, VmaAllocator allocator);
+
+private:
+
+    void CreateShadowImage(VkPhysicalDevice physicalDevice, VkDevice device, VmaAllocator allocator, uint32_t graphicsFamily);
+
+    void CreateSampler(VkDevice device);
+
+    void CreatePipeline(VkDevice device, VkDescriptorSetLayout perMeshLayout);
+
+    uint32_t m_Resolution;
+    VkFormat m_DepthFormat = VK_FORMAT_UNDEFINED;
+
+    Image m_ShadowImage;
+    std::array<VkImageView, SHADOW_CASCADE_COUNT> m_CascadeImageViews{};
+    VkSampler m_Sampler = VK_NULL_HANDLE;
+
+    VkPipeline m_Pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> m_ViewProjections{};
+    glm::vec4 m_Splits = glm::vec4(0.f);
+    glm::vec4 m_TexelSizes = glm::vec4(0.f);
+};
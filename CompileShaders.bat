@@ -7,6 +7,16 @@
 .\glslc.exe .\Shader\cubeMapShader.vert -o .\Shader\cubeMapVert.spv
 .\glslc.exe .\Shader\cubeMapShader.frag -o .\Shader\cubeMapFrag.spv
 
+.\glslc.exe .\Shader\shadowDepth.vert -o .\Shader\shadowDepthVert.spv
+
+.\glslc.exe --target-env=vulkan1.3 .\Shader\meshlet.task -o .\Shader\meshletTask.spv
+.\glslc.exe --target-env=vulkan1.3 .\Shader\meshlet.mesh -o .\Shader\meshletMesh.spv
+
+.\glslc.exe .\Shader\skinning.comp -o .\Shader\skinning.spv
+
+.\glslc.exe .\Shader\deferredLighting.comp -o .\Shader\deferredLighting.spv
+.\glslc.exe --target-env=vulkan1.2 -DRAY_QUERY .\Shader\deferredLighting.comp -o .\Shader\deferredLightingRayQuery.spv
+
 .\glslangValidator.exe -V --target-env vulkan1.2 .\Shader\raygen.rgen -o .\Shader\raygen.spv
 .\glslangValidator.exe -V --target-env vulkan1.2 .\Shader\miss.rmiss -o .\Shader\miss.spv
 .\glslangValidator.exe -V --target-env vulkan1.2 .\Shader\closesthit.rchit -o .\Shader\closesthit.spv
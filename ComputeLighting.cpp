@@ -0,0 +1,187 @@
+#include "ComputeLighting.h"
+
+ComputeLighting::ComputeLighting(VkDevice device, const std::vector<VkImageView>& imageViews, const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkAccelerationStructureKHR>& topLevelASs)
+{
+    CreateDescriptorSets(device, imageViews, topLevelASs);
+    CreateComputePipelineLayout(device, layouts);
+
+    m_ComputePipeline = CreateComputePipeline(device, ".\\Shader\\deferredLighting.spv");
+
+    if (!topLevelASs.empty())
+        m_RayQueryPipeline = CreateComputePipeline(device, ".\\Shader\\deferredLightingRayQuery.spv");
+}
+
+void ComputeLighting::BindPipeline(VkCommandBuffer commandBuffer, bool rayQuery)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rayQuery ? m_RayQueryPipeline : m_ComputePipeline);
+}
+
+void ComputeLighting::BindOutputDescriptorSet(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipelineLayout, 0, 1, &m_OutputDescriptor.GetDescriptorSets()[imageIndex], 0, 0);
+}
+
+void ComputeLighting::RecordCmdDispatch(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height)
+{
+    uint32_t groupCountX = (width + LIGHTING_TILE_SIZE - 1) / LIGHTING_TILE_SIZE;
+    uint32_t groupCountY = (height + LIGHTING_TILE_SIZE - 1) / LIGHTING_TILE_SIZE;
+
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
+
+void ComputeLighting::CreateDescriptorSets(VkDevice device, const std::vector<VkImageView>& imageViews, const std::vector<VkAccelerationStructureKHR>& topLevelASs)
+{
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+
+    VkDescriptorSetLayoutBinding resultImageLayoutBinding{};
+    resultImageLayoutBinding.binding = 0;
+    resultImageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    resultImageLayoutBinding.descriptorCount = 1;
+    resultImageLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings.push_back(resultImageLayoutBinding);
+
+    std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
+
+    VkDescriptorPoolSize descriptorPoolSize;
+    descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorPoolSize.descriptorCount = static_cast<uint32_t>(imageViews.size());
+    descriptorPoolSizes.push_back(descriptorPoolSize);
+
+    if (!topLevelASs.empty())
+    {
+        VkDescriptorSetLayoutBinding accelerationStructureLayoutBinding{};
+        accelerationStructureLayoutBinding.binding = 1;
+        accelerationStructureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        accelerationStructureLayoutBinding.descriptorCount = 1;
+        accelerationStructureLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        layoutBindings.push_back(accelerationStructureLayoutBinding);
+
+        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        descriptorPoolSize.descriptorCount = static_cast<uint32_t>(imageViews.size());
+        descriptorPoolSizes.push_back(descriptorPoolSize);
+    }
+
+    m_OutputDescriptor.CreateDescriptorSetLayout(device, layoutBindings, 0);
+
+    m_OutputDescriptor.CreateDescriptorPool(device, descriptorPoolSizes, static_cast<uint32_t>(imageViews.size()));
+
+    std::vector<VkDescriptorSetLayout> layouts;
+    layouts.assign(imageViews.size(), m_OutputDescriptor.GetDescriptorSetLayout());
+
+    m_OutputDescriptor.AllocateDescriptorSet(device, layouts);
+
+    UpdateImageDescriptor(device, imageViews);
+
+    std::vector<VkDescriptorSet> descriptorSets = m_OutputDescriptor.GetDescriptorSets();
+
+    for (size_t i = 0; i < topLevelASs.size() && i < descriptorSets.size(); i++)
+    {
+        VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo{};
+        descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+        descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+        descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelASs[i];
+
+        VkWriteDescriptorSet accelerationStructureWrite{};
+        accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+        accelerationStructureWrite.dstSet = descriptorSets[i];
+        accelerationStructureWrite.dstBinding = 1;
+        accelerationStructureWrite.descriptorCount = 1;
+        accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+        vkUpdateDescriptorSets(device, 1, &accelerationStructureWrite, 0, VK_NULL_HANDLE);
+    }
+}
+
+void ComputeLighting::CreateComputePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& layouts)
+{
+    std::vector<VkDescriptorSetLayout> computePipelineLayouts;
+    computePipelineLayouts.reserve(layouts.size() + 1);
+
+    computePipelineLayouts.emplace_back(m_OutputDescriptor.GetDescriptorSetLayout());
+    for (const auto& layout : layouts)
+        computePipelineLayouts.emplace_back(layout);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+    pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCI.setLayoutCount = static_cast<uint32_t>(computePipelineLayouts.size());
+    pipelineLayoutCI.pSetLayouts = computePipelineLayouts.data();
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &m_ComputePipelineLayout) != VK_SUCCESS)
+        std::cout << "Compute lighting pipeline layout creation failed !" << '\n';
+}
+
+VkPipeline ComputeLighting::CreateComputePipeline(VkDevice device, const std::string& shaderPath)
+{
+    Shader computeShader;
+    computeShader.createModule(device, shaderPath);
+
+    VkPipelineShaderStageCreateInfo computeShaderStageCreateInfo;
+    computeShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeShaderStageCreateInfo.pNext = NULL;
+    computeShaderStageCreateInfo.flags = 0;
+    computeShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeShaderStageCreateInfo.module = computeShader.getShaderModule();
+    computeShaderStageCreateInfo.pName = "main";
+    computeShaderStageCreateInfo.pSpecializationInfo = NULL;
+
+    VkComputePipelineCreateInfo computePipelineCI{};
+    computePipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineCI.stage = computeShaderStageCreateInfo;
+    computePipelineCI.layout = m_ComputePipelineLayout;
+
+    VkPipeline computePipeline = VK_NULL_HANDLE;
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr, &computePipeline) != VK_SUCCESS)
+        std::cout << "Compute lighting pipeline creation failed !" << '\n';
+
+    computeShader.cleanup(device);
+
+    return computePipeline;
+}
+
+void ComputeLighting::UpdateImageDescriptor(VkDevice device, const std::vector<VkImageView>& imageViews)
+{
+    for (size_t i = 0; i < imageViews.size(); i++)
+        UpdateImageDescriptor(device, imageViews[i], static_cast<uint32_t>(i));
+}
+
+void ComputeLighting::UpdateImageDescriptor(VkDevice device, VkImageView imageView, uint32_t frame)
+{
+    VkDescriptorImageInfo descriptorImageInfo{};
+    descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    descriptorImageInfo.imageView = imageView;
+    descriptorImageInfo.sampler = VK_NULL_HANDLE;
+
+    VkWriteDescriptorSet descriptorSetWrite{};
+    descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSetWrite.pNext = NULL;
+    descriptorSetWrite.dstSet = m_OutputDescriptor.GetDescriptorSets()[frame];
+    descriptorSetWrite.dstBinding = 0;
+    descriptorSetWrite.descriptorCount = 1;
+    descriptorSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorSetWrite.pImageInfo = &descriptorImageInfo;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorSetWrite, 0, VK_NULL_HANDLE);
+}
+
+VkPipelineLayout ComputeLighting::GetComputePipelineLayout()
+{
+    return m_ComputePipelineLayout;
+}
+
+bool ComputeLighting::HasRayQueryPipeline()
+{
+    return m_RayQueryPipeline != VK_NULL_HANDLE;
+}
+
+void ComputeLighting::Cleanup(VkDevice device)
+{
+    vkDestroyPipeline(device, m_ComputePipeline, NULL);
+    if (m_RayQueryPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, m_RayQueryPipeline, NULL);
+    vkDestroyPipelineLayout(device, m_ComputePipelineLayout, NULL);
+
+    m_OutputDescriptor.DestroyDescriptorPool(device);
+    m_OutputDescriptor.DestroyDescriptorSetLayout(device);
+}
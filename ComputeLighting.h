@@ -0,0 +1,46 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include "Descriptor.h"
+#include "Shader.h"
+
+#define LIGHTING_TILE_SIZE 16
+
+class ComputeLighting
+{
+public:
+
+    // topLevelASs: one per output image, empty when ray queries are not supported
+    ComputeLighting(VkDevice device, const std::vector<VkImageView>& imageViews, const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkAccelerationStructureKHR>& topLevelASs = {});
+
+    void BindPipeline(VkCommandBuffer commandBuffer, bool rayQuery = false);
+
+    void BindOutputDescriptorSet(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    void RecordCmdDispatch(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height);
+
+    void UpdateImageDescriptor(VkDevice device, const std::vector<VkImageView>& imageViews);
+
+    // Only the frame's set, the other frames' sets may still be in use
+    void UpdateImageDescriptor(VkDevice device, VkImageView imageView, uint32_t frame);
+
+    VkPipelineLayout GetComputePipelineLayout();
+
+    bool HasRayQueryPipeline();
+
+    void Cleanup(VkDevice device);
+
+private:
+
+    void CreateDescriptorSets(VkDevice device, const std::vector<VkImageView>& imageViews, const std::vector<VkAccelerationStructureKHR>& topLevelASs);
+
+    void CreateComputePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& layouts);
+
+    VkPipeline CreateComputePipeline(VkDevice device, const std::string& shaderPath);
+
+    Descriptor m_OutputDescriptor;
+
+    VkPipeline m_ComputePipeline = VK_NULL_HANDLE;
+    VkPipeline m_RayQueryPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_ComputePipelineLayout = VK_NULL_HANDLE;
+};
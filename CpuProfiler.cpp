@@ -0,0 +1,104 @@
+#include "CpuProfiler.h"
+
+std::atomic<bool> CpuProfiler::s_Enabled{ false };
+std::mutex CpuProfiler::s_ThreadsMutex;
+std::vector<CpuProfiler::ThreadBuffer*> CpuProfiler::s_Threads;
+
+static const std::chrono::steady_clock::time_point s_Origin = std::chrono::steady_clock::now();
+
+void CpuProfiler::SetEnabled(bool enabled)
+{
+	s_Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void CpuProfiler::SetThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+	buffer.name = name;
+}
+
+int64_t CpuProfiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_Origin).count();
+}
+
+void CpuProfiler::AddZone(const char* name, int64_t begin, int64_t end)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	// Single writer, the index is published once the slot is filled
+	uint64_t written = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[written % CPU_PROFILER_RING_SIZE] = { name, begin, end };
+	buffer.written.store(written + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::ExportChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "CPU trace export to " << path << " failed !" << '\n';
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+
+	file << "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [";
+
+	bool first = true;
+	char line[256];
+
+	for (const ThreadBuffer* buffer : s_Threads)
+	{
+		snprintf(line, sizeof(line), "%s\n\t\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": { \"name\": \"%s\" } }",
+			first ? "" : ",", buffer->threadId, buffer->name.c_str());
+		file << line;
+		first = false;
+
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t count = std::min<uint64_t>(written, CPU_PROFILER_RING_SIZE);
+
+		// Oldest first, Chrome nests complete events of a thread by their time range
+		for (uint64_t i = written - count; i < written; i++)
+		{
+			const CpuZoneEvent& event = buffer->events[i % CPU_PROFILER_RING_SIZE];
+
+			snprintf(line, sizeof(line), ",\n\t\t{ \"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f }",
+				event.name, buffer->threadId, static_cast<double>(event.begin) * 1e-3, static_cast<double>(event.end - event.begin) * 1e-3);
+			file << line;
+		}
+	}
+
+	file << "\n\t]\n}\n";
+
+	return true;
+}
+
+void CpuProfiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+
+	for (ThreadBuffer* buffer : s_Threads)
+		buffer->written.store(0, std::memory_order_relaxed);
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::GetThreadBuffer()
+{
+	thread_local ThreadBuffer* buffer = nullptr;
+
+	if (buffer == nullptr)
+	{
+		buffer = new ThreadBuffer();
+		buffer->events.resize(CPU_PROFILER_RING_SIZE);
+
+		std::lock_guard<std::mutex> lock(s_ThreadsMutex);
+		buffer->threadId = static_cast<uint32_t>(s_Threads.size());
+		buffer->name = "Thread " + std::to_string(buffer->threadId);
+		s_Threads.push_back(buffer);
+	}
+
+	return *buffer;
+}
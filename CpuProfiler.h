@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+
+// 0 compiles every CPU_ZONE out, otherwise a zone costs one relaxed load while the profiler is disabled
+#ifndef CPU_PROFILER_ENABLED
+#define CPU_PROFILER_ENABLED 1
+#endif
+
+// Zones kept per thread, the oldest ones are overwritten once it is full
+#define CPU_PROFILER_RING_SIZE 16384
+
+struct CpuZoneEvent
+{
+	// String literal, never copied
+	const char* name;
+	// Nanoseconds from the profiler origin
+	int64_t begin;
+	int64_t end;
+};
+
+// Scoped CPU zones, each thread writes to its own ring buffer and only takes a lock the first time it records a zone.
+// Exports read the buffers as they are, threads still recording while exporting may show a torn last zone
+class CpuProfiler
+{
+public:
+	static void SetEnabled(bool enabled);
+
+	static bool IsEnabled()
+	{
+		return s_Enabled.load(std::memory_order_relaxed);
+	}
+
+	// Track name of the calling thread in the trace
+	static void SetThreadName(const std::string& name);
+
+	static int64_t Now();
+
+	static void AddZone(const char* name, int64_t begin, int64_t end);
+
+	// Chrome trace event JSON, opens in chrome://tracing, Perfetto and Tracy's import-chrome
+	static bool ExportChromeTrace(const std::string& path);
+
+	// Only when no thread is recording
+	static void Clear();
+
+private:
+	struct ThreadBuffer
+	{
+		std::vector<CpuZoneEvent> events;
+		// Zones ever written, events[written % CPU_PROFILER_RING_SIZE] is the next slot
+		std::atomic<uint64_t> written{ 0 };
+		uint32_t threadId = 0;
+		std::string name;
+	};
+
+	static ThreadBuffer& GetThreadBuffer();
+
+	static std::atomic<bool> s_Enabled;
+	static std::mutex s_ThreadsMutex;
+	// Kept until exit, a zone may be exported after its thread ended
+	static std::vector<ThreadBuffer*> s_Threads;
+};
+
+class CpuZone
+{
+public:
+	explicit CpuZone(const char* name)
+	{
+		if (CpuProfiler::IsEnabled())
+		{
+			m_Name = name;
+			m_Begin = CpuProfiler::Now();
+		}
+	}
+
+	~CpuZone()
+	{
+		if (m_Name)
+			CpuProfiler::AddZone(m_Name, m_Begin, CpuProfiler::Now());
+	}
+
+	CpuZone(const CpuZone&) = delete;
+	CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+	const char* m_Name = nullptr;
+	int64_t m_Begin = 0;
+};
+
+#define CPU_ZONE_CONCAT_(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_(a, b)
+
+#if CPU_PROFILER_ENABLED
+// Zone from here to the end of the enclosing scope, name must be a string literal
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
+#else
+#define CPU_ZONE(name)
+#endif
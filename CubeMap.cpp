@@ -27,8 +27,8 @@ CubeMap::CubeMap(std::array<std::string, 6>& imagePaths, VkFormat format, VmaAll
     stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     stagingBufferInfo.size = imageSize;
     stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    stagingBufferInfo.queueFamilyIndexCount = 2;
+    stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     VmaAllocationCreateInfo stagingAllocInfo = {};
@@ -127,8 +127,8 @@ void CubeMap::CreateVertexIndexCubeBuffer(VmaAllocator allocator, VkDevice devic
     stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     stagingBufferInfo.size = vertexBufferSize;
     stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    stagingBufferInfo.queueFamilyIndexCount = 2;
+    stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     VmaAllocationCreateInfo stagingAllocInfo = {};
@@ -148,8 +148,8 @@ void CubeMap::CreateVertexIndexCubeBuffer(VmaAllocator allocator, VkDevice devic
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = vertexBufferSize;
     bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     VmaAllocationCreateInfo allocCreateInfo = {};
@@ -183,8 +183,8 @@ void CubeMap::CreateVertexIndexCubeBuffer(VmaAllocator allocator, VkDevice devic
     stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     stagingBufferInfo.size = indexBufferSize;
     stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    stagingBufferInfo.queueFamilyIndexCount = 2;
+    stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     stagingAllocInfo = {};
@@ -205,8 +205,8 @@ void CubeMap::CreateVertexIndexCubeBuffer(VmaAllocator allocator, VkDevice devic
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = indexBufferSize;
     bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     allocCreateInfo = {};
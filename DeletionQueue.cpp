@@ -0,0 +1,26 @@
+#include "DeletionQueue.h"
+
+void DeletionQueue::Push(uint64_t frame, std::function<void()> destroy)
+{
+    m_Entries.push_back({ frame, std::move(destroy) });
+}
+
+void DeletionQueue::Flush(uint64_t completedFrame)
+{
+    // Frames complete in order, so do the entries
+    while (!m_Entries.empty() && m_Entries.front().frame <= completedFrame)
+    {
+        m_Entries.front().destroy();
+        m_Entries.pop_front();
+    }
+}
+
+void DeletionQueue::FlushAll()
+{
+    Flush(UINT64_MAX);
+}
+
+size_t DeletionQueue::GetPendingCount()
+{
+    return m_Entries.size();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Destruction of GPU objects deferred until the frames that may still use them are done on the GPU.
+// Entries are keyed by the number of frames submitted when they were retired, they run once that many frames completed.
+class DeletionQueue
+{
+public:
+    void Push(uint64_t frame, std::function<void()> destroy);
+
+    // Runs every entry retired at or before completedFrame, in retirement order
+    void Flush(uint64_t completedFrame);
+
+    // The device must be idle
+    void FlushAll();
+
+    size_t GetPendingCount();
+
+private:
+    struct Entry
+    {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    std::deque<Entry> m_Entries;
+};
@@ -8,20 +8,14 @@ void GBuffer::BuildGBuffer(uint8_t nbImages, uint32_t width, uint32_t height, Vm
 
 	for (uint8_t i = 0; i < nbImages; i++)
 	{
-		m_GBufferImages[i].positionImageBuffer.CreateImage(allocator, width, height, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
-		m_GBufferImages[i].positionImageBuffer.CreateImageView(device, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+		m_GBufferImages[i].positionImageBuffer.CreateImage(allocator, width, height, GBufferColorFormats[0], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
+		m_GBufferImages[i].positionImageBuffer.CreateImageView(device, GBufferColorFormats[0], VK_IMAGE_ASPECT_COLOR_BIT);
 		
-		m_GBufferImages[i].normalImageBuffer.CreateImage(allocator, width, height, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
-		m_GBufferImages[i].normalImageBuffer.CreateImageView(device, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+		m_GBufferImages[i].normalImageBuffer.CreateImage(allocator, width, height, GBufferColorFormats[1], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
+		m_GBufferImages[i].normalImageBuffer.CreateImageView(device, GBufferColorFormats[1], VK_IMAGE_ASPECT_COLOR_BIT);
 
-		m_GBufferImages[i].colorImageBuffer.CreateImage(allocator, width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
-		m_GBufferImages[i].colorImageBuffer.CreateImageView(device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-
-		m_GBufferImages[i].pbrImageBuffer.CreateImage(allocator, width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
-		m_GBufferImages[i].pbrImageBuffer.CreateImageView(device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-
-		m_GBufferImages[i].emissiveImageBuffer.CreateImage(allocator, width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, families);
-		m_GBufferImages[i].emissiveImageBuffer.CreateImageView(device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+		m_GBufferImages[i].shadowHistoryImageBuffer.CreateImage(allocator, width, height, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, families);
+		m_GBufferImages[i].shadowHistoryImageBuffer.CreateImageView(device, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
 
 		VkSamplerCreateInfo samplerInfo{};
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -47,29 +41,35 @@ void GBuffer::BuildGBuffer(uint8_t nbImages, uint32_t width, uint32_t height, Vm
 	}
 }
 
-void GBuffer::ReBuildGBuffer(uint8_t maxFramesInFlight, uint32_t width, uint32_t height, VmaAllocator allocator, VkDevice device, const std::vector<uint32_t> families)
+void GBuffer::ReBuildGBuffer(uint8_t maxFramesInFlight, uint32_t width, uint32_t height, VmaAllocator allocator, VkDevice device, const std::vector<uint32_t> families, DeletionQueue& deletionQueue, uint64_t frame)
 {
-	vkDeviceWaitIdle(device);
+	std::vector<GBUFFER> oldGBufferImages = std::move(m_GBufferImages);
+	m_GBufferImages.clear();
 
-	Cleanup(allocator, device);
+	deletionQueue.Push(frame, [oldGBufferImages, allocator, device]() mutable {
+		DestroyGBufferImages(oldGBufferImages, allocator, device);
+	});
 
 	BuildGBuffer(maxFramesInFlight, width, height, allocator, device, families);
 }
 
 void GBuffer::Cleanup(VmaAllocator allocator, VkDevice device)
 {
-	for (auto& GBuffer : m_GBufferImages)
+	DestroyGBufferImages(m_GBufferImages, allocator, device);
+
+	m_GBufferImages.clear();
+}
+
+void GBuffer::DestroyGBufferImages(std::vector<GBUFFER>& GBufferImages, VmaAllocator allocator, VkDevice device)
+{
+	for (auto& GBuffer : GBufferImages)
 	{
 		GBuffer.positionImageBuffer.Cleanup(allocator, device);
 		GBuffer.normalImageBuffer.Cleanup(allocator, device);
-		GBuffer.colorImageBuffer.Cleanup(allocator, device);
-		GBuffer.pbrImageBuffer.Cleanup(allocator, device);
-		GBuffer.emissiveImageBuffer.Cleanup(allocator, device);
+		GBuffer.shadowHistoryImageBuffer.Cleanup(allocator, device);
 
 		vkDestroySampler(device, GBuffer.sampler, nullptr);
 	}
-
-	m_GBufferImages.clear();
 }
 
 std::vector<GBUFFER>& GBuffer::GetGBufferImages()
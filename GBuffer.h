@@ -2,14 +2,33 @@
 
 #include "VulkanBase.h"
 #include "Image.h"
+#include "DeletionQueue.h"
+#include <array>
+
+// Color targets in attachment order: position, normal, color, pbr, emissive, motion
+const std::array<VkFormat, 6> GBufferColorFormats = {
+	VK_FORMAT_R32G32B32A32_SFLOAT,
+	VK_FORMAT_R32G32B32A32_SFLOAT,
+	VK_FORMAT_R8G8B8A8_UNORM,
+	VK_FORMAT_R8G8B8A8_UNORM,
+	VK_FORMAT_R8G8B8A8_UNORM,
+	VK_FORMAT_R16G16_SFLOAT
+};
+
+// Color targets the next frame does not read, they are transient render graph images shared by every frame in flight
+const std::array<const char*, 4> GBufferTransientNames = {
+	"GBuffer color",
+	"GBuffer pbr", //R: roughness, G: metallic, B: AO, A: undefined
+	"GBuffer emissive",
+	"GBuffer motion" //RG: uv(current) - uv(previous)
+};
 
+// What outlives the frame: position and normal reject the shadow history of the next one
 typedef struct s_GBUFFER
 {
 	Image positionImageBuffer;
 	Image normalImageBuffer;
-	Image colorImageBuffer;
-	Image pbrImageBuffer; //R: roughness, G: metallic, B: AO, A: undefined
-	Image emissiveImageBuffer;
+	Image shadowHistoryImageBuffer; //RGBA: accumulated shadow visibility of the first 4 lights
 	VkSampler sampler;
 } GBUFFER;
 
@@ -18,13 +37,16 @@ class GBuffer
 public:
 	void BuildGBuffer(uint8_t nbImages, uint32_t width, uint32_t height, VmaAllocator allocator, VkDevice device, const std::vector<uint32_t> families);
 
-	void ReBuildGBuffer(uint8_t nbImages, uint32_t width, uint32_t height, VmaAllocator allocator, VkDevice device, const std::vector<uint32_t> families);
+	// The previous images are retired to deletionQueue under frame, the frames in flight may still use them
+	void ReBuildGBuffer(uint8_t nbImages, uint32_t width, uint32_t height, VmaAllocator allocator, VkDevice device, const std::vector<uint32_t> families, DeletionQueue& deletionQueue, uint64_t frame);
 
 	void Cleanup(VmaAllocator allocator, VkDevice device);
 
 	std::vector<GBUFFER>& GetGBufferImages();
 
 private:
+	static void DestroyGBufferImages(std::vector<GBUFFER>& GBufferImages, VmaAllocator allocator, VkDevice device);
+
 	std::vector<GBUFFER> m_GBufferImages;
 };
 
@@ -0,0 +1,419 @@
+// Standalone CPU benchmark of the load time geometry kernels, no Vulkan device is created.
+// Run from the repository root: GeometryBenchmark [--min-time seconds] [--json file.json]
+
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "Materials.h"
+
+// Each measurement repeats its kernel until this much time was spent and at least GEOMETRY_BENCHMARK_MIN_ITERATIONS runs
+#define GEOMETRY_BENCHMARK_MIN_TIME 0.25
+#define GEOMETRY_BENCHMARK_MIN_ITERATIONS 3
+
+// AverageDuplicatedVertexNormals compares every vertex pair, bigger meshes would run for minutes
+#define GEOMETRY_BENCHMARK_QUADRATIC_VERTEX_LIMIT 20000
+
+struct GeometryBenchmarkResult
+{
+    std::string kernel;
+    std::string input;
+    size_t triangles = 0;
+    uint32_t iterations = 0;
+    double medianMilliseconds = 0.;
+    double minimumMilliseconds = 0.;
+    // From the median
+    double trianglesPerSecond = 0.;
+};
+
+static double s_MinTime = GEOMETRY_BENCHMARK_MIN_TIME;
+static std::vector<GeometryBenchmarkResult> s_Results;
+
+// setup runs before every iteration and is left out of the timings
+static void Measure(const std::string& kernel, const std::string& input, size_t triangles, const std::function<void()>& setup, const std::function<void()>& run)
+{
+    std::vector<double> timings;
+    double total = 0.;
+
+    while (total < s_MinTime || timings.size() < GEOMETRY_BENCHMARK_MIN_ITERATIONS)
+    {
+        setup();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        run();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        timings.push_back(milliseconds);
+        total += milliseconds * 1e-3;
+    }
+
+    std::sort(timings.begin(), timings.end());
+
+    GeometryBenchmarkResult result;
+    result.kernel = kernel;
+    result.input = input;
+    result.triangles = triangles;
+    result.iterations = static_cast<uint32_t>(timings.size());
+    result.medianMilliseconds = timings[timings.size() / 2];
+    result.minimumMilliseconds = timings.front();
+    result.trianglesPerSecond = result.medianMilliseconds > 0. ? static_cast<double>(triangles) / (result.medianMilliseconds * 1e-3) : 0.;
+
+    printf("%-32s %-28s %10zu tris %9.3f ms (min %9.3f, %4u runs) %8.2f Mtris/s\n", kernel.c_str(), input.c_str(), triangles,
+        result.medianMilliseconds, result.minimumMilliseconds, result.iterations, result.trianglesPerSecond * 1e-6);
+
+    s_Results.push_back(result);
+}
+
+static size_t CountTriangles(const std::vector<Mesh*>& meshes)
+{
+    // Full detail only, the simplified levels follow in the same index buffer
+    size_t triangles = 0;
+    for (Mesh* mesh : meshes)
+    {
+        for (const Primitive& primitive : mesh->GetPrimitives())
+            triangles += primitive.indexCount / 3;
+    }
+
+    return triangles;
+}
+
+static size_t CountVertices(const std::vector<Mesh*>& meshes)
+{
+    size_t vertices = 0;
+    for (Mesh* mesh : meshes)
+        vertices += mesh->GetVertex().size();
+
+    return vertices;
+}
+
+// UV sphere, the seam column and the poles are duplicated vertices like the ones a glTF export splits on UV seams
+static Mesh* CreateSphere(uint32_t segments)
+{
+    uint32_t rings = segments / 2;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    for (uint32_t ring = 0; ring <= rings; ring++)
+    {
+        float v = static_cast<float>(ring) / static_cast<float>(rings);
+        float phi = v * glm::pi<float>();
+
+        for (uint32_t segment = 0; segment <= segments; segment++)
+        {
+            float u = static_cast<float>(segment) / static_cast<float>(segments);
+            float theta = u * 2.f * glm::pi<float>();
+
+            Vertex vertex{};
+            vertex.pos = glm::vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+            vertex.normal = vertex.pos;
+            vertex.tex_coord = glm::vec2(u, v);
+            vertices.push_back(vertex);
+        }
+    }
+
+    for (uint32_t ring = 0; ring < rings; ring++)
+    {
+        for (uint32_t segment = 0; segment < segments; segment++)
+        {
+            uint32_t i0 = ring * (segments + 1) + segment;
+            uint32_t i1 = i0 + segments + 1;
+
+            indices.insert(indices.end(), { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 });
+        }
+    }
+
+    Mesh* mesh = new Mesh(vertices, indices);
+    mesh->AddPrimitives({ 0, static_cast<uint32_t>(indices.size()), 0, static_cast<uint32_t>(vertices.size()), 0 });
+
+    return mesh;
+}
+
+static float ComputeAcmr(const std::vector<Mesh*>& meshes, uint32_t cacheSize)
+{
+    float misses = 0.f;
+    size_t triangles = 0;
+
+    for (Mesh* mesh : meshes)
+    {
+        size_t meshTriangles = 0;
+        for (const Primitive& primitive : mesh->GetPrimitives())
+            meshTriangles += primitive.indexCount / 3;
+
+        misses += mesh->ComputeAcmr(cacheSize) * static_cast<float>(meshTriangles);
+        triangles += meshTriangles;
+    }
+
+    return triangles > 0 ? misses / static_cast<float>(triangles) : 0.f;
+}
+
+// Source order against the optimized one, for the FIFO size the order is cut on and the cache size it is optimized for
+static void PrintAcmr(const std::string& input, const std::vector<Mesh*>& meshes, std::vector<Mesh>& optimized)
+{
+    std::vector<Mesh*> optimizedMeshes;
+    for (Mesh& mesh : optimized)
+        optimizedMeshes.push_back(&mesh);
+
+    for (uint32_t cacheSize : { MESH_ACMR_CACHE_SIZE, MESH_VERTEX_CACHE_SIZE })
+    {
+        printf("%-32s %-28s %.3f -> %.3f\n", ("ACMR FIFO " + std::to_string(cacheSize)).c_str(), input.c_str(),
+            ComputeAcmr(meshes, cacheSize), ComputeAcmr(optimizedMeshes, cacheSize));
+    }
+}
+
+// Normals, tangents and duplicated vertex averaging on copies of meshes, restored before every run
+static void MeasureKernels(const std::string& input, const std::vector<Mesh*>& meshes)
+{
+    size_t triangles = CountTriangles(meshes);
+    std::vector<Mesh> copies;
+
+    auto reset = [&]()
+    {
+        copies.clear();
+        for (Mesh* mesh : meshes)
+            copies.push_back(*mesh);
+    };
+
+    Measure("AutoComputeNormals", input, triangles, reset, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.AutoComputeNormals();
+    });
+
+    Measure("AutoComputeTangentsBiTangents", input, triangles, reset, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.AutoComputeTangentsBiTangents();
+    });
+
+    Measure("AutoComputeTangents MikkTSpace", input, triangles, reset, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.AutoComputeMikkTSpaceTangents();
+    });
+
+    // copies hold the last MikkTSpace run
+    size_t splitVertices = 0;
+    for (Mesh& mesh : copies)
+        splitVertices += mesh.GetVertex().size();
+    splitVertices -= CountVertices(meshes);
+
+    printf("%-32s %-28s %zu split vertices for %zu\n", "MikkTSpace splits", input.c_str(), splitVertices, CountVertices(meshes));
+
+    Measure("Mesh::GenerateLods", input, triangles, reset, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.GenerateLods();
+    });
+
+    // copies hold the last GenerateLods run, a primitive without a level keeps drawing its full detail
+    uint32_t lodCount = 1;
+    for (Mesh& mesh : copies)
+        lodCount = std::max(lodCount, mesh.GetLodCount());
+
+    for (uint32_t lod = 1; lod < lodCount; lod++)
+    {
+        size_t lodTriangles = 0;
+        float lodError = 0.f;
+
+        for (Mesh& mesh : copies)
+        {
+            for (size_t i = 0; i < mesh.GetPrimitives().size(); i++)
+                lodTriangles += mesh.GetPrimitiveLod(i, lod).indexCount / 3;
+            lodError = std::max(lodError, mesh.GetLodError(lod));
+        }
+
+        printf("%-32s %-28s %zu triangles, error %g\n", ("LOD " + std::to_string(lod)).c_str(), input.c_str(), lodTriangles, lodError);
+    }
+
+    Measure("Mesh::Optimize", input, triangles, reset, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.Optimize();
+    });
+
+    // copies hold the last Optimize run
+    PrintAcmr(input, meshes, copies);
+
+    // Rebuilt from scratch every run, on the optimized order the loader builds them from
+    Measure("Mesh::BuildMeshlets", input, triangles, []() {}, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.BuildMeshlets();
+    });
+
+    // Full detail meshlets, the levels of detail get their own after them
+    size_t meshletCount = 0;
+    size_t meshletVertices = 0;
+    for (Mesh& mesh : copies)
+    {
+        for (const Primitive& primitive : mesh.GetPrimitives())
+        {
+            for (uint32_t i = primitive.meshletOffset; i < primitive.meshletOffset + primitive.meshletCount; i++)
+                meshletVertices += mesh.GetMeshlets()[i].vertexCount;
+            meshletCount += primitive.meshletCount;
+        }
+    }
+
+    if (meshletCount > 0)
+        printf("%-32s %-28s %zu meshlets, %.1f triangles and %.1f vertices each\n", "Meshlets", input.c_str(), meshletCount,
+            static_cast<double>(triangles) / meshletCount, static_cast<double>(meshletVertices) / meshletCount);
+
+    if (CountVertices(meshes) > GEOMETRY_BENCHMARK_QUADRATIC_VERTEX_LIMIT)
+    {
+        printf("%-32s %-28s skipped, more than %d vertices\n", "AverageDuplicatedVertexNormals", input.c_str(), GEOMETRY_BENCHMARK_QUADRATIC_VERTEX_LIMIT);
+        return;
+    }
+
+    Measure("AverageDuplicatedVertexNormals", input, triangles, reset, [&]()
+    {
+        for (Mesh& mesh : copies)
+            mesh.AverageDuplicatedVertexNormals();
+    });
+}
+
+static bool FileExists(const std::string& path)
+{
+    return std::ifstream(path).good();
+}
+
+static void MeasureObj(const std::string& name, const std::string& path)
+{
+    if (!FileExists(path))
+    {
+        printf("%s not found, skipped\n", path.c_str());
+        return;
+    }
+
+    Mesh* mesh = MeshLoader::loadMeshObj(path);
+    if (mesh == nullptr)
+        return;
+
+    // The loader leaves the whole mesh without primitive, the kernels work per primitive
+    if (mesh->GetPrimitives().empty())
+        mesh->AddPrimitives({ 0, static_cast<uint32_t>(mesh->GetIndexes().size()), 0, static_cast<uint32_t>(mesh->GetVertex().size()), 0 });
+
+    std::vector<Mesh*> meshes = { mesh };
+    size_t triangles = CountTriangles(meshes);
+
+    Measure("tinyobj parse", name, triangles, []() {}, [&]()
+    {
+        tinyobj::ObjReaderConfig readerConfig;
+        readerConfig.triangulate = true;
+        readerConfig.triangulation_method = "earcut";
+        tinyobj::ObjReader reader;
+        reader.ParseFromFile(path, readerConfig);
+    });
+
+    // Parse and conversion to Mesh, the difference with the parse alone is the conversion loop
+    Measure("MeshLoader::loadMeshObj", name, triangles, []() {}, [&]()
+    {
+        delete MeshLoader::loadMeshObj(path);
+    });
+
+    MeasureKernels(name, meshes);
+
+    delete mesh;
+}
+
+static void MeasureGltf(const std::string& name, const std::string& path)
+{
+    if (!FileExists(path))
+    {
+        printf("%s not found, skipped\n", path.c_str());
+        return;
+    }
+
+    // Left in the file order, the optimization is measured on its own
+    Materials materials;
+    std::vector<Mesh*> meshes = MeshLoader::loadGltf(path, materials, false, false, false);
+    if (meshes.empty())
+        return;
+
+    size_t triangles = CountTriangles(meshes);
+    bool binary = path.substr(path.find_last_of('.')) == ".glb";
+
+    Measure("tinygltf parse", name, triangles, []() {}, [&]()
+    {
+        tinygltf::TinyGLTF loader;
+        tinygltf::Model model;
+        std::string err, warn;
+        if (binary)
+            loader.LoadBinaryFromFile(&model, &err, &warn, path);
+        else
+            loader.LoadASCIIFromFile(&model, &err, &warn, path);
+    });
+
+    Measure("MeshLoader::loadGltf", name, triangles, []() {}, [&]()
+    {
+        Materials loadMaterials;
+        for (Mesh* mesh : MeshLoader::loadGltf(path, loadMaterials))
+            delete mesh;
+    });
+
+    MeasureKernels(name, meshes);
+
+    for (Mesh* mesh : meshes)
+        delete mesh;
+}
+
+static bool ExportJson(const std::string& path)
+{
+    std::ofstream file(path);
+
+    if (!file.is_open())
+    {
+        std::cout << "Geometry benchmark export to " << path << " failed !" << '\n';
+        return false;
+    }
+
+    file << "{\n\t\"results\": [";
+
+    for (size_t i = 0; i < s_Results.size(); i++)
+    {
+        const GeometryBenchmarkResult& result = s_Results[i];
+
+        file << (i > 0 ? "," : "") << "\n\t\t{ \"kernel\": \"" << result.kernel << "\", \"input\": \"" << result.input << "\", \"triangles\": " << result.triangles
+            << ", \"iterations\": " << result.iterations << ", \"median_ms\": " << result.medianMilliseconds << ", \"min_ms\": " << result.minimumMilliseconds
+            << ", \"triangles_per_second\": " << result.trianglesPerSecond << " }";
+    }
+
+    file << "\n\t]\n}\n";
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--min-time" && hasValue)
+            s_MinTime = std::stod(argv[++i]);
+        else if (argument == "--json" && hasValue)
+            jsonPath = argv[++i];
+        else
+            std::cout << "Unknown argument " << argument << " ignored" << '\n';
+    }
+
+    MeasureObj("teapot.obj", "./Models/teapot.obj");
+    MeasureGltf("DamagedHelmet", "./Models/GLTF/DamagedHelmet/glTF/DamagedHelmet.gltf");
+    MeasureGltf("Sponza", "./Models/GLTF/Sponza/glTF/Sponza.glb");
+
+    for (uint32_t segments = 32; segments <= 1024; segments *= 2)
+    {
+        Mesh* sphere = CreateSphere(segments);
+        MeasureKernels("sphere " + std::to_string(segments), { sphere });
+        delete sphere;
+    }
+
+    if (!jsonPath.empty())
+        ExportJson(jsonPath);
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include "GpuProfiler.h"
+
+void GpuProfiler::Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight, uint32_t maxScopes)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	m_Supported = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+	m_TimestampPeriod = static_cast<double>(properties.limits.timestampPeriod);
+	m_MaxScopes = maxScopes;
+
+	if (!m_Supported)
+	{
+		std::cout << "Timestamp queries not supported, GPU timings disabled !" << '\n';
+		return;
+	}
+
+	m_Frames.resize(framesInFlight);
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * maxScopes;
+
+	for (auto& frame : m_Frames)
+	{
+		if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+			std::cout << "Timestamp query pool creation failed !" << '\n';
+
+		frame.names.reserve(maxScopes);
+	}
+}
+
+void GpuProfiler::BeginFrame(VkDevice device, uint32_t frame)
+{
+	if (!m_Supported)
+		return;
+
+	FrameQueries& frameQueries = m_Frames[frame];
+
+	// The slot's previous frame was waited on and read, no queue uses the pool anymore
+	vkResetQueryPool(device, frameQueries.queryPool, 0, 2 * m_MaxScopes);
+
+	frameQueries.names.clear();
+	frameQueries.openScopes.clear();
+	frameQueries.submitted = true;
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, uint32_t frame, const std::string& name)
+{
+	if (!m_Supported)
+		return;
+
+	FrameQueries& frameQueries = m_Frames[frame];
+
+	if (frameQueries.names.size() >= m_MaxScopes)
+		return;
+
+	uint32_t scope = static_cast<uint32_t>(frameQueries.names.size());
+	frameQueries.names.push_back(name);
+	frameQueries.openScopes.push_back(scope);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameQueries.queryPool, 2 * scope);
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	if (!m_Supported)
+		return;
+
+	FrameQueries& frameQueries = m_Frames[frame];
+
+	if (frameQueries.openScopes.empty())
+		return;
+
+	uint32_t scope = frameQueries.openScopes.back();
+	frameQueries.openScopes.pop_back();
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameQueries.queryPool, 2 * scope + 1);
+}
+
+bool GpuProfiler::ReadResults(VkDevice device, uint32_t frame)
+{
+	if (!m_Supported)
+		return false;
+
+	FrameQueries& frameQueries = m_Frames[frame];
+
+	if (!frameQueries.submitted || frameQueries.names.empty())
+		return false;
+
+	uint32_t queryCount = 2 * static_cast<uint32_t>(frameQueries.names.size());
+	std::vector<uint64_t> timestamps(queryCount);
+
+	// The frame's timeline value has been waited on, the queries are available without VK_QUERY_RESULT_WAIT_BIT
+	if (vkGetQueryPoolResults(device, frameQueries.queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	frameQueries.submitted = false;
+
+	uint64_t frameStart = timestamps[0];
+	for (size_t i = 0; i < frameQueries.names.size(); i++)
+		frameStart = std::min(frameStart, timestamps[2 * i]);
+
+	for (auto& result : m_Results)
+		result.current = false;
+
+	m_FrameTime = 0.;
+
+	for (size_t i = 0; i < frameQueries.names.size(); i++)
+	{
+		double milliseconds = static_cast<double>(timestamps[2 * i + 1] - timestamps[2 * i]) * m_TimestampPeriod * 1e-6;
+
+		auto result = std::find_if(m_Results.begin(), m_Results.end(), [&](const GpuScopeResult& r) { return r.name == frameQueries.names[i]; });
+
+		if (result == m_Results.end())
+		{
+			GpuScopeResult newResult;
+			newResult.name = frameQueries.names[i];
+			newResult.milliseconds = milliseconds;
+			newResult.average = milliseconds;
+
+			m_Results.push_back(newResult);
+			result = m_Results.end() - 1;
+		}
+		else
+		{
+			result->milliseconds = milliseconds;
+			result->average += 0.05 * (milliseconds - result->average);
+		}
+
+		UpdateHistory(*result);
+
+		result->start = static_cast<double>(timestamps[2 * i] - frameStart) * m_TimestampPeriod * 1e-6;
+		result->end = result->start + milliseconds;
+		result->current = true;
+
+		m_FrameTime = std::max(m_FrameTime, result->end);
+	}
+
+	return true;
+}
+
+const std::vector<GpuScopeResult>& GpuProfiler::GetResults()
+{
+	return m_Results;
+}
+
+double GpuProfiler::GetFrameTime()
+{
+	return m_FrameTime;
+}
+
+bool GpuProfiler::IsSupported()
+{
+	return m_Supported;
+}
+
+bool GpuProfiler::ExportCsv(const std::string& path)
+{
+	std::ofstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "GPU profile export to " << path << " failed !" << '\n';
+		return false;
+	}
+
+	file << "scope,last_ms,avg_ms,min_ms,p99_ms,samples\n";
+
+	for (const auto& result : m_Results)
+	{
+		file << result.name << ',' << result.milliseconds << ',' << result.average << ',' << result.minimum << ',' << result.p99 << ',';
+
+		std::vector<float> history = GetOrderedHistory(result);
+		for (size_t i = 0; i < history.size(); i++)
+			file << (i > 0 ? " " : "") << history[i];
+
+		file << '\n';
+	}
+
+	return true;
+}
+
+bool GpuProfiler::ExportJson(const std::string& path)
+{
+	std::ofstream file(path);
+
+	if (!file.is_open())
+	{
+		std::cout << "GPU profile export to " << path << " failed !" << '\n';
+		return false;
+	}
+
+	file << "{\n\t\"scopes\": [";
+
+	for (size_t i = 0; i < m_Results.size(); i++)
+	{
+		const GpuScopeResult& result = m_Results[i];
+
+		file << (i > 0 ? "," : "") << "\n\t\t{ \"name\": \"" << result.name << "\", \"last_ms\": " << result.milliseconds << ", \"avg_ms\": " << result.average
+			<< ", \"min_ms\": " << result.minimum << ", \"p99_ms\": " << result.p99 << ", \"samples\": [";
+
+		std::vector<float> history = GetOrderedHistory(result);
+		for (size_t j = 0; j < history.size(); j++)
+			file << (j > 0 ? ", " : "") << history[j];
+
+		file << "] }";
+	}
+
+	file << "\n\t]\n}\n";
+
+	return true;
+}
+
+void GpuProfiler::UpdateHistory(GpuScopeResult& result)
+{
+	if (result.history.size() < GPU_PROFILER_HISTORY_SIZE)
+	{
+		result.history.push_back(static_cast<float>(result.milliseconds));
+	}
+	else
+	{
+		result.history[result.historyOffset] = static_cast<float>(result.milliseconds);
+		result.historyOffset = (result.historyOffset + 1) % GPU_PROFILER_HISTORY_SIZE;
+	}
+
+	std::vector<float> sorted = result.history;
+	size_t p99Index = (sorted.size() * 99 + 99) / 100 - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + p99Index, sorted.end());
+
+	result.p99 = sorted[p99Index];
+	result.minimum = *std::min_element(result.history.begin(), result.history.end());
+}
+
+std::vector<float> GpuProfiler::GetOrderedHistory(const GpuScopeResult& result)
+{
+	std::vector<float> history(result.history.begin() + result.historyOffset, result.history.end());
+	history.insert(history.end(), result.history.begin(), result.history.begin() + result.historyOffset);
+
+	return history;
+}
+
+void GpuProfiler::Cleanup(VkDevice device)
+{
+	for (auto& frame : m_Frames)
+	{
+		if (frame.queryPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(device, frame.queryPool, nullptr);
+	}
+
+	m_Frames.clear();
+	m_Results.clear();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+// Frames kept per scope for the rolling graph and the window statistics
+#define GPU_PROFILER_HISTORY_SIZE 256
+
+struct GpuScopeResult
+{
+	std::string name;
+	double milliseconds = 0.;
+	double average = 0.;
+	// Begin and end of the scope in the last read frame, relative to its earliest scope, so scopes on different queues share one axis
+	double start = 0.;
+	double end = 0.;
+	// False when the scope was not recorded in the last read frame
+	bool current = false;
+	// Last GPU_PROFILER_HISTORY_SIZE timings, a ring buffer once full with historyOffset as its oldest entry
+	std::vector<float> history;
+	uint32_t historyOffset = 0;
+	// Over the history window
+	double minimum = 0.;
+	double p99 = 0.;
+};
+
+// Timestamp queries per frame in flight, read back once the frame's timeline value has been waited on
+class GpuProfiler
+{
+public:
+	void Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight, uint32_t maxScopes);
+
+	// Resets the frame's queries from the host before any of its command buffers is recorded, the graphics and the async
+	// compute ones then take their scopes from the same indices
+	void BeginFrame(VkDevice device, uint32_t frame);
+
+	void BeginScope(VkCommandBuffer commandBuffer, uint32_t frame, const std::string& name);
+
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	// False when the slot holds no frame that was not already read
+	bool ReadResults(VkDevice device, uint32_t frame);
+
+	const std::vector<GpuScopeResult>& GetResults();
+
+	// From the first scope begin to the last scope end of the last read frame
+	double GetFrameTime();
+
+	bool IsSupported();
+
+	// Window statistics of every scope followed by its history, oldest first
+	bool ExportCsv(const std::string& path);
+
+	bool ExportJson(const std::string& path);
+
+	void Cleanup(VkDevice device);
+
+private:
+	static void UpdateHistory(GpuScopeResult& result);
+
+	// Oldest first, whether or not the ring buffer wrapped
+	static std::vector<float> GetOrderedHistory(const GpuScopeResult& result);
+
+	struct FrameQueries
+	{
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::vector<std::string> names;
+		std::vector<uint32_t> openScopes;
+		bool submitted = false;
+	};
+
+	std::vector<FrameQueries> m_Frames;
+	std::vector<GpuScopeResult> m_Results;
+
+	double m_FrameTime = 0.;
+
+	uint32_t m_MaxScopes = 0;
+	double m_TimestampPeriod = 1.;
+	bool m_Supported = false;
+};
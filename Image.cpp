@@ -1,5 +1,7 @@
 #include "Image.h"
 #include "VulkanUtils.h"
+#include "Mesh.h"
+#include "CpuProfiler.h"
 
 void Image::CreateImage(VmaAllocator allocator, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, const std::vector<uint32_t> families, uint32_t mipLevels, uint32_t layer_count, VkImageLayout initial_layout)
 {
@@ -20,17 +22,19 @@ void Image::CreateImage(VmaAllocator allocator, uint32_t width, uint32_t height,
     imageCreateInfo.usage = usage;
     imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCreateInfo.flags = m_layer_count == 6 ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
-    uint32_t familyCount = static_cast<uint32_t>(families.size());
+    // Devices without a dedicated transfer family hand the same family twice, concurrent sharing needs unique ones
+    std::vector<uint32_t> uniqueFamilies = Mesh::GetUniqueQueueFamilies(families);
+    uint32_t familyCount = static_cast<uint32_t>(uniqueFamilies.size());
     imageCreateInfo.queueFamilyIndexCount = familyCount;
     if (familyCount == 1)
     {
         imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        imageCreateInfo.pQueueFamilyIndices = families.data();
+        imageCreateInfo.pQueueFamilyIndices = uniqueFamilies.data();
     }
     else
     {
         imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-        imageCreateInfo.pQueueFamilyIndices = families.data();
+        imageCreateInfo.pQueueFamilyIndices = uniqueFamilies.data();
     }
 
 
@@ -284,6 +288,8 @@ uint32_t Image::GetMipLevels()
 
 TextureImage::TextureImage(std::string& imagePath, VkFormat format, VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, VkCommandPool graphicPool, VkQueue graphicQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, bool useMipLevel)
 {
+    CPU_ZONE("Load texture");
+
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(imagePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     VkDeviceSize imageSize = texWidth * texHeight * 4;
@@ -299,8 +305,8 @@ TextureImage::TextureImage(std::string& imagePath, VkFormat format, VmaAllocator
     stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     stagingBufferInfo.size = imageSize;
     stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    stagingBufferInfo.queueFamilyIndexCount = 2;
+    stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     VmaAllocationCreateInfo stagingAllocInfo = {};
@@ -355,8 +361,8 @@ TextureImage::TextureImage(unsigned char* pixels, int texWidth, int texHeight, V
     stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     stagingBufferInfo.size = imageSize;
     stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-    stagingBufferInfo.queueFamilyIndexCount = 2;
+    stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
     stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
     VmaAllocationCreateInfo stagingAllocInfo = {};
@@ -42,9 +42,24 @@ DirectionalLight::DirectionalLight(glm::vec3 direction, glm::vec3 color, float i
     m_Intensity = intensity;
 }
 
+void DirectionalLight::SetShadowTechnique(ShadowTechnique shadowTechnique)
+{
+    m_ShadowTechnique = shadowTechnique;
+}
+
+ShadowTechnique DirectionalLight::GetShadowTechnique()
+{
+    return m_ShadowTechnique;
+}
+
+const glm::vec3& DirectionalLight::GetDirection()
+{
+    return m_Direction;
+}
+
 UniformDirectionalLight DirectionalLight::GetUniformDirectionalLight()
 {
-    return {m_Color * m_Intensity, m_Direction};
+    return {m_Color * m_Intensity, m_Direction, static_cast<int>(m_ShadowTechnique)};
 }
 
 PointLight::PointLight(glm::vec3 position)
@@ -2,10 +2,17 @@
 
 #include "VkGLM.h"
 
+enum ShadowTechnique
+{
+    SHADOW_RAY_TRACED = 0,
+    SHADOW_MAP = 1
+};
+
 struct alignas(16) UniformDirectionalLight
 {
     alignas(16) glm::vec3 Color;
     alignas(16) glm::vec3 Direction;
+    alignas(16) int ShadowTechnique;
 };
 
 struct alignas(16) UniformPointLight
@@ -40,12 +47,18 @@ public:
     DirectionalLight(glm::vec3 direction);
     DirectionalLight(glm::vec3 direction, glm::vec3 color, float intensity);
 
+    void SetShadowTechnique(ShadowTechnique shadowTechnique);
+
+    ShadowTechnique GetShadowTechnique();
+    const glm::vec3& GetDirection();
+
     UniformDirectionalLight GetUniformDirectionalLight();
     
     ~DirectionalLight() override = default;
 
 private:
     glm::vec3 m_Direction = glm::vec3(0.f, -1.f, 0.f);
+    ShadowTechnique m_ShadowTechnique = SHADOW_RAY_TRACED;
 };
 
 class PointLight : public Light
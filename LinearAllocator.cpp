@@ -0,0 +1,72 @@
+#include "LinearAllocator.h"
+
+void LinearAllocator::Create(VmaAllocator allocator, VkDeviceSize frameCapacity, uint32_t framesInFlight, VkBufferUsageFlags usage, VkDeviceSize minAlignment)
+{
+	m_MinAlignment = std::max<VkDeviceSize>(minAlignment, 1);
+	// Every region starts aligned so its first allocation can be bound with a dynamic offset
+	m_FrameCapacity = AlignUp(std::max<VkDeviceSize>(frameCapacity, 1), m_MinAlignment);
+
+	VkBufferCreateInfo bufferCreateInfo{};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = m_FrameCapacity * framesInFlight;
+	bufferCreateInfo.usage = usage;
+
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	if (vmaCreateBuffer(allocator, &bufferCreateInfo, &allocCreateInfo, &m_Buffer, &m_Allocation, &m_AllocationInfo) != VK_SUCCESS)
+		std::cout << "Linear allocator buffer allocation failed !" << std::endl;
+
+	BeginFrame(0);
+}
+
+void LinearAllocator::BeginFrame(uint32_t frame)
+{
+	m_Head = frame * m_FrameCapacity;
+	m_FrameEnd = m_Head + m_FrameCapacity;
+}
+
+LinearAllocation LinearAllocator::Allocate(VkDeviceSize size)
+{
+	LinearAllocation allocation{};
+
+	if (m_AllocationInfo.pMappedData == nullptr || m_Head + size > m_FrameEnd)
+	{
+		std::cout << "Linear allocator frame region full !" << std::endl;
+		return allocation;
+	}
+
+	allocation.data = static_cast<char*>(m_AllocationInfo.pMappedData) + m_Head;
+	allocation.offset = m_Head;
+	allocation.size = size;
+
+	m_Head = std::min(AlignUp(m_Head + size, m_MinAlignment), m_FrameEnd);
+
+	return allocation;
+}
+
+VkBuffer LinearAllocator::GetBuffer()
+{
+	return m_Buffer;
+}
+
+VkDeviceSize LinearAllocator::GetFrameCapacity()
+{
+	return m_FrameCapacity;
+}
+
+void LinearAllocator::Cleanup(VmaAllocator allocator)
+{
+	if (m_Buffer != VK_NULL_HANDLE)
+		vmaDestroyBuffer(allocator, m_Buffer, m_Allocation);
+
+	m_Buffer = VK_NULL_HANDLE;
+	m_Allocation = VK_NULL_HANDLE;
+	m_AllocationInfo = {};
+}
+
+VkDeviceSize LinearAllocator::AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
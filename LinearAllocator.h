@@ -0,0 +1,44 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include <iostream>
+#include <algorithm>
+
+struct LinearAllocation
+{
+	// Null when the frame region is full
+	void* data = nullptr;
+	// From the start of the buffer, usable as a dynamic descriptor offset
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+};
+
+// One persistently mapped buffer split in a region per frame in flight. A frame bumps its allocations out of its region,
+// BeginFrame releases them all at once and must only be called once the frame's fence has been waited on
+class LinearAllocator
+{
+public:
+	void Create(VmaAllocator allocator, VkDeviceSize frameCapacity, uint32_t framesInFlight, VkBufferUsageFlags usage, VkDeviceSize minAlignment);
+
+	void BeginFrame(uint32_t frame);
+
+	LinearAllocation Allocate(VkDeviceSize size);
+
+	VkBuffer GetBuffer();
+
+	VkDeviceSize GetFrameCapacity();
+
+	void Cleanup(VmaAllocator allocator);
+
+private:
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment);
+
+	VkBuffer m_Buffer = VK_NULL_HANDLE;
+	VmaAllocation m_Allocation = VK_NULL_HANDLE;
+	VmaAllocationInfo m_AllocationInfo{};
+
+	VkDeviceSize m_FrameCapacity = 0;
+	VkDeviceSize m_MinAlignment = 1;
+	VkDeviceSize m_FrameEnd = 0;
+	VkDeviceSize m_Head = 0;
+};
@@ -1,4 +1,5 @@
 #include "Materials.h"
+#include "CpuProfiler.h"
 
 size_t Materials::AddMaterial(Material material)
 {
@@ -9,6 +10,8 @@ size_t Materials::AddMaterial(Material material)
 
 void Materials::CreateTexures(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, VkCommandPool graphicPool, VkQueue graphicQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice)
 {
+	CPU_ZONE("Materials::CreateTexures");
+
 	for (auto& material : m_Materials)
 	{
 		if (material.baseColorTexturePath != "" && material.baseColorTexture == nullptr)
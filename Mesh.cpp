@@ -1,7 +1,14 @@
 #include "Mesh.h"
 #include "VulkanUtils.h"
+#include "CpuProfiler.h"
 #include <iostream>
 #include <list>
+#include <atomic>
+#include <thread>
+#include <numeric>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
 
 Mesh::Mesh()
 {
@@ -28,6 +35,30 @@ void Mesh::DestroyBuffer(VmaAllocator allocator, VkDevice device)
 		vkDestroyBuffer(device, m_IndexBuffer, NULL);
 		vmaFreeMemory(allocator, m_IndexBufferAlloc);
 	}
+
+	if (m_SkinBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, m_SkinBuffer, NULL);
+		vmaFreeMemory(allocator, m_SkinBufferAlloc);
+	}
+
+	if (m_SkinnedVertexBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, m_SkinnedVertexBuffer, NULL);
+		vmaFreeMemory(allocator, m_SkinnedVertexBufferAlloc);
+	}
+
+	if (m_MeshletBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, m_MeshletBuffer, NULL);
+		vmaFreeMemory(allocator, m_MeshletBufferAlloc);
+	}
+
+	if (m_MeshletDataBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, m_MeshletDataBuffer, NULL);
+		vmaFreeMemory(allocator, m_MeshletDataBufferAlloc);
+	}
 }
 
 void Mesh::SetVertex(const std::vector<Vertex>& vertexs)
@@ -62,6 +93,36 @@ void Mesh::AddIndex(const uint32_t& index)
 	m_Indexes.push_back(index);
 }
 
+void Mesh::AddSkinVertex(const SkinVertex& skinVertex)
+{
+	m_SkinVertexs.push_back(skinVertex);
+}
+
+void Mesh::SetSkeleton(const std::shared_ptr<Skeleton>& skeleton)
+{
+	m_Skeleton = skeleton;
+}
+
+const std::shared_ptr<Skeleton>& Mesh::GetSkeleton()
+{
+	return m_Skeleton;
+}
+
+bool Mesh::IsSkinned()
+{
+	return m_Skeleton != nullptr && m_SkinVertexs.size() == m_Vertexs.size();
+}
+
+void Mesh::SetAnimationTimeOffset(float animationTimeOffset)
+{
+	m_AnimationTimeOffset = animationTimeOffset;
+}
+
+float Mesh::GetAnimationTimeOffset()
+{
+	return m_AnimationTimeOffset;
+}
+
 size_t Mesh::AddPrimitives(const Primitive& primitive)
 {
 	m_Primitves.push_back(primitive);
@@ -74,9 +135,12 @@ const std::vector<Primitive>& Mesh::GetPrimitives()
 	return m_Primitves;
 }  
 
-void Mesh::CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice)
+void Mesh::CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, bool accelerationStructureInput)
 {
+	CPU_ZONE("Mesh::CreateVertexBuffers");
+
 	uint32_t queueFamilyIndices[2] = { transferFamilyIndice, graphicFamilyIndice };
+	std::vector<uint32_t> deviceQueueFamilyIndices = GetUniqueQueueFamilies({ transferFamilyIndice, graphicFamilyIndice, computeFamilyIndice });
 
 	VkDeviceSize vertexBufferSize = m_Vertexs.size() * sizeof(Vertex);
 
@@ -84,8 +148,8 @@ void Mesh::CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkComman
 	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	stagingBufferInfo.size = vertexBufferSize;
 	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-	stagingBufferInfo.queueFamilyIndexCount = 2;
+	stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
 	stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
 	VmaAllocationCreateInfo stagingAllocInfo = {};
@@ -104,10 +168,17 @@ void Mesh::CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkComman
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = vertexBufferSize;
-	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
-	bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-	bufferInfo.queueFamilyIndexCount = 2;
-	bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	if (accelerationStructureInput)
+		bufferInfo.usage |= VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+	// Fetched by the mesh shaders, and for skinned meshes the bind pose read by the skinning pass
+	bufferInfo.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	// Copied into the skinned vertex buffer
+	if (IsSkinned())
+		bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = deviceQueueFamilyIndices.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(deviceQueueFamilyIndices.size());
+	bufferInfo.pQueueFamilyIndices = deviceQueueFamilyIndices.data();
 
 	VmaAllocationCreateInfo allocCreateInfo = {};
 	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
@@ -122,18 +193,34 @@ void Mesh::CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkComman
 	vmaFreeMemory(allocator, stagingAlloc);
 }
 
-void Mesh::CreateIndexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice)
+void Mesh::CreateIndexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, bool accelerationStructureInput)
 {
+	CPU_ZONE("Mesh::CreateIndexBuffers");
+
 	uint32_t queueFamilyIndices[2] = { transferFamilyIndice, graphicFamilyIndice };
+	std::vector<uint32_t> deviceQueueFamilyIndices = GetUniqueQueueFamilies({ transferFamilyIndice, graphicFamilyIndice, computeFamilyIndice });
 
-	VkDeviceSize indexBufferSize = m_Indexes.size() * sizeof(uint32_t);
+	// A mesh without primitive draws its whole vertex buffer
+	uint32_t maxVertexCount = m_Primitves.empty() ? static_cast<uint32_t>(m_Vertexs.size()) : 0;
+	for (const Primitive& p : m_Primitves)
+		maxVertexCount = std::max(maxVertexCount, p.vertexCount);
+
+	m_IndexType = maxVertexCount <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	// The kernels keep working on 32-bit indexes, they are only narrowed for the device
+	std::vector<uint16_t> narrowIndexes;
+	if (m_IndexType == VK_INDEX_TYPE_UINT16)
+		narrowIndexes.assign(m_Indexes.begin(), m_Indexes.end());
+
+	const void* indexData = m_IndexType == VK_INDEX_TYPE_UINT16 ? static_cast<const void*>(narrowIndexes.data()) : static_cast<const void*>(m_Indexes.data());
+	VkDeviceSize indexBufferSize = m_Indexes.size() * GetIndexSize(m_IndexType);
 
 	VkBufferCreateInfo stagingBufferInfo = {};
 	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	stagingBufferInfo.size = indexBufferSize;
 	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-	stagingBufferInfo.queueFamilyIndexCount = 2;
+	stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
 	stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
 
 	VmaAllocationCreateInfo stagingAllocInfo = {};
@@ -147,16 +234,18 @@ void Mesh::CreateIndexBuffers(VmaAllocator allocator, VkDevice device, VkCommand
 
 	void* data = nullptr;
 	vmaMapMemory(allocator, stagingAlloc, &data);
-	memcpy(data, m_Indexes.data(), (size_t)indexBufferSize);
+	memcpy(data, indexData, (size_t)indexBufferSize);
 	vmaUnmapMemory(allocator, stagingAlloc);
 
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = indexBufferSize;
-	bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
-	bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-	bufferInfo.queueFamilyIndexCount = 2;
-	bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+	bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	if (accelerationStructureInput)
+		bufferInfo.usage |= VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+	bufferInfo.sharingMode = deviceQueueFamilyIndices.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(deviceQueueFamilyIndices.size());
+	bufferInfo.pQueueFamilyIndices = deviceQueueFamilyIndices.data();
 
 	VmaAllocationCreateInfo allocCreateInfo = {};
 	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
@@ -171,16 +260,187 @@ void Mesh::CreateIndexBuffers(VmaAllocator allocator, VkDevice device, VkCommand
 	vmaFreeMemory(allocator, stagingAlloc);
 }
 
+void Mesh::CreateSkinningBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, bool accelerationStructureInput)
+{
+	if (!IsSkinned() || m_VertexBuffer == VK_NULL_HANDLE)
+		return;
+
+	uint32_t queueFamilyIndices[2] = { transferFamilyIndice, graphicFamilyIndice };
+	std::vector<uint32_t> deviceQueueFamilyIndices = GetUniqueQueueFamilies({ transferFamilyIndice, graphicFamilyIndice, computeFamilyIndice });
+
+	VkDeviceSize skinBufferSize = m_SkinVertexs.size() * sizeof(SkinVertex);
+
+	VkBufferCreateInfo stagingBufferInfo = {};
+	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	stagingBufferInfo.size = skinBufferSize;
+	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
+	stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+
+	VmaAllocationCreateInfo stagingAllocInfo = {};
+	stagingAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+	VkBuffer stagingBuf = {};
+	VmaAllocation stagingAlloc = {};
+	vmaCreateBuffer(allocator, &stagingBufferInfo, &stagingAllocInfo, &stagingBuf, &stagingAlloc, NULL);
+
+	void* data = nullptr;
+	vmaMapMemory(allocator, stagingAlloc, &data);
+	memcpy(data, m_SkinVertexs.data(), (size_t)skinBufferSize);
+	vmaUnmapMemory(allocator, stagingAlloc);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = skinBufferSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = deviceQueueFamilyIndices.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(deviceQueueFamilyIndices.size());
+	bufferInfo.pQueueFamilyIndices = deviceQueueFamilyIndices.data();
+
+	VmaAllocationCreateInfo allocCreateInfo = {};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	allocCreateInfo.priority = 1.0f;
+
+	vmaCreateBuffer(allocator, &bufferInfo, &allocCreateInfo, &m_SkinBuffer, &m_SkinBufferAlloc, NULL);
+
+	VulkanUtils::CopyBuffer(device, transferPool, transferQueue, stagingBuf, m_SkinBuffer, skinBufferSize);
+
+	vkDestroyBuffer(device, stagingBuf, nullptr);
+	vmaFreeMemory(allocator, stagingAlloc);
+
+	VkDeviceSize vertexBufferSize = m_Vertexs.size() * sizeof(Vertex);
+
+	bufferInfo.size = vertexBufferSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	if (accelerationStructureInput)
+		bufferInfo.usage |= VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+
+	allocCreateInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+
+	vmaCreateBuffer(allocator, &bufferInfo, &allocCreateInfo, &m_SkinnedVertexBuffer, &m_SkinnedVertexBufferAlloc, NULL);
+
+	// The skinning pass only rewrites positions and the tangent frame, uvs and colors come from this copy
+	VulkanUtils::CopyBuffer(device, transferPool, transferQueue, m_VertexBuffer, m_SkinnedVertexBuffer, vertexBufferSize);
+}
+
+void Mesh::CreateMeshletBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice)
+{
+	if (m_Meshlets.empty())
+		return;
+
+	CPU_ZONE("Mesh::CreateMeshletBuffers");
+
+	CreateDeviceBuffer(allocator, device, transferPool, transferQueue, transferFamilyIndice, graphicFamilyIndice, computeFamilyIndice, m_Meshlets.data(), m_Meshlets.size() * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_MeshletBuffer, m_MeshletBufferAlloc);
+
+	CreateDeviceBuffer(allocator, device, transferPool, transferQueue, transferFamilyIndice, graphicFamilyIndice, computeFamilyIndice, m_MeshletData.data(), m_MeshletData.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_MeshletDataBuffer, m_MeshletDataBufferAlloc);
+}
+
+void Mesh::CreateDeviceBuffer(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation)
+{
+	uint32_t queueFamilyIndices[2] = { transferFamilyIndice, graphicFamilyIndice };
+	std::vector<uint32_t> deviceQueueFamilyIndices = GetUniqueQueueFamilies({ transferFamilyIndice, graphicFamilyIndice, computeFamilyIndice });
+
+	VkBufferCreateInfo stagingBufferInfo = {};
+	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	stagingBufferInfo.size = size;
+	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	stagingBufferInfo.sharingMode = transferFamilyIndice != graphicFamilyIndice ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	stagingBufferInfo.queueFamilyIndexCount = transferFamilyIndice != graphicFamilyIndice ? 2 : 1;
+	stagingBufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+
+	VmaAllocationCreateInfo stagingAllocInfo = {};
+	stagingAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+	VkBuffer stagingBuf = {};
+	VmaAllocation stagingAlloc = {};
+	vmaCreateBuffer(allocator, &stagingBufferInfo, &stagingAllocInfo, &stagingBuf, &stagingAlloc, NULL);
+
+	void* mapped = nullptr;
+	vmaMapMemory(allocator, stagingAlloc, &mapped);
+	memcpy(mapped, data, (size_t)size);
+	vmaUnmapMemory(allocator, stagingAlloc);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = deviceQueueFamilyIndices.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(deviceQueueFamilyIndices.size());
+	bufferInfo.pQueueFamilyIndices = deviceQueueFamilyIndices.data();
+
+	VmaAllocationCreateInfo allocCreateInfo = {};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	allocCreateInfo.priority = 1.0f;
+
+	vmaCreateBuffer(allocator, &bufferInfo, &allocCreateInfo, &buffer, &allocation, NULL);
+
+	VulkanUtils::CopyBuffer(device, transferPool, transferQueue, stagingBuf, buffer, size);
+
+	vkDestroyBuffer(device, stagingBuf, nullptr);
+	vmaFreeMemory(allocator, stagingAlloc);
+}
+
+std::vector<uint32_t> Mesh::GetUniqueQueueFamilies(const std::vector<uint32_t>& queueFamilyIndices)
+{
+	std::vector<uint32_t> uniqueQueueFamilies;
+
+	for (uint32_t queueFamilyIndex : queueFamilyIndices)
+	{
+		if (std::find(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end(), queueFamilyIndex) == uniqueQueueFamilies.end())
+			uniqueQueueFamilies.push_back(queueFamilyIndex);
+	}
+
+	return uniqueQueueFamilies;
+}
+
+VkBuffer Mesh::GetVertexBuffer()
+{
+	return m_VertexBuffer;
+}
+
+VkBuffer Mesh::GetSkinBuffer()
+{
+	return m_SkinBuffer;
+}
+
+VkBuffer Mesh::GetSkinnedVertexBuffer()
+{
+	return m_SkinnedVertexBuffer;
+}
+
+VkBuffer Mesh::GetMeshletBuffer()
+{
+	return m_MeshletBuffer;
+}
+
+VkBuffer Mesh::GetMeshletDataBuffer()
+{
+	return m_MeshletDataBuffer;
+}
+
 void Mesh::BindVertexBuffer(VkCommandBuffer commandBuffer)
 {
-	VkBuffer vertexBuffers[] = { m_VertexBuffer };
+	VkBuffer vertexBuffers[] = { m_SkinnedVertexBuffer != VK_NULL_HANDLE ? m_SkinnedVertexBuffer : m_VertexBuffer };
 	VkDeviceSize offsets[] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 }
 
 void Mesh::BindIndexBuffer(VkCommandBuffer commandBuffer)
 {
-	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, m_IndexType);
+}
+
+VkIndexType Mesh::GetIndexType()
+{
+	return m_IndexType;
+}
+
+uint32_t Mesh::GetIndexSize(VkIndexType indexType)
+{
+	return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
 }
 
 bool Mesh::GetAccelerationStructureGeometrys(VkDevice device, std::vector<VkAccelerationStructureGeometryKHR>& accelerationStructureGeometrys)
@@ -189,7 +449,7 @@ bool Mesh::GetAccelerationStructureGeometrys(VkDevice device, std::vector<VkAcce
 	deviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
 	deviceAddressInfo.pNext = NULL;
 	
-	deviceAddressInfo.buffer = m_VertexBuffer;
+	deviceAddressInfo.buffer = m_SkinnedVertexBuffer != VK_NULL_HANDLE ? m_SkinnedVertexBuffer : m_VertexBuffer;
 	uint64_t vertexDeviceAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
 	
 	deviceAddressInfo.buffer = m_IndexBuffer;
@@ -216,7 +476,7 @@ bool Mesh::GetAccelerationStructureGeometrys(VkDevice device, std::vector<VkAcce
 		accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
 		accelerationStructureGeometry.geometry.triangles.maxVertex = primitive.vertexCount - 1;
 		accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(Vertex);
-		accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+		accelerationStructureGeometry.geometry.triangles.indexType = m_IndexType;
 
 		accelerationStructureGeometrys.emplace_back(accelerationStructureGeometry);
 	}
@@ -230,9 +490,11 @@ void Mesh::GetAccelerationStructureRangeInfos(std::vector<VkAccelerationStructur
 	
 	for(int i = 0; i < m_Primitves.size(); i++)
 	{
+		PrimitiveLod lod = GetPrimitiveLod(i, m_AccelerationStructureLod);
+
 		VkAccelerationStructureBuildRangeInfoKHR rangeInfo = {};
-		rangeInfo.primitiveCount = m_Primitves[i].indexCount / 3;
-		rangeInfo.primitiveOffset = m_Primitves[i].firstIndex * sizeof(uint32_t);
+		rangeInfo.primitiveCount = lod.indexCount / 3;
+		rangeInfo.primitiveOffset = lod.firstIndex * GetIndexSize(m_IndexType);
 		rangeInfo.firstVertex = m_Primitves[i].vertexOffset;
 		rangeInfo.transformOffset = 0;
 
@@ -244,8 +506,8 @@ void Mesh::GetPrimitvesTrianglesCounts(std::vector<uint32_t>& primitivesTriangle
 {
 	primitivesTrianglesCounts.reserve(m_Primitves.size());
 
-	for(Primitive& primitive : m_Primitves)
-		primitivesTrianglesCounts.emplace_back(primitive.indexCount / 3);
+	for(size_t i = 0; i < m_Primitves.size(); i++)
+		primitivesTrianglesCounts.emplace_back(GetPrimitiveLod(i, m_AccelerationStructureLod).indexCount / 3);
 }
 
 const glm::mat4& Mesh::GetModel()
@@ -255,12 +517,25 @@ const glm::mat4& Mesh::GetModel()
 
 void Mesh::SetModel(const glm::mat4& model)
 {
+	if (model == m_Model)
+		return;
+
 	m_Model = model;
+	m_TransformVersion++;
+}
+
+uint32_t Mesh::GetTransformVersion()
+{
+	return m_TransformVersion;
 }
 
 void Mesh::SetOccluder(bool occluder)
 {
+	if (occluder == m_Occluder)
+		return;
+
 	m_Occluder = occluder;
+	m_TransformVersion++;
 }
 
 bool Mesh::IsOccluder()
@@ -301,7 +576,10 @@ void Mesh::AutoComputeTangentsBiTangentsPrimitive(size_t primitiveIndex)
 	uint32_t lastPrimitiveVertexIdx = p.vertexOffset + p.vertexCount;
 
 	for (uint32_t i = p.vertexOffset; i < lastPrimitiveVertexIdx; i++)
+	{
 		m_Vertexs[i].tangent = glm::vec3(0.F);
+		m_Vertexs[i].biTangent = glm::vec3(0.F);
+	}
 
 	for (uint32_t i = p.firstIndex; i < p.firstIndex + p.indexCount; i += 3)
 	{
@@ -365,12 +643,16 @@ void Mesh::AutoComputeBiTangentsPrimitive(size_t primitiveIndex)
 
 void Mesh::AutoComputeNormals()
 {
+	CPU_ZONE("Mesh::AutoComputeNormals");
+
 	for (size_t i = 0; i < m_Primitves.size(); i++)
 		AutoComputeNormalsPrimitive(i);
 }
 
 void Mesh::AutoComputeTangentsBiTangents()
 {
+	CPU_ZONE("Mesh::AutoComputeTangentsBiTangents");
+
 	for (size_t i = 0; i < m_Primitves.size(); i++)
 		AutoComputeTangentsBiTangentsPrimitive(i);
 }
@@ -381,8 +663,1552 @@ void Mesh::AutoComputeBiTangents()
 		AutoComputeBiTangentsPrimitive(i);
 }
 
-void Mesh::AverageDuplicatedVertexNormals()
+void Mesh::AutoComputeMikkTSpaceTangents()
+{
+	std::vector<size_t> primitiveIndexes(m_Primitves.size());
+	std::iota(primitiveIndexes.begin(), primitiveIndexes.end(), 0);
+
+	AutoComputeMikkTSpaceTangents(primitiveIndexes);
+}
+
+void Mesh::AutoComputeMikkTSpaceTangents(const std::vector<size_t>& primitiveIndexes)
+{
+	CPU_ZONE("Mesh::AutoComputeMikkTSpaceTangents");
+
+	if (primitiveIndexes.empty())
+		return;
+
+	std::vector<MikkTSpacePrimitive> results(primitiveIndexes.size());
+	std::atomic<size_t> nextPrimitive = 0;
+
+	auto worker = [&]()
+	{
+		for (size_t i = nextPrimitive++; i < primitiveIndexes.size(); i = nextPrimitive++)
+			ComputeMikkTSpacePrimitive(primitiveIndexes[i], results[i]);
+	};
+
+	size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), primitiveIndexes.size());
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// Last vertex ranges first, the vertices split off a primitive then only move the ranges already done
+	std::vector<size_t> order(primitiveIndexes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return m_Primitves[primitiveIndexes[a]].vertexOffset > m_Primitves[primitiveIndexes[b]].vertexOffset; });
+
+	for (size_t i : order)
+		ApplyMikkTSpacePrimitive(primitiveIndexes[i], results[i]);
+}
+
+// Position, normal and UV bits, -0 and 0 folded together
+struct MikkTSpaceWeldKey
+{
+	uint32_t bits[8];
+
+	explicit MikkTSpaceWeldKey(const Vertex& vertex)
+	{
+		float values[8] = { vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.normal.x, vertex.normal.y, vertex.normal.z, vertex.tex_coord.x, vertex.tex_coord.y };
+		for (int i = 0; i < 8; i++)
+		{
+			float value = values[i] + 0.f;
+			memcpy(&bits[i], &value, sizeof(float));
+		}
+	}
+
+	bool operator<(const MikkTSpaceWeldKey& other) const
+	{
+		return memcmp(bits, other.bits, sizeof(bits)) < 0;
+	}
+};
+
+static uint32_t FindMikkTSpaceGroup(std::vector<uint32_t>& parents, uint32_t corner)
+{
+	while (parents[corner] != corner)
+	{
+		parents[corner] = parents[parents[corner]];
+		corner = parents[corner];
+	}
+
+	return corner;
+}
+
+// Vector projected on the plane of normal and normalized, left as is when the projection is zero like MikkTSpace does
+static glm::vec3 ProjectMikkTSpace(const glm::vec3& vector, const glm::vec3& normal)
+{
+	glm::vec3 projected = vector - glm::dot(normal, vector) * normal;
+	float length = glm::length(projected);
+
+	return length > FLT_MIN ? projected / length : projected;
+}
+
+// Corners with no usable UV mapping anywhere around them
+static glm::vec3 AnyMikkTSpaceTangent(const glm::vec3& normal)
+{
+	glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+
+	return glm::normalize(axis - glm::dot(axis, normal) * normal);
+}
+
+void Mesh::ComputeMikkTSpacePrimitive(size_t primitiveIndex, MikkTSpacePrimitive& result) const
 {
+	CPU_ZONE("Mesh::ComputeMikkTSpacePrimitive");
+
+	const Primitive& p = m_Primitves[primitiveIndex];
+	const Vertex* vertexs = m_Vertexs.data() + p.vertexOffset;
+	const uint32_t* indexes = m_Indexes.data() + p.firstIndex;
+	uint32_t triangleCount = p.indexCount / 3;
+	uint32_t cornerCount = triangleCount * 3;
+
+	// Vertices equal in position, normal and UV are one vertex for the grouping even when their indexes differ
+	std::vector<MikkTSpaceWeldKey> weldKeys;
+	weldKeys.reserve(p.vertexCount);
+	for (uint32_t v = 0; v < p.vertexCount; v++)
+		weldKeys.emplace_back(vertexs[v]);
+
+	std::vector<uint32_t> sortedVertexs(p.vertexCount);
+	std::iota(sortedVertexs.begin(), sortedVertexs.end(), 0);
+	std::sort(sortedVertexs.begin(), sortedVertexs.end(), [&](uint32_t a, uint32_t b) { return weldKeys[a] < weldKeys[b]; });
+
+	std::vector<uint32_t> welded(p.vertexCount);
+	uint32_t weldedCount = 0;
+
+	for (uint32_t i = 0; i < p.vertexCount; i++)
+	{
+		if (i > 0 && !(weldKeys[sortedVertexs[i - 1]] < weldKeys[sortedVertexs[i]]))
+			welded[sortedVertexs[i]] = welded[sortedVertexs[i - 1]];
+		else
+			welded[sortedVertexs[i]] = weldedCount++;
+	}
+
+	// Face tangent and bitangent directions, flipped on mirrored triangles so they follow the UV directions
+	std::vector<glm::vec3> faceTangents(triangleCount);
+	std::vector<uint8_t> orientPreserving(triangleCount);
+	std::vector<uint8_t> valid(triangleCount);
+
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const Vertex& v0 = vertexs[indexes[3 * t]];
+		const Vertex& v1 = vertexs[indexes[3 * t + 1]];
+		const Vertex& v2 = vertexs[indexes[3 * t + 2]];
+
+		glm::vec3 E1 = v1.pos - v0.pos;
+		glm::vec3 E2 = v2.pos - v0.pos;
+
+		float u10 = v1.tex_coord.x - v0.tex_coord.x;
+		float v10 = v1.tex_coord.y - v0.tex_coord.y;
+		float u20 = v2.tex_coord.x - v0.tex_coord.x;
+		float v20 = v2.tex_coord.y - v0.tex_coord.y;
+
+		float signedArea = u10 * v20 - v10 * u20;
+
+		glm::vec3 tangent = v20 * E1 - v10 * E2;
+		glm::vec3 biTangent = u10 * E2 - u20 * E1;
+		float tangentLength = glm::length(tangent);
+
+		orientPreserving[t] = signedArea > 0.f;
+		valid[t] = std::abs(signedArea) > FLT_MIN && tangentLength > FLT_MIN && glm::length(biTangent) > FLT_MIN;
+
+		if (valid[t])
+			faceTangents[t] = tangent * ((orientPreserving[t] ? 1.f : -1.f) / tangentLength);
+	}
+
+	// Corners of each welded vertex, to find the triangle across an edge
+	std::vector<uint32_t> cornerStarts(weldedCount + 1, 0);
+	for (uint32_t c = 0; c < cornerCount; c++)
+		cornerStarts[welded[indexes[c]] + 1]++;
+	for (uint32_t w = 0; w < weldedCount; w++)
+		cornerStarts[w + 1] += cornerStarts[w];
+
+	std::vector<uint32_t> vertexCorners(cornerCount);
+	std::vector<uint32_t> cornerFill(cornerStarts.begin(), cornerStarts.end() - 1);
+	for (uint32_t c = 0; c < cornerCount; c++)
+		vertexCorners[cornerFill[welded[indexes[c]]]++] = c;
+
+	// Corners are grouped across the edges shared by triangles of the same orientation, every group is one tangent frame
+	std::vector<uint32_t> parents(cornerCount);
+	std::iota(parents.begin(), parents.end(), 0);
+
+	for (uint32_t c = 0; c < cornerCount; c++)
+	{
+		uint32_t t = c / 3;
+		uint32_t next = c - c % 3 + (c + 1) % 3;
+
+		if (!valid[t])
+			continue;
+
+		uint32_t from = welded[indexes[c]];
+		uint32_t to = welded[indexes[next]];
+
+		// The same edge the other way around, first match only like MikkTSpace on non manifold edges
+		for (uint32_t i = cornerStarts[to]; i < cornerStarts[to + 1]; i++)
+		{
+			uint32_t otherCorner = vertexCorners[i];
+			uint32_t otherTriangle = otherCorner / 3;
+			uint32_t otherNext = otherCorner - otherCorner % 3 + (otherCorner + 1) % 3;
+
+			if (otherTriangle == t || welded[indexes[otherNext]] != from)
+				continue;
+
+			if (valid[otherTriangle] && orientPreserving[otherTriangle] == orientPreserving[t])
+			{
+				parents[FindMikkTSpaceGroup(parents, c)] = FindMikkTSpaceGroup(parents, otherNext);
+				parents[FindMikkTSpaceGroup(parents, next)] = FindMikkTSpaceGroup(parents, otherCorner);
+			}
+			break;
+		}
+	}
+
+	std::vector<uint32_t> groups(cornerCount);
+	for (uint32_t c = 0; c < cornerCount; c++)
+		groups[c] = FindMikkTSpaceGroup(parents, c);
+
+	// Face tangents projected on each corner normal, weighted by the corner angle
+	std::vector<glm::vec3> groupTangents(cornerCount, glm::vec3(0.f));
+
+	for (uint32_t c = 0; c < cornerCount; c++)
+	{
+		uint32_t t = c / 3;
+
+		if (!valid[t])
+			continue;
+
+		const Vertex& vertex = vertexs[indexes[c]];
+		const glm::vec3& previous = vertexs[indexes[c - c % 3 + (c + 2) % 3]].pos;
+		const glm::vec3& next = vertexs[indexes[c - c % 3 + (c + 1) % 3]].pos;
+
+		glm::vec3 edge0 = ProjectMikkTSpace(previous - vertex.pos, vertex.normal);
+		glm::vec3 edge1 = ProjectMikkTSpace(next - vertex.pos, vertex.normal);
+		float angle = std::acos(std::clamp(glm::dot(edge0, edge1), -1.f, 1.f));
+
+		groupTangents[groups[c]] += angle * ProjectMikkTSpace(faceTangents[t], vertex.normal);
+	}
+
+	// Corners of degenerate triangles take a group of their vertex
+	std::vector<uint32_t> weldedGroups(weldedCount, UINT32_MAX);
+
+	for (uint32_t c = 0; c < cornerCount; c++)
+	{
+		if (valid[c / 3] && weldedGroups[welded[indexes[c]]] == UINT32_MAX)
+			weldedGroups[welded[indexes[c]]] = groups[c];
+	}
+
+	// First frame of a vertex keeps it, every other frame gets a copy
+	struct Frame
+	{
+		glm::vec3 tangent;
+		float sign;
+		uint32_t vertex;
+		uint32_t next;
+	};
+
+	std::vector<Frame> frames;
+	std::vector<uint32_t> firstFrames(p.vertexCount, UINT32_MAX);
+
+	result.tangents.resize(p.vertexCount);
+	result.biTangents.resize(p.vertexCount);
+	result.splitSources.clear();
+	result.indexes.resize(cornerCount);
+
+	for (uint32_t c = 0; c < cornerCount; c++)
+	{
+		uint32_t v = indexes[c];
+		const glm::vec3& normal = vertexs[v].normal;
+
+		uint32_t group = valid[c / 3] ? groups[c] : weldedGroups[welded[v]];
+
+		glm::vec3 tangent = AnyMikkTSpaceTangent(normal);
+		float sign = 1.f;
+
+		if (group != UINT32_MAX)
+		{
+			float length = glm::length(groupTangents[group]);
+			if (length > FLT_MIN)
+				tangent = groupTangents[group] / length;
+			sign = orientPreserving[group / 3] ? 1.f : -1.f;
+		}
+
+		uint32_t frame = firstFrames[v];
+		while (frame != UINT32_MAX && (frames[frame].tangent != tangent || frames[frame].sign != sign))
+			frame = frames[frame].next;
+
+		if (frame == UINT32_MAX)
+		{
+			uint32_t output = v;
+			if (firstFrames[v] != UINT32_MAX)
+			{
+				output = p.vertexCount + static_cast<uint32_t>(result.splitSources.size());
+				result.splitSources.push_back(v);
+				result.tangents.emplace_back();
+				result.biTangents.emplace_back();
+			}
+
+			result.tangents[output] = tangent;
+			result.biTangents[output] = glm::cross(normal, tangent) * sign;
+
+			frame = static_cast<uint32_t>(frames.size());
+			frames.push_back(Frame{ tangent, sign, output, firstFrames[v] });
+			firstFrames[v] = frame;
+		}
+
+		result.indexes[c] = frames[frame].vertex;
+	}
+
+	// Vertices no triangle uses
+	for (uint32_t v = 0; v < p.vertexCount; v++)
+	{
+		if (firstFrames[v] == UINT32_MAX)
+		{
+			result.tangents[v] = AnyMikkTSpaceTangent(vertexs[v].normal);
+			result.biTangents[v] = glm::cross(vertexs[v].normal, result.tangents[v]);
+		}
+	}
+}
+
+void Mesh::ApplyMikkTSpacePrimitive(size_t primitiveIndex, const MikkTSpacePrimitive& result)
+{
+	Primitive& p = m_Primitves[primitiveIndex];
+
+	for (uint32_t v = 0; v < p.vertexCount; v++)
+	{
+		m_Vertexs[p.vertexOffset + v].tangent = result.tangents[v];
+		m_Vertexs[p.vertexOffset + v].biTangent = result.biTangents[v];
+	}
+
+	std::copy(result.indexes.begin(), result.indexes.end(), m_Indexes.begin() + p.firstIndex);
+
+	if (result.splitSources.empty())
+		return;
+
+	uint32_t splitCount = static_cast<uint32_t>(result.splitSources.size());
+	uint32_t primitiveEnd = p.vertexOffset + p.vertexCount;
+	bool skinned = m_SkinVertexs.size() == m_Vertexs.size();
+
+	std::vector<Vertex> splitVertexs(splitCount);
+	std::vector<SkinVertex> splitSkinVertexs;
+
+	for (uint32_t s = 0; s < splitCount; s++)
+	{
+		splitVertexs[s] = m_Vertexs[p.vertexOffset + result.splitSources[s]];
+		splitVertexs[s].tangent = result.tangents[p.vertexCount + s];
+		splitVertexs[s].biTangent = result.biTangents[p.vertexCount + s];
+
+		if (skinned)
+			splitSkinVertexs.push_back(m_SkinVertexs[p.vertexOffset + result.splitSources[s]]);
+	}
+
+	m_Vertexs.insert(m_Vertexs.begin() + primitiveEnd, splitVertexs.begin(), splitVertexs.end());
+
+	if (skinned)
+		m_SkinVertexs.insert(m_SkinVertexs.begin() + primitiveEnd, splitSkinVertexs.begin(), splitSkinVertexs.end());
+
+	for (size_t i = 0; i < m_Primitves.size(); i++)
+	{
+		if (i != primitiveIndex && m_Primitves[i].vertexOffset >= primitiveEnd)
+			m_Primitves[i].vertexOffset += splitCount;
+	}
+
+	p.vertexCount += splitCount;
+}
+
+void Mesh::OptimizePrimitive(size_t primitiveIndex)
+{
+	Primitive& p = m_Primitves[primitiveIndex];
+
+	std::vector<uint32_t> indexes(m_Indexes.begin() + p.firstIndex, m_Indexes.begin() + p.firstIndex + p.indexCount);
+	indexes.resize(indexes.size() - indexes.size() % 3);
+	uint32_t triangleCount = static_cast<uint32_t>(indexes.size() / 3);
+
+	// Exporters sometimes already emit a good strip order, kept when the Forsyth one misses more in the cache it targets
+	std::vector<uint32_t> cacheOrder = indexes;
+	OptimizeVertexCache(cacheOrder, p.vertexCount);
+
+	if (ComputeAcmr(cacheOrder.data(), triangleCount, p.vertexCount, MESH_VERTEX_CACHE_SIZE) <= ComputeAcmr(indexes.data(), triangleCount, p.vertexCount, MESH_VERTEX_CACHE_SIZE))
+		indexes = std::move(cacheOrder);
+
+	OptimizeOverdraw(primitiveIndex, indexes);
+
+	// Vertices renumbered in first use order, unused ones keep their relative order at the end
+	std::vector<uint32_t> remap(p.vertexCount, UINT32_MAX);
+	uint32_t nextVertex = 0;
+
+	for (uint32_t& index : indexes)
+	{
+		if (remap[index] == UINT32_MAX)
+			remap[index] = nextVertex++;
+		index = remap[index];
+	}
+
+	for (uint32_t v = 0; v < p.vertexCount; v++)
+	{
+		if (remap[v] == UINT32_MAX)
+			remap[v] = nextVertex++;
+	}
+
+	std::vector<Vertex> vertexs(p.vertexCount);
+	for (uint32_t v = 0; v < p.vertexCount; v++)
+		vertexs[remap[v]] = m_Vertexs[p.vertexOffset + v];
+	std::copy(vertexs.begin(), vertexs.end(), m_Vertexs.begin() + p.vertexOffset);
+
+	if (m_SkinVertexs.size() == m_Vertexs.size())
+	{
+		std::vector<SkinVertex> skinVertexs(p.vertexCount);
+		for (uint32_t v = 0; v < p.vertexCount; v++)
+			skinVertexs[remap[v]] = m_SkinVertexs[p.vertexOffset + v];
+		std::copy(skinVertexs.begin(), skinVertexs.end(), m_SkinVertexs.begin() + p.vertexOffset);
+	}
+
+	std::copy(indexes.begin(), indexes.end(), m_Indexes.begin() + p.firstIndex);
+
+	for (uint32_t level = 0; level < p.lodCount; level++)
+	{
+		const PrimitiveLod& lod = m_Lods[p.lodOffset + level];
+
+		std::vector<uint32_t> lodIndexes(m_Indexes.begin() + lod.firstIndex, m_Indexes.begin() + lod.firstIndex + lod.indexCount);
+		OptimizeVertexCache(lodIndexes, p.vertexCount);
+
+		for (uint32_t i = 0; i < lod.indexCount; i++)
+			m_Indexes[lod.firstIndex + i] = remap[lodIndexes[i]];
+	}
+}
+
+void Mesh::Optimize()
+{
+	CPU_ZONE("Mesh::Optimize");
+
+	for (size_t i = 0; i < m_Primitves.size(); i++)
+		OptimizePrimitive(i);
+}
+
+float Mesh::ComputeAcmr(size_t primitiveIndex, uint32_t cacheSize) const
+{
+	const Primitive& p = m_Primitves[primitiveIndex];
+
+	return ComputeAcmr(m_Indexes.data() + p.firstIndex, p.indexCount / 3, p.vertexCount, cacheSize);
+}
+
+float Mesh::ComputeAcmr(const uint32_t* indexes, uint32_t triangleCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	if (triangleCount == 0)
+		return 0.f;
+
+	// Time each vertex entered the cache, it is still in while fewer than cacheSize misses happened since
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t misses = 0;
+
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		uint32_t v = indexes[i];
+
+		if (cacheTimes[v] == 0 || misses - cacheTimes[v] + 1 > cacheSize)
+		{
+			misses++;
+			cacheTimes[v] = misses;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(triangleCount);
+}
+
+float Mesh::ComputeAcmr(uint32_t cacheSize) const
+{
+	float misses = 0.f;
+	uint32_t triangleCount = 0;
+
+	for (size_t i = 0; i < m_Primitves.size(); i++)
+	{
+		misses += ComputeAcmr(i, cacheSize) * static_cast<float>(m_Primitves[i].indexCount / 3);
+		triangleCount += m_Primitves[i].indexCount / 3;
+	}
+
+	return triangleCount > 0 ? misses / static_cast<float>(triangleCount) : 0.f;
+}
+
+void Mesh::BuildMeshlets()
+{
+	CPU_ZONE("Mesh::BuildMeshlets");
+
+	m_Meshlets.clear();
+	m_MeshletData.clear();
+
+	for (Primitive& p : m_Primitves)
+	{
+		for (uint32_t level = 0; level <= p.lodCount; level++)
+		{
+			// Every level gets its own meshlets, the original one in the primitive, the simplified ones in their LOD
+			PrimitiveLod* lod = level > 0 ? &m_Lods[p.lodOffset + level - 1] : nullptr;
+			uint32_t meshletOffset = static_cast<uint32_t>(m_Meshlets.size());
+
+			const Vertex* vertexs = m_Vertexs.data() + p.vertexOffset;
+			const uint32_t* indexes = m_Indexes.data() + (lod ? lod->firstIndex : p.firstIndex);
+			uint32_t triangleCount = (lod ? lod->indexCount : p.indexCount) / 3;
+
+			// Local index of the primitive vertices in the meshlet being filled
+			std::vector<uint8_t> localIndexes(p.vertexCount, UINT8_MAX);
+			std::vector<uint32_t> meshletVertexs;
+			std::vector<uint32_t> meshletTriangles;
+			meshletVertexs.reserve(MESHLET_MAX_VERTICES);
+			meshletTriangles.reserve(MESHLET_MAX_TRIANGLES);
+
+			auto flush = [&]()
+			{
+				if (meshletTriangles.empty())
+					return;
+
+				Meshlet meshlet{};
+				meshlet.vertexOffset = static_cast<uint32_t>(m_MeshletData.size());
+				meshlet.vertexCount = static_cast<uint32_t>(meshletVertexs.size());
+				meshlet.triangleOffset = meshlet.vertexOffset + meshlet.vertexCount;
+				meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size());
+
+				glm::vec3 minimum(FLT_MAX);
+				glm::vec3 maximum(-FLT_MAX);
+
+				for (uint32_t v : meshletVertexs)
+				{
+					minimum = glm::min(minimum, vertexs[v].pos);
+					maximum = glm::max(maximum, vertexs[v].pos);
+					m_MeshletData.push_back(p.vertexOffset + v);
+				}
+
+				glm::vec3 center = (minimum + maximum) * 0.5f;
+				float radius = 0.f;
+
+				for (uint32_t v : meshletVertexs)
+					radius = std::max(radius, glm::length(vertexs[v].pos - center));
+
+				meshlet.boundingSphere = glm::vec4(center, radius);
+
+				// Face normals rather than the vertex ones, smoothing would let a back facing triangle through
+				std::array<glm::vec3, MESHLET_MAX_TRIANGLES> normals;
+				uint32_t normalCount = 0;
+				glm::vec3 axis(0.f);
+
+				for (uint32_t packed : meshletTriangles)
+				{
+					const glm::vec3& p0 = vertexs[meshletVertexs[packed & 0xFF]].pos;
+					const glm::vec3& p1 = vertexs[meshletVertexs[(packed >> 8) & 0xFF]].pos;
+					const glm::vec3& p2 = vertexs[meshletVertexs[(packed >> 16) & 0xFF]].pos;
+
+					glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					float length = glm::length(normal);
+
+					if (length > FLT_MIN)
+					{
+						normals[normalCount++] = normal / length;
+						axis += normal / length;
+					}
+
+					m_MeshletData.push_back(packed);
+				}
+
+				// A cutoff of 1 never culls: degenerate meshlets and ones whose triangles face more than a half space
+				float cutoff = 1.f;
+				float axisLength = glm::length(axis);
+
+				if (axisLength > FLT_MIN)
+				{
+					axis /= axisLength;
+
+					float minimumDot = 1.f;
+					for (uint32_t t = 0; t < normalCount; t++)
+						minimumDot = std::min(minimumDot, glm::dot(normals[t], axis));
+
+					if (minimumDot > 0.1f)
+						cutoff = std::sqrt(1.f - minimumDot * minimumDot);
+				}
+
+				meshlet.cone = glm::vec4(axis, cutoff);
+
+				m_Meshlets.push_back(meshlet);
+
+				for (uint32_t v : meshletVertexs)
+					localIndexes[v] = UINT8_MAX;
+
+				meshletVertexs.clear();
+				meshletTriangles.clear();
+			};
+
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				const uint32_t* triangle = indexes + t * 3;
+
+				uint32_t newVertexs = 0;
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					bool repeated = (c > 0 && triangle[c] == triangle[0]) || (c > 1 && triangle[c] == triangle[1]);
+					if (localIndexes[triangle[c]] == UINT8_MAX && !repeated)
+						newVertexs++;
+				}
+
+				if (meshletVertexs.size() + newVertexs > MESHLET_MAX_VERTICES || meshletTriangles.size() == MESHLET_MAX_TRIANGLES)
+					flush();
+
+				uint32_t packed = 0;
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					uint32_t v = triangle[c];
+					if (localIndexes[v] == UINT8_MAX)
+					{
+						localIndexes[v] = static_cast<uint8_t>(meshletVertexs.size());
+						meshletVertexs.push_back(v);
+					}
+
+					packed |= static_cast<uint32_t>(localIndexes[v]) << (c * 8);
+				}
+
+				meshletTriangles.push_back(packed);
+			}
+
+			flush();
+
+			uint32_t meshletCount = static_cast<uint32_t>(m_Meshlets.size()) - meshletOffset;
+
+			if (lod)
+			{
+				lod->meshletOffset = meshletOffset;
+				lod->meshletCount = meshletCount;
+			}
+			else
+			{
+				p.meshletOffset = meshletOffset;
+				p.meshletCount = meshletCount;
+			}
+		}
+	}
+}
+
+const std::vector<Meshlet>& Mesh::GetMeshlets()
+{
+	return m_Meshlets;
+}
+
+bool Mesh::HasMeshlets()
+{
+	return !m_Meshlets.empty();
+}
+
+void Mesh::GenerateLods()
+{
+	CPU_ZONE("Mesh::GenerateLods");
+
+	// Levels from a previous call are dropped, they sit after every primitive range
+	if (!m_Lods.empty())
+	{
+		uint32_t indexCount = 0;
+		for (const Primitive& p : m_Primitves)
+			indexCount = std::max(indexCount, p.firstIndex + p.indexCount);
+		m_Indexes.resize(indexCount);
+	}
+
+	for (Primitive& p : m_Primitves)
+	{
+		p.lodOffset = 0;
+		p.lodCount = 0;
+	}
+
+	m_Lods.clear();
+	m_LodErrors.assign(1, 0.f);
+	m_Lod = 0;
+	m_AccelerationStructureLod = 0;
+
+	glm::vec3 minimum(FLT_MAX);
+	glm::vec3 maximum(-FLT_MAX);
+
+	for (const Vertex& vertex : m_Vertexs)
+	{
+		minimum = glm::min(minimum, vertex.pos);
+		maximum = glm::max(maximum, vertex.pos);
+	}
+
+	glm::vec3 center = m_Vertexs.empty() ? glm::vec3(0.f) : (minimum + maximum) * 0.5f;
+	float radius = 0.f;
+
+	for (const Vertex& vertex : m_Vertexs)
+		radius = std::max(radius, glm::length(vertex.pos - center));
+
+	m_BoundingSphere = glm::vec4(center, radius);
+
+	std::vector<LodPrimitive> results(m_Primitves.size());
+	std::atomic<size_t> nextPrimitive = 0;
+
+	auto worker = [&]()
+	{
+		for (size_t i = nextPrimitive++; i < m_Primitves.size(); i = nextPrimitive++)
+			ComputeLodsPrimitive(i, results[i]);
+	};
+
+	size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), m_Primitves.size());
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// Simplified indexes after every original one, the ranges of the primitives do not move
+	for (size_t i = 0; i < m_Primitves.size(); i++)
+	{
+		Primitive& p = m_Primitves[i];
+		p.lodOffset = static_cast<uint32_t>(m_Lods.size());
+		p.lodCount = static_cast<uint32_t>(results[i].levels.size());
+
+		for (size_t level = 0; level < results[i].levels.size(); level++)
+		{
+			const std::vector<uint32_t>& indexes = results[i].levels[level];
+
+			PrimitiveLod lod{};
+			lod.firstIndex = static_cast<uint32_t>(m_Indexes.size());
+			lod.indexCount = static_cast<uint32_t>(indexes.size());
+			lod.error = results[i].errors[level];
+			m_Lods.push_back(lod);
+
+			m_Indexes.insert(m_Indexes.end(), indexes.begin(), indexes.end());
+
+			if (m_LodErrors.size() < level + 2)
+				m_LodErrors.push_back(0.f);
+		}
+	}
+
+	// Primitives with fewer levels stay on their last one, their error counts for the levels past it
+	for (uint32_t level = 1; level < m_LodErrors.size(); level++)
+	{
+		for (size_t i = 0; i < m_Primitves.size(); i++)
+			m_LodErrors[level] = std::max(m_LodErrors[level], GetPrimitiveLod(i, level).error);
+	}
+}
+
+// Symmetric 4x4 error matrix of a set of planes, weighted by area: the squared distance of a point to them is
+// p A p + 2 b.p + c, divided by the weight
+struct LodQuadric
+{
+	double a00, a11, a22, a10, a20, a21;
+	double b0, b1, b2;
+	double c;
+	double weight;
+
+	void AddPlane(const glm::vec3& normal, float d, float planeWeight)
+	{
+		double x = normal.x, y = normal.y, z = normal.z, w = planeWeight;
+		a00 += w * x * x; a11 += w * y * y; a22 += w * z * z;
+		a10 += w * y * x; a20 += w * z * x; a21 += w * z * y;
+		b0 += w * x * d; b1 += w * y * d; b2 += w * z * d;
+		c += w * d * d;
+		weight += w;
+	}
+
+	void Add(const LodQuadric& other)
+	{
+		a00 += other.a00; a11 += other.a11; a22 += other.a22;
+		a10 += other.a10; a20 += other.a20; a21 += other.a21;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+	}
+
+	double Error(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double rx = a00 * x + a10 * y + a20 * z;
+		double ry = a10 * x + a11 * y + a21 * z;
+		double rz = a20 * x + a21 * y + a22 * z;
+		double error = rx * x + ry * y + rz * z + 2. * (b0 * x + b1 * y + b2 * z) + c;
+		return weight > 0. ? std::max(error, 0.) / weight : 0.;
+	}
+};
+
+// What a vertex may collapse onto: any neighbour, a neighbour along its border, or nothing
+enum LodVertexKind : uint8_t
+{
+	LOD_VERTEX_MANIFOLD,
+	LOD_VERTEX_BORDER,
+	LOD_VERTEX_LOCKED
+};
+
+// Border edges weigh more than the faces, open outlines keep their shape
+#define LOD_BORDER_WEIGHT 10.f
+
+void Mesh::ComputeLodsPrimitive(size_t primitiveIndex, LodPrimitive& result) const
+{
+	const Primitive& p = m_Primitves[primitiveIndex];
+	const Vertex* vertexs = m_Vertexs.data() + p.vertexOffset;
+
+	std::vector<uint32_t> indexes(m_Indexes.begin() + p.firstIndex, m_Indexes.begin() + p.firstIndex + p.indexCount);
+	indexes.resize(indexes.size() - indexes.size() % 3);
+
+	result.levels.clear();
+	result.errors.clear();
+
+	if (indexes.size() / 3 < MESH_LOD_MIN_TRIANGLES)
+		return;
+
+	uint32_t vertexCount = p.vertexCount;
+	uint32_t cornerCount = static_cast<uint32_t>(indexes.size());
+
+	// Vertices sharing a position are wedges split on an attribute seam, linked in a ring. Each of them sees its side of the
+	// seam as a border, they collapse together along it so the seam moves as one and never tears open
+	std::vector<uint32_t> sorted(vertexCount);
+	std::iota(sorted.begin(), sorted.end(), 0);
+	auto positionLess = [&](uint32_t a, uint32_t b)
+	{
+		const glm::vec3& pa = vertexs[a].pos;
+		const glm::vec3& pb = vertexs[b].pos;
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		return pa.z != pb.z ? pa.z < pb.z : a < b;
+	};
+	std::sort(sorted.begin(), sorted.end(), positionLess);
+
+	std::vector<uint32_t> wedgeNext(vertexCount);
+	// Lowest index of each ring, the only one seam collapses are proposed from
+	std::vector<uint8_t> wedgeHead(vertexCount, 0);
+
+	for (uint32_t first = 0; first < vertexCount;)
+	{
+		uint32_t last = first + 1;
+		while (last < vertexCount && vertexs[sorted[last]].pos == vertexs[sorted[first]].pos)
+			last++;
+
+		for (uint32_t i = first; i < last; i++)
+			wedgeNext[sorted[i]] = sorted[i + 1 < last ? i + 1 : first];
+		wedgeHead[sorted[first]] = 1;
+
+		first = last;
+	}
+
+	std::vector<LodVertexKind> kinds(vertexCount, LOD_VERTEX_MANIFOLD);
+
+	// Directed edges sorted by their start, an edge without its opposite is on a border
+	std::vector<uint64_t> edges(cornerCount);
+	for (uint32_t c = 0; c < cornerCount; c++)
+	{
+		uint32_t next = c - c % 3 + (c + 1) % 3;
+		edges[c] = (static_cast<uint64_t>(indexes[c]) << 32) | indexes[next];
+	}
+	std::sort(edges.begin(), edges.end());
+
+	auto hasEdge = [&](uint32_t from, uint32_t to)
+	{
+		return std::binary_search(edges.begin(), edges.end(), (static_cast<uint64_t>(from) << 32) | to);
+	};
+
+	// Neighbours along the border, one going out and one coming in for a simple border vertex
+	std::vector<uint32_t> borderNext(vertexCount, UINT32_MAX);
+	std::vector<uint32_t> borderPrevious(vertexCount, UINT32_MAX);
+
+	std::vector<LodQuadric> quadrics(vertexCount, LodQuadric{});
+
+	for (uint32_t t = 0; t < cornerCount / 3; t++)
+	{
+		const glm::vec3& p0 = vertexs[indexes[t * 3]].pos;
+		const glm::vec3& p1 = vertexs[indexes[t * 3 + 1]].pos;
+		const glm::vec3& p2 = vertexs[indexes[t * 3 + 2]].pos;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(normal);
+
+		if (area <= FLT_MIN)
+			continue;
+
+		normal /= area;
+		float d = -glm::dot(normal, p0);
+
+		for (uint32_t c = 0; c < 3; c++)
+			quadrics[indexes[t * 3 + c]].AddPlane(normal, d, area * 0.5f);
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t from = indexes[t * 3 + c];
+			uint32_t to = indexes[t * 3 + (c + 1) % 3];
+
+			if (hasEdge(to, from))
+				continue;
+
+			// Two border edges out of or into a vertex make it a complex one
+			if (borderNext[from] != UINT32_MAX || borderPrevious[to] != UINT32_MAX)
+			{
+				kinds[from] = LOD_VERTEX_LOCKED;
+				kinds[to] = LOD_VERTEX_LOCKED;
+			}
+
+			borderNext[from] = to;
+			borderPrevious[to] = from;
+
+			// Plane through the edge, perpendicular to the face
+			glm::vec3 edge = vertexs[to].pos - vertexs[from].pos;
+			float length = glm::length(edge);
+			if (length <= FLT_MIN)
+				continue;
+
+			glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+			float borderD = -glm::dot(borderNormal, vertexs[from].pos);
+
+			quadrics[from].AddPlane(borderNormal, borderD, length * length * LOD_BORDER_WEIGHT);
+			quadrics[to].AddPlane(borderNormal, borderD, length * length * LOD_BORDER_WEIGHT);
+		}
+	}
+
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (kinds[v] != LOD_VERTEX_MANIFOLD)
+			continue;
+
+		bool next = borderNext[v] != UINT32_MAX;
+		bool previous = borderPrevious[v] != UINT32_MAX;
+
+		if (next && previous)
+			kinds[v] = LOD_VERTEX_BORDER;
+		else if (next || previous)
+			kinds[v] = LOD_VERTEX_LOCKED;
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float error;
+	};
+
+	std::vector<Collapse> collapses;
+	// Cheapest collapse of each vertex, the others are left for the next pass
+	std::vector<Collapse> bestCollapses(vertexCount);
+	std::vector<std::pair<uint32_t, uint32_t>> wedgePairs;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> triangleCursors(vertexCount);
+	std::vector<uint32_t> vertexTriangles;
+
+	float error = 0.f;
+	uint32_t triangleCount = cornerCount / 3;
+
+	auto isNeighbour = [&](uint32_t from, uint32_t to)
+	{
+		for (uint32_t i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+		{
+			const uint32_t* triangle = &indexes[vertexTriangles[i] * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				return true;
+		}
+
+		return false;
+	};
+
+	auto canCollapse = [&](uint32_t from, uint32_t to)
+	{
+		if (kinds[from] == LOD_VERTEX_MANIFOLD)
+			return true;
+
+		// Along the border only, onto the neighbour the edge leads to or comes from
+		return kinds[from] == LOD_VERTEX_BORDER && (borderNext[from] == to || borderPrevious[from] == to);
+	};
+
+	// Every wedge of from still in use paired with a neighbouring wedge of to it can collapse onto, false if one has none
+	auto findWedgePairs = [&](uint32_t from, uint32_t to)
+	{
+		wedgePairs.clear();
+
+		if (!canCollapse(from, to))
+			return false;
+
+		wedgePairs.emplace_back(from, to);
+
+		for (uint32_t wedge = wedgeNext[from]; wedge != from; wedge = wedgeNext[wedge])
+		{
+			if (wedge == to || triangleOffsets[wedge] == triangleOffsets[wedge + 1])
+				continue;
+
+			uint32_t target = to;
+			while (!(canCollapse(wedge, target) && isNeighbour(wedge, target)))
+			{
+				target = wedgeNext[target];
+				if (target == to)
+					return false;
+			}
+
+			wedgePairs.emplace_back(wedge, target);
+		}
+
+		return true;
+	};
+
+	// Moving from onto to must not turn any of the remaining triangles of from around
+	auto flips = [&](uint32_t from, uint32_t to)
+	{
+		const glm::vec3& target = vertexs[to].pos;
+
+		for (uint32_t i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+		{
+			const uint32_t* triangle = &indexes[vertexTriangles[i] * 3];
+
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				continue;
+
+			uint32_t c = triangle[0] == from ? 0 : (triangle[1] == from ? 1 : 2);
+			const glm::vec3& p1 = vertexs[triangle[(c + 1) % 3]].pos;
+			const glm::vec3& p2 = vertexs[triangle[(c + 2) % 3]].pos;
+
+			glm::vec3 before = glm::cross(p1 - vertexs[from].pos, p2 - vertexs[from].pos);
+			glm::vec3 after = glm::cross(p1 - target, p2 - target);
+
+			if (glm::dot(before, after) <= 0.1f * glm::length(before) * glm::length(after))
+				return true;
+		}
+
+		return false;
+	};
+
+	for (uint32_t level = 0; level < MESH_MAX_LODS; level++)
+	{
+		uint32_t levelStart = triangleCount;
+		uint32_t target = levelStart / 2;
+
+		// The last few collapses of a level would each cost a whole pass, a 64th above the target is close enough
+		while (triangleCount > target + target / 64)
+		{
+			// Triangles around each vertex
+			std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+			for (uint32_t index : indexes)
+				triangleOffsets[index + 1]++;
+			for (uint32_t v = 0; v < vertexCount; v++)
+				triangleOffsets[v + 1] += triangleOffsets[v];
+
+			vertexTriangles.resize(indexes.size());
+			std::copy(triangleOffsets.begin(), triangleOffsets.end() - 1, triangleCursors.begin());
+			for (uint32_t c = 0; c < indexes.size(); c++)
+				vertexTriangles[triangleCursors[indexes[c]]++] = c / 3;
+
+			std::fill(bestCollapses.begin(), bestCollapses.end(), Collapse{ UINT32_MAX, UINT32_MAX, FLT_MAX });
+
+			auto addCollapse = [&](uint32_t from, uint32_t to)
+			{
+				bool seam = wedgeNext[from] != from;
+
+				if (seam && !wedgeHead[from])
+					return;
+
+				if (!findWedgePairs(from, to))
+					return;
+
+				LodQuadric quadric{};
+				for (const std::pair<uint32_t, uint32_t>& pair : wedgePairs)
+				{
+					quadric.Add(quadrics[pair.first]);
+					quadric.Add(quadrics[pair.second]);
+				}
+
+				float collapseError = static_cast<float>(quadric.Error(vertexs[to].pos));
+
+				if (collapseError < bestCollapses[from].error)
+					bestCollapses[from] = Collapse{ from, to, collapseError };
+			};
+
+			// An inner edge is seen once in each direction by its two triangles, a border edge only once
+			for (uint32_t c = 0; c < indexes.size(); c++)
+			{
+				uint32_t from = indexes[c];
+				uint32_t to = indexes[c - c % 3 + (c + 1) % 3];
+
+				addCollapse(from, to);
+
+				if (borderNext[from] == to)
+					addCollapse(to, from);
+			}
+
+			collapses.clear();
+			for (const Collapse& collapse : bestCollapses)
+			{
+				if (collapse.from != UINT32_MAX)
+					collapses.push_back(collapse);
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+			// A collapse removes about two triangles, more on a seam. The one rings of the collapsed vertices are left alone for
+			// the rest of the pass, the flip test only sees the positions the pass started with
+			uint32_t wanted = (triangleCount - target) / 2 + 1;
+			uint32_t applied = 0;
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(touched.begin(), touched.end(), 0);
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (applied >= wanted)
+					break;
+
+				if (!findWedgePairs(collapse.from, collapse.to))
+					continue;
+
+				bool blocked = false;
+				for (const std::pair<uint32_t, uint32_t>& pair : wedgePairs)
+					blocked = blocked || touched[pair.first] || touched[pair.second] || flips(pair.first, pair.second);
+
+				if (blocked)
+					continue;
+
+				for (const std::pair<uint32_t, uint32_t>& pair : wedgePairs)
+				{
+					uint32_t from = pair.first;
+					uint32_t to = pair.second;
+
+					remap[from] = to;
+					quadrics[to].Add(quadrics[from]);
+
+					// The border goes around the removed vertex
+					if (kinds[from] == LOD_VERTEX_BORDER)
+					{
+						uint32_t previous = borderPrevious[from];
+						uint32_t next = borderNext[from];
+
+						if (next == to)
+						{
+							borderPrevious[to] = previous;
+							borderNext[previous] = to;
+						}
+						else
+						{
+							borderNext[to] = next;
+							borderPrevious[next] = to;
+						}
+					}
+
+					for (uint32_t i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+					{
+						for (uint32_t c = 0; c < 3; c++)
+							touched[indexes[vertexTriangles[i] * 3 + c]] = 1;
+					}
+				}
+
+				error = std::max(error, std::sqrt(collapse.error));
+				applied++;
+			}
+
+			if (applied == 0)
+				break;
+
+			// Triangles that lost a corner to the collapse go away
+			uint32_t write = 0;
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				uint32_t a = remap[indexes[t * 3]];
+				uint32_t b = remap[indexes[t * 3 + 1]];
+				uint32_t c = remap[indexes[t * 3 + 2]];
+
+				if (a == b || b == c || c == a)
+					continue;
+
+				indexes[write++] = a;
+				indexes[write++] = b;
+				indexes[write++] = c;
+			}
+
+			indexes.resize(write);
+			triangleCount = write / 3;
+		}
+
+		if (triangleCount * 10 > levelStart * 9)
+			break;
+
+		result.levels.push_back(indexes);
+		result.errors.push_back(error);
+
+		if (triangleCount < MESH_LOD_MIN_TRIANGLES)
+			break;
+	}
+}
+
+PrimitiveLod Mesh::GetPrimitiveLod(size_t primitiveIndex, uint32_t lod) const
+{
+	const Primitive& p = m_Primitves[primitiveIndex];
+
+	if (lod == 0 || p.lodCount == 0)
+		return PrimitiveLod{ p.firstIndex, p.indexCount, 0.f, p.meshletOffset, p.meshletCount };
+
+	return m_Lods[p.lodOffset + std::min(lod, p.lodCount) - 1];
+}
+
+uint32_t Mesh::GetLodCount() const
+{
+	return std::max<uint32_t>(static_cast<uint32_t>(m_LodErrors.size()), 1);
+}
+
+float Mesh::GetLodError(uint32_t lod) const
+{
+	return lod < m_LodErrors.size() ? m_LodErrors[lod] : (m_LodErrors.empty() ? 0.f : m_LodErrors.back());
+}
+
+uint32_t Mesh::SelectLod(const glm::vec3& cameraPosition, float projectionScale, float maxPixelError)
+{
+	float scale = GetModelScale();
+	glm::vec3 center = glm::vec3(m_Model * glm::vec4(glm::vec3(m_BoundingSphere), 1.f));
+	float distance = glm::length(center - cameraPosition) - m_BoundingSphere.w * scale;
+
+	// Inside the bounds the closest surface may be at any distance
+	if (distance <= FLT_MIN)
+	{
+		m_Lod = 0;
+		return m_Lod;
+	}
+
+	float pixelsPerUnit = projectionScale * scale / distance;
+	uint32_t lod = 0;
+
+	for (uint32_t level = 1; level < GetLodCount(); level++)
+	{
+		float budget = level > m_Lod ? maxPixelError * MESH_LOD_HYSTERESIS : maxPixelError;
+
+		if (GetLodError(level) * pixelsPerUnit > budget)
+			break;
+
+		lod = level;
+	}
+
+	m_Lod = lod;
+	return m_Lod;
+}
+
+uint32_t Mesh::GetLod()
+{
+	return m_Lod;
+}
+
+uint32_t Mesh::FindLod(float maxError) const
+{
+	float scale = GetModelScale();
+	uint32_t lod = 0;
+
+	for (uint32_t level = 1; level < GetLodCount() && GetLodError(level) * scale <= maxError; level++)
+		lod = level;
+
+	return lod;
+}
+
+void Mesh::SetAccelerationStructureLod(uint32_t lod)
+{
+	m_AccelerationStructureLod = lod;
+}
+
+float Mesh::GetModelScale() const
+{
+	return std::max(glm::length(glm::vec3(m_Model[0])), std::max(glm::length(glm::vec3(m_Model[1])), glm::length(glm::vec3(m_Model[2]))));
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation": vertices recently used and with few triangles left score higher
+static float ForsythVertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.f;
+
+	float score = 0.f;
+
+	// The last triangle's vertices get a fixed score so the next one does not just reuse its edge
+	if (cachePosition >= 0)
+		score = cachePosition < 3 ? 0.75f : std::pow(1.f - static_cast<float>(cachePosition - 3) / static_cast<float>(MESH_VERTEX_CACHE_SIZE - 3), 1.5f);
+
+	// Boost the vertices with few triangles left to finish them instead of leaving lone triangles behind
+	return score + 2.f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+void Mesh::OptimizeVertexCache(std::vector<uint32_t>& indexes, uint32_t vertexCount)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indexes.size() / 3);
+
+	// Triangles not yet emitted of each vertex, compacted as they are
+	std::vector<uint32_t> triangleStarts(vertexCount + 1, 0);
+	for (uint32_t index : indexes)
+		triangleStarts[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		triangleStarts[v + 1] += triangleStarts[v];
+
+	std::vector<uint32_t> remainingTriangles(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		remainingTriangles[v] = triangleStarts[v + 1] - triangleStarts[v];
+
+	std::vector<uint32_t> vertexTriangles(indexes.size());
+	std::vector<uint32_t> triangleFill(triangleStarts.begin(), triangleStarts.end() - 1);
+	for (uint32_t i = 0; i < indexes.size(); i++)
+		vertexTriangles[triangleFill[indexes[i]]++] = i / 3;
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = ForsythVertexScore(-1, remainingTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indexes[3 * t]] + vertexScores[indexes[3 * t + 1]] + vertexScores[indexes[3 * t + 2]];
+
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> output;
+	output.reserve(indexes.size());
+
+	// 3 more entries for the vertices pushed by the last triangle before the cache is trimmed
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(MESH_VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(MESH_VERTEX_CACHE_SIZE + 3);
+
+	uint32_t bestTriangle = UINT32_MAX;
+	uint32_t scanCursor = 0;
+
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// Dead end, nothing left around the cache: best of the whole mesh the first time, next one in order after that
+		if (bestTriangle == UINT32_MAX)
+		{
+			if (emittedCount == 0)
+			{
+				bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+			}
+			else
+			{
+				while (emitted[scanCursor])
+					scanCursor++;
+				bestTriangle = scanCursor;
+			}
+		}
+
+		uint32_t t = bestTriangle;
+		emitted[t] = 1;
+
+		newCache.clear();
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t v = indexes[3 * t + c];
+			output.push_back(v);
+			newCache.push_back(v);
+
+			// Drop the triangle from the vertex
+			uint32_t* begin = vertexTriangles.data() + triangleStarts[v];
+			uint32_t* end = begin + remainingTriangles[v];
+			*std::find(begin, end, t) = *(end - 1);
+			remainingTriangles[v]--;
+		}
+
+		for (uint32_t v : cache)
+		{
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+				newCache.push_back(v);
+		}
+
+		// Evicted vertices leave with a score out of the cache
+		for (size_t i = MESH_VERTEX_CACHE_SIZE; i < newCache.size(); i++)
+		{
+			cachePositions[newCache[i]] = -1;
+			vertexScores[newCache[i]] = ForsythVertexScore(-1, remainingTriangles[newCache[i]]);
+		}
+
+		if (newCache.size() > MESH_VERTEX_CACHE_SIZE)
+			newCache.resize(MESH_VERTEX_CACHE_SIZE);
+
+		std::swap(cache, newCache);
+
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = static_cast<int32_t>(i);
+			vertexScores[cache[i]] = ForsythVertexScore(static_cast<int32_t>(i), remainingTriangles[cache[i]]);
+		}
+
+		// Only the triangles around the cache changed score, the next one is taken among them
+		bestTriangle = UINT32_MAX;
+		float bestScore = -1.f;
+
+		for (uint32_t v : cache)
+		{
+			for (uint32_t i = triangleStarts[v]; i < triangleStarts[v] + remainingTriangles[v]; i++)
+			{
+				uint32_t triangle = vertexTriangles[i];
+				float score = vertexScores[indexes[3 * triangle]] + vertexScores[indexes[3 * triangle + 1]] + vertexScores[indexes[3 * triangle + 2]];
+				triangleScores[triangle] = score;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangle;
+				}
+			}
+		}
+	}
+
+	indexes = std::move(output);
+}
+
+// Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw": the cache ordered
+// triangles are cut where the cache restarts, then again wherever a cluster is back under MESH_OVERDRAW_THRESHOLD times
+// the ACMR of the piece it was cut from, so moving clusters around costs at most that much in cache misses
+void Mesh::OptimizeOverdraw(size_t primitiveIndex, std::vector<uint32_t>& indexes) const
+{
+	const Primitive& p = m_Primitves[primitiveIndex];
+	const Vertex* vertexs = m_Vertexs.data() + p.vertexOffset;
+	uint32_t triangleCount = static_cast<uint32_t>(indexes.size() / 3);
+
+	if (triangleCount == 0)
+		return;
+
+	std::vector<uint32_t> cacheTimes(p.vertexCount, 0);
+	uint32_t misses = 0;
+
+	// Same FIFO as ComputeAcmr, flushed by moving the time past every entry
+	auto addTriangle = [&](uint32_t t)
+	{
+		uint32_t triangleMisses = 0;
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t v = indexes[3 * t + c];
+
+			if (cacheTimes[v] == 0 || misses - cacheTimes[v] + 1 > MESH_ACMR_CACHE_SIZE)
+			{
+				misses++;
+				triangleMisses++;
+				cacheTimes[v] = misses;
+			}
+		}
+
+		return triangleMisses;
+	};
+
+	auto flush = [&]()
+	{
+		misses += MESH_ACMR_CACHE_SIZE + 1;
+	};
+
+	// Hard boundaries at every triangle missing all of its vertices
+	std::vector<uint32_t> hardStarts;
+
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		if (addTriangle(t) == 3 || t == 0)
+			hardStarts.push_back(t);
+	}
+
+	hardStarts.push_back(triangleCount);
+
+	// Soft boundaries inside each of them, a cluster ends as soon as its own ACMR from a flushed cache is good enough
+	std::vector<uint32_t> clusterStarts;
+
+	for (size_t hard = 0; hard + 1 < hardStarts.size(); hard++)
+	{
+		uint32_t start = hardStarts[hard];
+		uint32_t end = hardStarts[hard + 1];
+
+		flush();
+		uint32_t hardMisses = 0;
+		for (uint32_t t = start; t < end; t++)
+			hardMisses += addTriangle(t);
+
+		float threshold = MESH_OVERDRAW_THRESHOLD * static_cast<float>(hardMisses) / static_cast<float>(end - start);
+
+		clusterStarts.push_back(start);
+
+		flush();
+		uint32_t clusterMisses = 0;
+		uint32_t clusterTriangles = 0;
+
+		for (uint32_t t = start; t < end; t++)
+		{
+			clusterMisses += addTriangle(t);
+			clusterTriangles++;
+
+			if (static_cast<float>(clusterMisses) <= threshold * static_cast<float>(clusterTriangles))
+			{
+				clusterStarts.push_back(t + 1);
+				flush();
+				clusterMisses = 0;
+				clusterTriangles = 0;
+			}
+		}
+
+		// The leftover after the last cut is rarely good on its own, merged into the previous cluster
+		if (clusterStarts.back() != start)
+			clusterStarts.pop_back();
+	}
+
+	clusterStarts.push_back(triangleCount);
+
+	if (clusterStarts.size() <= 2)
+		return;
+
+	// Area weighted centroids and normals, clusters facing away from the mesh center are likely in front of the others
+	glm::vec3 meshCentroid = glm::vec3(0.f);
+	float meshArea = 0.f;
+
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.f));
+	std::vector<float> clusterAreas(clusterCount, 0.f);
+
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		for (uint32_t t = clusterStarts[cluster]; t < clusterStarts[cluster + 1]; t++)
+		{
+			const glm::vec3& p0 = vertexs[indexes[3 * t]].pos;
+			const glm::vec3& p1 = vertexs[indexes[3 * t + 1]].pos;
+			const glm::vec3& p2 = vertexs[indexes[3 * t + 2]].pos;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+
+			clusterCentroids[cluster] += (p0 + p1 + p2) * (area / 3.f);
+			clusterNormals[cluster] += normal;
+			clusterAreas[cluster] += area;
+		}
+
+		meshCentroid += clusterCentroids[cluster];
+		meshArea += clusterAreas[cluster];
+	}
+
+	if (meshArea > 0.f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> clusterScores(clusterCount, 0.f);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		float normalLength = glm::length(clusterNormals[cluster]);
+
+		if (clusterAreas[cluster] > 0.f && normalLength > 0.f)
+			clusterScores[cluster] = glm::dot(clusterCentroids[cluster] / clusterAreas[cluster] - meshCentroid, clusterNormals[cluster] / normalLength);
+	}
+
+	std::vector<size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return clusterScores[a] > clusterScores[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indexes.size());
+
+	for (size_t cluster : order)
+		output.insert(output.end(), indexes.begin() + 3 * clusterStarts[cluster], indexes.begin() + 3 * clusterStarts[cluster + 1]);
+
+	// The cuts are made on the smaller FIFO, the vertex cache order is kept when the larger one loses more than the threshold
+	for (uint32_t cacheSize : { MESH_ACMR_CACHE_SIZE, MESH_VERTEX_CACHE_SIZE })
+	{
+		float acmr = ComputeAcmr(indexes.data(), triangleCount, p.vertexCount, cacheSize);
+
+		if (ComputeAcmr(output.data(), triangleCount, p.vertexCount, cacheSize) > MESH_OVERDRAW_THRESHOLD * acmr)
+			return;
+	}
+
+	indexes = std::move(output);
+}
+
+void Mesh::AverageDuplicatedVertexNormals()
+{
+	CPU_ZONE("Mesh::AverageDuplicatedVertexNormals");
+
 	struct posIndex {
 		glm::vec3 pos;
 		size_t index;
@@ -4,8 +4,30 @@
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <memory>
 #include "VulkanBase.h"
 #include "VkGLM.h"
+#include "Skeleton.h"
+
+// Post-transform cache size the triangle order is optimized for
+#define MESH_VERTEX_CACHE_SIZE 32
+
+// FIFO cache size of the ACMR metric and of the cluster boundaries of the overdraw pass, the smallest common hardware one
+#define MESH_ACMR_CACHE_SIZE 16
+
+// ACMR the overdraw pass may lose against the vertex cache order, the lambda of Sander et al.
+#define MESH_OVERDRAW_THRESHOLD 1.05f
+
+// Meshlet bounds, also the output limits of meshlet.mesh. 64 vertices and 124 triangles suit current mesh shader hardware
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Simplified levels generated per primitive on top of the original one, each with about half the triangles of the previous
+#define MESH_MAX_LODS 4
+// Primitives under this many triangles, or levels that could not remove a tenth of them, end the chain
+#define MESH_LOD_MIN_TRIANGLES 64
+// A coarser level than the current one must fit in this fraction of the error budget, a finer one is only taken past the budget
+#define MESH_LOD_HYSTERESIS 0.75f
 
 struct Primitive
 {
@@ -14,6 +36,23 @@ struct Primitive
 	uint32_t vertexOffset;
 	uint32_t vertexCount;
 	size_t materialID;
+	// Range in the mesh meshlets, empty until BuildMeshlets
+	uint32_t meshletOffset = 0;
+	uint32_t meshletCount = 0;
+	// Range in the mesh LODs, the simplified levels only, empty until GenerateLods
+	uint32_t lodOffset = 0;
+	uint32_t lodCount = 0;
+};
+
+// Triangles of a primitive at one level of detail, over the same vertices. The indexes follow the original ones in the mesh
+struct PrimitiveLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// Object space distance the level may be off the original surface, upper bound from the collapse quadrics
+	float error;
+	uint32_t meshletOffset;
+	uint32_t meshletCount;
 };
 
 struct Vertex
@@ -67,6 +106,28 @@ struct Vertex
 	}
 };
 
+// Matches the SkinVertex of skinning.comp (std430)
+struct SkinVertex
+{
+	glm::uvec4 joints;
+	glm::vec4 weights;
+};
+
+// Matches the Meshlet of meshlet.task and meshlet.mesh (std430)
+struct Meshlet
+{
+	// Object space center and radius
+	glm::vec4 boundingSphere;
+	// Average facing direction and cutoff, the meshlet is back facing from camera when
+	// dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+	glm::vec4 cone;
+	// Into the meshlet data: vertex indices of the mesh, then one word per triangle with 3 local 8 bit indices
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
 class Mesh
 {
 public:
@@ -90,14 +151,43 @@ public:
 
 	const std::vector<Primitive>& GetPrimitives();
 
-	void CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice);
+	void AddSkinVertex(const SkinVertex& skinVertex);
+
+	// Skinned meshes keep their vertices in bind space, the skinning pass writes the posed ones
+	void SetSkeleton(const std::shared_ptr<Skeleton>& skeleton);
+	const std::shared_ptr<Skeleton>& GetSkeleton();
+
+	bool IsSkinned();
+
+	// Added to the animation clock so instances of one character do not move in lockstep
+	void SetAnimationTimeOffset(float animationTimeOffset);
+	float GetAnimationTimeOffset();
+
+	void CreateVertexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, bool accelerationStructureInput = true);
+
+	// 16-bit indexes when every primitive has fewer than 65536 vertices, the indexes are relative to their vertexOffset
+	void CreateIndexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, bool accelerationStructureInput = true);
+
+	// Joints/weights buffer and the per instance output of the skinning pass, initialized with the bind pose
+	void CreateSkinningBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, bool accelerationStructureInput = true);
+
+	// Device buffers are shared by every distinct family, buffers touched by a single family stay exclusive
+	static std::vector<uint32_t> GetUniqueQueueFamilies(const std::vector<uint32_t>& queueFamilyIndices);
 
-	void CreateIndexBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice);
+	VkBuffer GetVertexBuffer();
 
+	VkBuffer GetSkinBuffer();
+
+	VkBuffer GetSkinnedVertexBuffer();
+
+	// Binds the skinned vertices when the mesh has them
 	void BindVertexBuffer(VkCommandBuffer commandBuffer);
 
 	void BindIndexBuffer(VkCommandBuffer commandBuffer);
 
+	// Type of the index buffer, set by CreateIndexBuffers
+	VkIndexType GetIndexType();
+
 	bool GetAccelerationStructureGeometrys(VkDevice device, std::vector<VkAccelerationStructureGeometryKHR>& accelerationStructureGeometrys);
 
 	void GetAccelerationStructureRangeInfos(std::vector<VkAccelerationStructureBuildRangeInfoKHR>& accelerationStructureRangeInfos);
@@ -108,6 +198,9 @@ public:
 
 	void SetModel(const glm::mat4& model);
 
+	// Bumped by every change of the model or occluder flag, consumers compare it with the last version they saw
+	uint32_t GetTransformVersion();
+
 	void SetOccluder(bool occluder);
 
 	bool IsOccluder();
@@ -124,22 +217,148 @@ public:
 
 	void AutoComputeBiTangents();
 
+	// MikkTSpace tangents, the tangent space glTF normal maps are baked in. Vertices are only split where the corners
+	// sharing them end up in different tangent frames (UV seams, mirrored UVs). Primitives are processed in parallel
+	void AutoComputeMikkTSpaceTangents();
+
+	void AutoComputeMikkTSpaceTangents(const std::vector<size_t>& primitiveIndexes);
+
 	void AverageDuplicatedVertexNormals();
 
+	// Triangles in Forsyth order for the post-transform vertex cache unless the source order misses less, then clusters of it
+	// sorted to draw the outward facing ones first (less overdraw) as long as the ACMR stays within MESH_OVERDRAW_THRESHOLD,
+	// then vertices in first use order for fetch locality. Only reorders, the output is the same. Simplified levels only get
+	// the vertex cache order
+	void OptimizePrimitive(size_t primitiveIndex);
+
+	void Optimize();
+
+	// Average cache miss ratio, vertex shader invocations per triangle through a FIFO cache: 3 worst, about 0.5 best
+	float ComputeAcmr(size_t primitiveIndex, uint32_t cacheSize = MESH_ACMR_CACHE_SIZE) const;
+
+	// Over every primitive, weighted by triangle count
+	float ComputeAcmr(uint32_t cacheSize = MESH_ACMR_CACHE_SIZE) const;
+
+	// Greedy clusters of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles in index order, so
+	// they follow the vertex cache order when the mesh was optimized. Every level of detail gets its own, bounds are in object space
+	void BuildMeshlets();
+
+	// Quadric error edge collapses down to MESH_MAX_LODS levels per primitive, the wedges of a seam collapse together along it
+	// and complex borders are kept. After the tangents, the levels reuse their vertices. Primitives are processed in parallel
+	void GenerateLods();
+
+	// Level 0 is the primitive itself, levels past the primitive's last one give its last one
+	PrimitiveLod GetPrimitiveLod(size_t primitiveIndex, uint32_t lod) const;
+
+	// Levels of the most detailed primitive, 1 without LODs
+	uint32_t GetLodCount() const;
+
+	// Largest error of the primitives at that level, object space
+	float GetLodError(uint32_t lod) const;
+
+	// Coarsest level whose projected error stays under maxPixelError pixels, with hysteresis against the current level.
+	// projectionScale is the viewport height over 2 tan(fov / 2)
+	uint32_t SelectLod(const glm::vec3& cameraPosition, float projectionScale, float maxPixelError);
+
+	uint32_t GetLod();
+
+	// Coarsest level within maxError in world space, under the current model scale
+	uint32_t FindLod(float maxError) const;
+
+	// Level the acceleration structure geometry is built from
+	void SetAccelerationStructureLod(uint32_t lod);
+
+	const std::vector<Meshlet>& GetMeshlets();
+
+	bool HasMeshlets();
+
+	// Meshlets and their data, read by the mesh shading pipeline with the vertex buffer
+	void CreateMeshletBuffers(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice);
+
+	VkBuffer GetMeshletBuffer();
+
+	VkBuffer GetMeshletDataBuffer();
+
 private:
 
+	// Frames of the primitive vertices followed by the split ones, indexes relative to vertexOffset
+	struct MikkTSpacePrimitive
+	{
+		std::vector<glm::vec3> tangents;
+		std::vector<glm::vec3> biTangents;
+		// Vertex of the primitive each split vertex is copied from
+		std::vector<uint32_t> splitSources;
+		std::vector<uint32_t> indexes;
+	};
+
+	// Only reads the mesh so primitives can run concurrently
+	void ComputeMikkTSpacePrimitive(size_t primitiveIndex, MikkTSpacePrimitive& result) const;
+
+	void ApplyMikkTSpacePrimitive(size_t primitiveIndex, const MikkTSpacePrimitive& result);
+
+	// Triangle orders of OptimizePrimitive, indexes relative to the primitive vertexOffset
+	static void OptimizeVertexCache(std::vector<uint32_t>& indexes, uint32_t vertexCount);
+
+	void OptimizeOverdraw(size_t primitiveIndex, std::vector<uint32_t>& indexes) const;
+
+	static float ComputeAcmr(const uint32_t* indexes, uint32_t triangleCount, uint32_t vertexCount, uint32_t cacheSize);
+
+	// Index lists of the simplified levels, relative to vertexOffset, and their error
+	struct LodPrimitive
+	{
+		std::vector<std::vector<uint32_t>> levels;
+		std::vector<float> errors;
+	};
+
+	// Only reads the mesh so primitives can run concurrently
+	void ComputeLodsPrimitive(size_t primitiveIndex, LodPrimitive& result) const;
+
+	// Largest axis scale of the model, errors and bounds are scaled by it
+	float GetModelScale() const;
+
+	static uint32_t GetIndexSize(VkIndexType indexType);
+
+	// Device local buffer filled through a staging copy, shared by every distinct family
+	static void CreateDeviceBuffer(VmaAllocator allocator, VkDevice device, VkCommandPool transferPool, VkQueue transferQueue, uint32_t transferFamilyIndice, uint32_t graphicFamilyIndice, uint32_t computeFamilyIndice, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation);
+
 	std::vector<Vertex> m_Vertexs;
 	std::vector<uint32_t> m_Indexes;
 
 	std::vector<Primitive> m_Primitves;
 
+	std::vector<PrimitiveLod> m_Lods;
+	// Per level, see GetLodError
+	std::vector<float> m_LodErrors;
+	// Object space center and radius of the mesh
+	glm::vec4 m_BoundingSphere = glm::vec4(0.f);
+	uint32_t m_Lod = 0;
+	uint32_t m_AccelerationStructureLod = 0;
+
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<uint32_t> m_MeshletData;
+
+	std::vector<SkinVertex> m_SkinVertexs;
+	std::shared_ptr<Skeleton> m_Skeleton;
+	float m_AnimationTimeOffset = 0.f;
+
 	glm::mat4 m_Model;
 
 	bool m_Occluder = true;
 
+	uint32_t m_TransformVersion = 0;
+
 	VkBuffer m_VertexBuffer = VK_NULL_HANDLE;
 	VmaAllocation m_VertexBufferAlloc = nullptr;
 	VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
 	VmaAllocation m_IndexBufferAlloc = nullptr;
+	VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
+	VkBuffer m_SkinBuffer = VK_NULL_HANDLE;
+	VmaAllocation m_SkinBufferAlloc = nullptr;
+	VkBuffer m_SkinnedVertexBuffer = VK_NULL_HANDLE;
+	VmaAllocation m_SkinnedVertexBufferAlloc = nullptr;
+	VkBuffer m_MeshletBuffer = VK_NULL_HANDLE;
+	VmaAllocation m_MeshletBufferAlloc = nullptr;
+	VkBuffer m_MeshletDataBuffer = VK_NULL_HANDLE;
+	VmaAllocation m_MeshletDataBufferAlloc = nullptr;
 };
 
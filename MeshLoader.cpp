@@ -5,10 +5,13 @@
 
 #include <map>
 #include "MeshLoader.h"
+#include "CpuProfiler.h"
 
 
 Mesh* MeshLoader::loadMeshObj(const std::string& path, const std::string& mtlSearchPath)
 {
+    CPU_ZONE("MeshLoader::loadMeshObj");
+
     tinyobj::ObjReaderConfig readerConfig;
     readerConfig.vertex_color = false;
     readerConfig.triangulate = true;
@@ -108,10 +111,135 @@ void getIndices(const unsigned char* bufferData, size_t nbIndices, Mesh* mesh)
 }
 
 
-Mesh* loadMeshGltf(tinygltf::Model &model, tinygltf::Mesh &mesh, glm::mat4 transform, const std::map<int, size_t>& mapMaterialId, bool autoComputeNormal, bool autoComputeTangent)
+// Component c of element i, integer components are normalized when the accessor says so
+float readAccessorComponent(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t i, int c)
 {
+    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+    const unsigned char* element = &model.buffers[bufferView.buffer].data[accessor.byteOffset + bufferView.byteOffset + i * accessor.ByteStride(bufferView)];
+
+    switch (accessor.componentType)
+    {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+            return reinterpret_cast<const float*>(element)[c];
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            return accessor.normalized ? element[c] / 255.f : float(element[c]);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            float value = float(reinterpret_cast<const uint16_t*>(element)[c]);
+            return accessor.normalized ? value / 65535.f : value;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            return float(reinterpret_cast<const uint32_t*>(element)[c]);
+        default:
+            return 0.f;
+    }
+}
+
+std::shared_ptr<Skeleton> loadSkeleton(tinygltf::Model& model, int skinIndex)
+{
+    CPU_ZONE("MeshLoader::loadSkeleton");
+
+    const tinygltf::Skin& skin = model.skins[skinIndex];
+
+    std::vector<SkeletonNode> nodes(model.nodes.size());
+
+    for (size_t i = 0; i < model.nodes.size(); i++)
+    {
+        const tinygltf::Node& node = model.nodes[i];
+
+        for (int child : node.children)
+            nodes[child].parent = static_cast<int>(i);
+
+        if (node.matrix.size() > 0)
+        {
+            nodes[i].hasMatrix = true;
+            nodes[i].matrix = glm::mat4(glm::make_mat4(node.matrix.data()));
+        }
+
+        if (node.translation.size() > 0)
+            nodes[i].translation = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
+
+        if (node.rotation.size() > 0)
+            nodes[i].rotation = glm::make_quat(node.rotation.data());
+
+        if (node.scale.size() > 0)
+            nodes[i].scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+    }
+
+    std::vector<glm::mat4> inverseBindMatrices;
+    if (skin.inverseBindMatrices >= 0)
+    {
+        const tinygltf::Accessor& accessor = model.accessors[skin.inverseBindMatrices];
+        inverseBindMatrices.resize(accessor.count);
+
+        for (size_t i = 0; i < accessor.count; i++)
+            for (int c = 0; c < 16; c++)
+                inverseBindMatrices[i][c / 4][c % 4] = readAccessorComponent(model, accessor, i, c);
+    }
+
+    auto skeleton = std::make_shared<Skeleton>(nodes, skin.joints, inverseBindMatrices);
+
+    for (const tinygltf::Animation& animation : model.animations)
+    {
+        Animation internalAnimation;
+
+        for (const tinygltf::AnimationChannel& channel : animation.channels)
+        {
+            AnimationChannel internalChannel{};
+            internalChannel.node = channel.target_node;
+
+            if (channel.target_path.compare("translation") == 0)
+                internalChannel.path = ANIMATION_TRANSLATION;
+            else if (channel.target_path.compare("rotation") == 0)
+                internalChannel.path = ANIMATION_ROTATION;
+            else if (channel.target_path.compare("scale") == 0)
+                internalChannel.path = ANIMATION_SCALE;
+            else
+                continue;
+
+            const tinygltf::AnimationSampler& sampler = animation.samplers[channel.sampler];
+            const tinygltf::Accessor& inputAccessor = model.accessors[sampler.input];
+            const tinygltf::Accessor& outputAccessor = model.accessors[sampler.output];
+
+            // Cubic spline keys are sampled linearly on their values, their tangents are skipped
+            bool cubicSpline = sampler.interpolation.compare("CUBICSPLINE") == 0;
+            internalChannel.step = sampler.interpolation.compare("STEP") == 0;
+
+            int componentCount = internalChannel.path == ANIMATION_ROTATION ? 4 : 3;
+
+            for (size_t i = 0; i < inputAccessor.count; i++)
+            {
+                internalChannel.times.push_back(readAccessorComponent(model, inputAccessor, i, 0));
+
+                size_t outputIndex = cubicSpline ? 3 * i + 1 : i;
+                glm::vec4 value = glm::vec4(0.f);
+                for (int c = 0; c < componentCount; c++)
+                    value[c] = readAccessorComponent(model, outputAccessor, outputIndex, c);
+
+                internalChannel.values.push_back(value);
+            }
+
+            if (!internalChannel.times.empty())
+                internalAnimation.duration = std::max(internalAnimation.duration, internalChannel.times.back());
+
+            internalAnimation.channels.push_back(std::move(internalChannel));
+        }
+
+        skeleton->AddAnimation(internalAnimation);
+    }
+
+    return skeleton;
+}
+
+Mesh* loadMeshGltf(tinygltf::Model &model, tinygltf::Mesh &mesh, glm::mat4 transform, const std::map<int, size_t>& mapMaterialId, bool autoComputeNormal, bool autoComputeTangent, bool optimize, const std::shared_ptr<Skeleton>& skeleton)
+{
+    CPU_ZONE("MeshLoader::loadMeshGltf");
+
     Mesh* InternalMesh = new Mesh();
 
+    // Primitives without tangents in the file
+    std::vector<size_t> mikkTSpacePrimitives;
+
     for (size_t i = 0; i < mesh.primitives.size(); i++)
     {
         tinygltf::Primitive& primitive = mesh.primitives[i];
@@ -121,6 +249,8 @@ Mesh* loadMeshGltf(tinygltf::Model &model, tinygltf::Mesh &mesh, glm::mat4 trans
         tinygltf::Accessor normalAccessor{};
         tinygltf::Accessor tangentAccessor{};
         tinygltf::Accessor texCoordAccessor{};
+        tinygltf::Accessor jointsAccessor{};
+        tinygltf::Accessor weightsAccessor{};
 
         bool NormalFromFile = false;
         bool TangentFromFile = false;
@@ -144,8 +274,16 @@ Mesh* loadMeshGltf(tinygltf::Model &model, tinygltf::Mesh &mesh, glm::mat4 trans
 
             if (attrib.first.compare("TEXCOORD_0") == 0)
                 texCoordAccessor = model.accessors[attrib.second];
+
+            if (attrib.first.compare("JOINTS_0") == 0)
+                jointsAccessor = model.accessors[attrib.second];
+
+            if (attrib.first.compare("WEIGHTS_0") == 0)
+                weightsAccessor = model.accessors[attrib.second];
         }
 
+        bool SkinFromFile = skeleton && jointsAccessor.bufferView != -1 && weightsAccessor.bufferView != -1;
+
         NormalFromFile = NormalFromFile && !autoComputeNormal;
         TangentFromFile = TangentFromFile && !autoComputeTangent;
 
@@ -219,6 +357,21 @@ Mesh* loadMeshGltf(tinygltf::Model &model, tinygltf::Mesh &mesh, glm::mat4 trans
             texCoord.y = texCoords[j * texCoordIdxStride + 1];
 
             InternalMesh->AddVertex(Vertex{ position, normal, tangent, glm::vec3(0.f), texCoord, {126, 126, 126} });
+
+            // Primitives without weights stay in bind pose, the skinning pass treats zero weights as identity
+            if (skeleton)
+            {
+                SkinVertex skinVertex{ glm::uvec4(0), glm::vec4(0.f) };
+                if (SkinFromFile)
+                {
+                    for (int c = 0; c < 4; c++)
+                    {
+                        skinVertex.joints[c] = static_cast<uint32_t>(readAccessorComponent(model, jointsAccessor, j, c));
+                        skinVertex.weights[c] = readAccessorComponent(model, weightsAccessor, j, c);
+                    }
+                }
+                InternalMesh->AddSkinVertex(skinVertex);
+            }
         }
 
         size_t nbIndices = indexAccessor.count;
@@ -263,16 +416,36 @@ Mesh* loadMeshGltf(tinygltf::Model &model, tinygltf::Mesh &mesh, glm::mat4 trans
         if (!NormalFromFile)
             InternalMesh->AutoComputeNormalsPrimitive(primitiveIndex);
         if (!TangentFromFile)
-            InternalMesh->AutoComputeTangentsBiTangentsPrimitive(primitiveIndex);
+            mikkTSpacePrimitives.push_back(primitiveIndex);
         else
             InternalMesh->AutoComputeBiTangentsPrimitive(primitiveIndex);
     }
 
+    // glTF normal maps are baked against MikkTSpace tangents. Vertices may be split, so once every primitive is in
+    InternalMesh->AutoComputeMikkTSpaceTangents(mikkTSpacePrimitives);
+
+    // Simplified levels reuse the final vertices, the selection distance comes from bounds skinned meshes move away from
+    if (!skeleton)
+        InternalMesh->GenerateLods();
+
+    // After the splits, they add vertices
+    if (optimize)
+        InternalMesh->Optimize();
+
+    // Built on the final triangle order, skinned meshes move away from the bounds and keep the vertex pipeline
+    if (!skeleton)
+        InternalMesh->BuildMeshlets();
+
+    if (skeleton)
+        InternalMesh->SetSkeleton(skeleton);
+
     return InternalMesh;
 }
 
 void loadModelMaterials(Materials& materials, tinygltf::Model& model, std::string basePath, std::map<int, size_t>& mapMaterialId)
 {
+    CPU_ZONE("MeshLoader::loadModelMaterials");
+
     for (int i = 0; i < model.materials.size(); i++)
     {
         tinygltf::Material& material = model.materials[i];
@@ -335,7 +508,7 @@ void loadModelMaterials(Materials& materials, tinygltf::Model& model, std::strin
     }
 }
 
-void loadModelNodes(tinygltf::Model& model, tinygltf::Node& node, glm::mat4 parentTransform, std::vector<Mesh*>& meshes, const std::map<int, size_t>& mapMaterialId, bool autoComputeNormal, bool autoComputeTangent)
+void loadModelNodes(tinygltf::Model& model, tinygltf::Node& node, glm::mat4 parentTransform, std::vector<Mesh*>& meshes, const std::map<int, size_t>& mapMaterialId, std::map<int, std::shared_ptr<Skeleton>>& skeletons, bool autoComputeNormal, bool autoComputeTangent, bool optimize)
 {
     glm::mat4 nodeTransform = glm::mat4(1.f);
 
@@ -374,19 +547,30 @@ void loadModelNodes(tinygltf::Model& model, tinygltf::Node& node, glm::mat4 pare
 
     if ((node.mesh >= 0) && (node.mesh < model.meshes.size()))
     {
-        Mesh* meshInternal = loadMeshGltf(model, model.meshes[node.mesh], nodeTransform, mapMaterialId, autoComputeNormal, autoComputeTangent);
+        std::shared_ptr<Skeleton> skeleton;
+        if ((node.skin >= 0) && (node.skin < model.skins.size()))
+        {
+            if (!skeletons.contains(node.skin))
+                skeletons[node.skin] = loadSkeleton(model, node.skin);
+            skeleton = skeletons[node.skin];
+        }
+
+        // The node transform of a skinned mesh is ignored: its joints place it, vertices stay in bind space
+        Mesh* meshInternal = loadMeshGltf(model, model.meshes[node.mesh], skeleton ? glm::mat4(1.f) : nodeTransform, mapMaterialId, autoComputeNormal, autoComputeTangent, optimize, skeleton);
         if (meshInternal)
             meshes.push_back(meshInternal);
     }
 
     for (size_t i = 0; i < node.children.size(); i++)
     {
-        loadModelNodes(model, model.nodes[node.children[i]], nodeTransform, meshes, mapMaterialId, autoComputeNormal, autoComputeTangent);
+        loadModelNodes(model, model.nodes[node.children[i]], nodeTransform, meshes, mapMaterialId, skeletons, autoComputeNormal, autoComputeTangent, optimize);
     }
 }
 
-std::vector<Mesh*> MeshLoader::loadGltf(const std::string& path, Materials& materials, bool autoComputeNormal, bool autoComputeTangent)
+std::vector<Mesh*> MeshLoader::loadGltf(const std::string& path, Materials& materials, bool autoComputeNormal, bool autoComputeTangent, bool optimize)
 {
+    CPU_ZONE("MeshLoader::loadGltf");
+
     tinygltf::TinyGLTF loader;
     tinygltf::Model model;
     std::string err;
@@ -395,10 +579,13 @@ std::vector<Mesh*> MeshLoader::loadGltf(const std::string& path, Materials& mate
     std::string extension = path.substr(path.find_last_of('.'));
 
     bool res = false;
-    if (extension._Equal(".glb"))
-        res = loader.LoadBinaryFromFile(&model, &err, &warn, path);
-    else
-        res = loader.LoadASCIIFromFile(&model, &err, &warn, path);
+    {
+        CPU_ZONE("tinygltf parse");
+        if (extension._Equal(".glb"))
+            res = loader.LoadBinaryFromFile(&model, &err, &warn, path);
+        else
+            res = loader.LoadASCIIFromFile(&model, &err, &warn, path);
+    }
     if (!warn.empty()) {
         std::cout << "WARN: " << warn << std::endl;
     }
@@ -407,22 +594,26 @@ std::vector<Mesh*> MeshLoader::loadGltf(const std::string& path, Materials& mate
         std::cout << "ERR: " << err << std::endl;
     }
 
+    std::vector<Mesh*> meshes;
+
     if (!res)
+    {
         std::cout << "Failed to load glTF: " << path << std::endl;
-    else
-        std::cout << "Loaded glTF: " << path << std::endl;
+        return meshes;
+    }
 
-    std::vector<Mesh*> meshes;
+    std::cout << "Loaded glTF: " << path << std::endl;
 
     size_t lastPathSepIndex = path.find_last_of('/');
     std::map<int, size_t> mapMaterialId;
+    std::map<int, std::shared_ptr<Skeleton>> skeletons;
 
     loadModelMaterials(materials, model, path.substr(0, lastPathSepIndex), mapMaterialId);
 
-    const tinygltf::Scene& scene = model.scenes[model.defaultScene];
+    const tinygltf::Scene& scene = model.scenes[std::max(model.defaultScene, 0)];
     for (size_t i = 0; i < scene.nodes.size(); i++)
     {
-        loadModelNodes(model, model.nodes[scene.nodes[i]], glm::mat4(1.), meshes, mapMaterialId, autoComputeNormal, autoComputeTangent);
+        loadModelNodes(model, model.nodes[scene.nodes[i]], glm::mat4(1.), meshes, mapMaterialId, skeletons, autoComputeNormal, autoComputeTangent, optimize);
     }
 
     return meshes;
@@ -11,6 +11,7 @@ namespace MeshLoader
 {
 	Mesh* loadMeshObj(const std::string& path, const std::string& mtlSearchPath = "");
 
-	std::vector<Mesh*> loadGltf(const std::string& path, Materials& materials, bool autoComputeNormal = false, bool autoComputeTangent = false);
+	// optimize reorders triangles and vertices for the vertex cache and overdraw, see Mesh::Optimize
+	std::vector<Mesh*> loadGltf(const std::string& path, Materials& materials, bool autoComputeNormal = false, bool autoComputeTangent = false, bool optimize = true);
 }
 
@@ -1,13 +1,23 @@
 ﻿#include "RayTracingAccelerationStructure.h"
 #include <iostream>
+#include <chrono>
 
-RayTracingAccelerationStructure::RayTracingAccelerationStructure(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator vmaAllocator, VkQueue computeQueue, VkCommandPool computePool, const std::vector<Mesh*>& meshes, const std::vector<VkImageView>& imageViews, const std::vector<VkDescriptorSetLayout>& layouts)
+RayTracingAccelerationStructure::RayTracingAccelerationStructure(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator vmaAllocator, VkQueue computeQueue, VkCommandPool computePool, const std::vector<uint32_t>& queueFamilyIndices, const std::vector<Mesh*>& meshes, const std::vector<VkImageView>& imageViews, const std::vector<VkDescriptorSetLayout>& layouts)
 {
+    m_QueueFamilyIndices = Mesh::GetUniqueQueueFamilies(queueFamilyIndices);
+
     m_RayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
     VkPhysicalDeviceProperties2 deviceProperties2{};
     deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
     deviceProperties2.pNext = &m_RayTracingPipelineProperties;
     vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
+    accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+    deviceProperties2.pNext = &accelerationStructureProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+    m_ScratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
     
     vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR"));
     vkBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkBuildAccelerationStructuresKHR"));
@@ -18,6 +28,8 @@ RayTracingAccelerationStructure::RayTracingAccelerationStructure(VkDevice device
     vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(device, "vkCmdTraceRaysKHR"));
     vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR"));
     vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesKHR"));
+    vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+    vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
 
     m_UpdateScratchBuffers.resize(imageViews.size());
 
@@ -57,6 +69,9 @@ void RayTracingAccelerationStructure::Cleanup(VkDevice device, VmaAllocator vmaA
         if (scratchBuffer.handle != VK_NULL_HANDLE)
             DeleteScratchBuffer(vmaAllocator, scratchBuffer);
     }
+
+    if (m_RefitScratchBuffer.handle != VK_NULL_HANDLE)
+        DeleteScratchBuffer(vmaAllocator, m_RefitScratchBuffer);
     
     m_ShaderGroups.clear();
     
@@ -83,79 +98,192 @@ void RayTracingAccelerationStructure::Cleanup(VkDevice device, VmaAllocator vmaA
 
 void RayTracingAccelerationStructure::CreateBottomLevelASs(VkDevice device, VmaAllocator vmaAllocator, VkQueue computeQueue, VkCommandPool computePool, const std::vector<Mesh*>& meshes)
 {
-    m_BottomLevelASs.reserve(meshes.size());
-    
-    for (auto& mesh : meshes)
-    {
-        AccelerationStructure bottomLevelAS;
-        
-        std::vector<VkAccelerationStructureGeometryKHR> accelerationStructureGeometry{};
-        mesh->GetAccelerationStructureGeometrys(device, accelerationStructureGeometry);
+    if (meshes.empty())
+        return;
 
-        VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo{};
-        accelerationStructureBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-        accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-        accelerationStructureBuildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructureGeometry.size());
-        accelerationStructureBuildGeometryInfo.pGeometries = accelerationStructureGeometry.data();
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    size_t meshCount = meshes.size();
+
+    std::vector<std::vector<VkAccelerationStructureGeometryKHR>> accelerationStructureGeometrys(meshCount);
+    std::vector<std::vector<VkAccelerationStructureBuildRangeInfoKHR>> accelerationStructureRangeInfos(meshCount);
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos(meshCount);
+    std::vector<VkDeviceSize> scratchSizes(meshCount);
+    std::vector<AccelerationStructure> buildBottomLevelASs(meshCount);
+
+    VkDeviceSize buildMemory = 0;
+    VkDeviceSize maxScratchSize = 0;
+    VkDeviceSize refitScratchSize = 0;
+
+    // Sizes first: the scratch arena is shared by every build of a batch
+    for (size_t i = 0; i < meshCount; i++)
+    {
+        meshes[i]->GetAccelerationStructureGeometrys(device, accelerationStructureGeometrys[i]);
+        meshes[i]->GetAccelerationStructureRangeInfos(accelerationStructureRangeInfos[i]);
+
+        VkAccelerationStructureBuildGeometryInfoKHR& buildGeometryInfo = buildGeometryInfos[i];
+        buildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        buildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+        if (meshes[i]->IsSkinned())
+            buildGeometryInfo.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+        buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        buildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructureGeometrys[i].size());
+        buildGeometryInfo.pGeometries = accelerationStructureGeometrys[i].data();
 
         std::vector<uint32_t> primitivesTrianglesCounts;
-        mesh->GetPrimitvesTrianglesCounts(primitivesTrianglesCounts);
-        
+        meshes[i]->GetPrimitvesTrianglesCounts(primitivesTrianglesCounts);
+
         VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo{};
         accelerationStructureBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
         vkGetAccelerationStructureBuildSizesKHR(
             device,
             VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-            &accelerationStructureBuildGeometryInfo,
+            &buildGeometryInfo,
             primitivesTrianglesCounts.data(),
             &accelerationStructureBuildSizesInfo);
 
-        CreateAccelerationStructureBuffer(device, vmaAllocator, bottomLevelAS, accelerationStructureBuildSizesInfo);
+        CreateAccelerationStructure(device, vmaAllocator, buildBottomLevelASs[i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, accelerationStructureBuildSizesInfo.accelerationStructureSize);
 
-        VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
-        accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-        accelerationStructureCreateInfo.buffer = bottomLevelAS.buffer;
-        accelerationStructureCreateInfo.size = accelerationStructureBuildSizesInfo.accelerationStructureSize;
-        accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-        if (vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &bottomLevelAS.handle) != VK_SUCCESS)
+        buildGeometryInfo.dstAccelerationStructure = buildBottomLevelASs[i].handle;
+
+        if (meshes[i]->IsSkinned())
         {
-            std::cout << "Fail to create Acceleration Structure !" << "\n";
-            continue;
+            m_DeformableBottomLevelASIndices.push_back(i);
+            m_DeformableScratchOffsets.push_back(refitScratchSize);
+            refitScratchSize += AlignUp(accelerationStructureBuildSizesInfo.updateScratchSize, m_ScratchAlignment);
         }
 
-        RayTracingScratchBuffer scratchBuffer = CreateScratchBuffer(device, vmaAllocator, accelerationStructureBuildSizesInfo.buildScratchSize);
-        
-        accelerationStructureBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-        accelerationStructureBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-        accelerationStructureBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
+        scratchSizes[i] = AlignUp(accelerationStructureBuildSizesInfo.buildScratchSize, m_ScratchAlignment);
+        maxScratchSize = std::max(maxScratchSize, scratchSizes[i]);
+        buildMemory += accelerationStructureBuildSizesInfo.accelerationStructureSize;
+    }
 
-        std::vector<VkAccelerationStructureBuildRangeInfoKHR> accelerationStructureRangeInfos;
-        mesh->GetAccelerationStructureRangeInfos(accelerationStructureRangeInfos);
-        
-        std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationStructureRangeInfosPtr;
-        accelerationStructureRangeInfosPtr.reserve(accelerationStructureRangeInfos.size());
-        for (uint32_t i = 0; i < accelerationStructureRangeInfos.size(); i++)
-            accelerationStructureRangeInfosPtr.emplace_back(&accelerationStructureRangeInfos[i]);
+    VkDeviceSize arenaSize = std::max(static_cast<VkDeviceSize>(BLAS_SCRATCH_ARENA_SIZE), maxScratchSize);
+    RayTracingScratchBuffer scratchArena = CreateScratchBuffer(device, vmaAllocator, arenaSize + m_ScratchAlignment);
+    VkDeviceAddress arenaAddress = AlignUp(scratchArena.deviceAddress, m_ScratchAlignment);
 
-        VkCommandBuffer commandBuffer = VulkanUtils::BeginSingleTimeCommands(device, computePool);
-    
-        vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &accelerationStructureBuildGeometryInfo, accelerationStructureRangeInfosPtr.data());
+    VkQueryPoolCreateInfo queryPoolCreateInfo{};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+    queryPoolCreateInfo.queryCount = static_cast<uint32_t>(meshCount);
 
-        VulkanUtils::EndSingleTimeCommands(device, computePool, computeQueue, commandBuffer);
+    VkQueryPool compactedSizeQueryPool = VK_NULL_HANDLE;
+    if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &compactedSizeQueryPool) != VK_SUCCESS)
+        std::cout << "Failed to create compacted size query pool !" << "\n";
+
+    VkCommandBuffer commandBuffer = VulkanUtils::BeginSingleTimeCommands(device, computePool);
+
+    vkCmdResetQueryPool(commandBuffer, compactedSizeQueryPool, 0, static_cast<uint32_t>(meshCount));
+
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+    // As many builds as fit in the arena go into one call, the arena is reused by the next batch after a barrier
+    uint32_t batchCount = 0;
+    size_t batchStart = 0;
+
+    while (batchStart < meshCount)
+    {
+        std::vector<VkAccelerationStructureBuildRangeInfoKHR*> batchRangeInfos;
+        VkDeviceSize scratchOffset = 0;
+        size_t batchEnd = batchStart;
+
+        while (batchEnd < meshCount && scratchOffset + scratchSizes[batchEnd] <= arenaSize)
+        {
+            buildGeometryInfos[batchEnd].scratchData.deviceAddress = arenaAddress + scratchOffset;
+            batchRangeInfos.push_back(accelerationStructureRangeInfos[batchEnd].data());
+
+            scratchOffset += scratchSizes[batchEnd];
+            batchEnd++;
+        }
+
+        if (batchCount > 0)
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+        vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(batchEnd - batchStart), &buildGeometryInfos[batchStart], batchRangeInfos.data());
+
+        batchCount++;
+        batchStart = batchEnd;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+    std::vector<VkAccelerationStructureKHR> buildHandles;
+    buildHandles.reserve(meshCount);
+    for (const auto& bottomLevelAS : buildBottomLevelASs)
+        buildHandles.push_back(bottomLevelAS.handle);
+
+    vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, static_cast<uint32_t>(meshCount), buildHandles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizeQueryPool, 0);
+
+    VulkanUtils::EndSingleTimeCommands(device, computePool, computeQueue, commandBuffer);
+
+    DeleteScratchBuffer(vmaAllocator, scratchArena);
+
+    auto buildTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<VkDeviceSize> compactedSizes(meshCount);
+    if (vkGetQueryPoolResults(device, compactedSizeQueryPool, 0, static_cast<uint32_t>(meshCount), meshCount * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+        std::cout << "Failed to get compacted sizes !" << "\n";
+
+    vkDestroyQueryPool(device, compactedSizeQueryPool, nullptr);
+
+    // Compaction: copy every BLAS into an allocation of its compacted size, then drop the build ones
+    m_BottomLevelASs.resize(meshCount);
+
+    VkDeviceSize compactedMemory = 0;
+
+    commandBuffer = VulkanUtils::BeginSingleTimeCommands(device, computePool);
+
+    for (size_t i = 0; i < meshCount; i++)
+    {
+        CreateAccelerationStructure(device, vmaAllocator, m_BottomLevelASs[i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizes[i]);
+
+        VkCopyAccelerationStructureInfoKHR copyAccelerationStructureInfo{};
+        copyAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+        copyAccelerationStructureInfo.src = buildBottomLevelASs[i].handle;
+        copyAccelerationStructureInfo.dst = m_BottomLevelASs[i].handle;
+        copyAccelerationStructureInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+
+        vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyAccelerationStructureInfo);
+
+        compactedMemory += compactedSizes[i];
+    }
+
+    VulkanUtils::EndSingleTimeCommands(device, computePool, computeQueue, commandBuffer);
+
+    for (size_t i = 0; i < meshCount; i++)
+    {
+        vkDestroyAccelerationStructureKHR(device, buildBottomLevelASs[i].handle, nullptr);
+        vmaDestroyBuffer(vmaAllocator, buildBottomLevelASs[i].buffer, buildBottomLevelASs[i].memory);
 
         VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
         accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-        accelerationDeviceAddressInfo.accelerationStructure = bottomLevelAS.handle;
-        bottomLevelAS.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+        accelerationDeviceAddressInfo.accelerationStructure = m_BottomLevelASs[i].handle;
+        m_BottomLevelASs[i].deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
 
-        if (bottomLevelAS.deviceAddress == 0)
+        if (m_BottomLevelASs[i].deviceAddress == 0)
             std::cout << "Failed to get device address for bottom level acceleration structure!\n";
+    }
 
-        m_BottomLevelASs.emplace_back(bottomLevelAS);
-
-        DeleteScratchBuffer(vmaAllocator, scratchBuffer);
+    // Compacted copies keep ALLOW_UPDATE, skinned BLASes are refit in place every frame
+    for (size_t index : m_DeformableBottomLevelASIndices)
+    {
+        m_DeformableGeometrys.push_back(std::move(accelerationStructureGeometrys[index]));
+        m_DeformableRangeInfos.push_back(std::move(accelerationStructureRangeInfos[index]));
     }
+
+    if (refitScratchSize > 0)
+        m_RefitScratchBuffer = CreateScratchBuffer(device, vmaAllocator, refitScratchSize + m_ScratchAlignment);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    std::cout << "BLAS: " << meshCount << " builds (" << m_DeformableBottomLevelASIndices.size() << " refittable) in " << batchCount << " batch(es), "
+              << std::chrono::duration<double, std::milli>(buildTime - startTime).count() << " ms build + "
+              << std::chrono::duration<double, std::milli>(endTime - buildTime).count() << " ms compaction, "
+              << buildMemory / (1024. * 1024.) << " MB -> " << compactedMemory / (1024. * 1024.) << " MB" << "\n";
 }
 
 void RayTracingAccelerationStructure::CreateTopLevelAS(VkDevice device, VmaAllocator vmaAllocator, VkQueue computeQueue, VkCommandPool computePool, const std::vector<Mesh*>& meshes, int count)
@@ -163,27 +291,22 @@ void RayTracingAccelerationStructure::CreateTopLevelAS(VkDevice device, VmaAlloc
     std::vector<VkAccelerationStructureInstanceKHR> instances;
     instances.reserve(m_BottomLevelASs.size());
     
+    std::vector<uint32_t> transformVersions;
+    transformVersions.reserve(m_BottomLevelASs.size());
+
     for (size_t i = 0; i < m_BottomLevelASs.size(); i++)
     {
-        glm::mat4 model = meshes[i]->GetModel();
-
-        VkTransformMatrixKHR transformMatrix = {
-            model[0][0], model[1][0], model[2][0], model[3][0],
-            model[0][1], model[1][1], model[2][1], model[3][1],
-            model[0][2], model[1][2], model[2][2], model[3][2]
-        };
-
-        VkGeometryInstanceFlagsKHR flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-
-        if (!meshes[i]->IsOccluder())
-            flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FLIP_FACING_BIT_KHR;
-
-        instances.emplace_back(transformMatrix, 0, 0xFF, 0, flags, m_BottomLevelASs[i].deviceAddress);
+        instances.emplace_back(CreateInstance(meshes[i], m_BottomLevelASs[i].deviceAddress));
+        transformVersions.push_back(meshes[i]->GetTransformVersion());
     }
 
     m_InstanceBuffer.reserve(count);
     m_TopLevelAS.reserve(count);
 
+    m_InstanceTransformVersions.assign(count, transformVersions);
+    m_TopLevelASDirty.assign(count, false);
+    m_TopLevelASRefitCount.assign(count, 0);
+
     for (int i = 0; i < count; i++)
     {
         AccelerationStructure currentTopLevelAS;
@@ -270,12 +393,35 @@ void RayTracingAccelerationStructure::CreateTopLevelAS(VkDevice device, VmaAlloc
     }
 }
 
+void RayTracingAccelerationStructure::CreateAccelerationStructure(VkDevice device, VmaAllocator allocator, AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkDeviceSize size)
+{
+    VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo{};
+    buildSizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+    buildSizeInfo.accelerationStructureSize = size;
+
+    CreateAccelerationStructureBuffer(device, allocator, accelerationStructure, buildSizeInfo);
+
+    VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
+    accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+    accelerationStructureCreateInfo.buffer = accelerationStructure.buffer;
+    accelerationStructureCreateInfo.size = size;
+    accelerationStructureCreateInfo.type = type;
+    if (vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &accelerationStructure.handle) != VK_SUCCESS)
+        std::cout << "Fail to create Acceleration Structure !" << "\n";
+}
+
+VkDeviceSize RayTracingAccelerationStructure::AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 void RayTracingAccelerationStructure::CreateAccelerationStructureBuffer(VkDevice device, VmaAllocator allocator, AccelerationStructure& accelerationStructure, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo)
 {
     VkBufferCreateInfo bufferCreateInfo{};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = buildSizeInfo.accelerationStructureSize;
     bufferCreateInfo.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    SetSharingMode(bufferCreateInfo);
     
     VmaAllocationCreateInfo bufferAllocInfo = {};
     bufferAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
@@ -285,6 +431,13 @@ void RayTracingAccelerationStructure::CreateAccelerationStructureBuffer(VkDevice
         std::cout << "Failed to create acceleration structure buffer !" << "\n";
 }
 
+void RayTracingAccelerationStructure::SetSharingMode(VkBufferCreateInfo& bufferCreateInfo)
+{
+    bufferCreateInfo.sharingMode = m_QueueFamilyIndices.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = m_QueueFamilyIndices.size() > 1 ? static_cast<uint32_t>(m_QueueFamilyIndices.size()) : 0;
+    bufferCreateInfo.pQueueFamilyIndices = m_QueueFamilyIndices.size() > 1 ? m_QueueFamilyIndices.data() : NULL;
+}
+
 RayTracingScratchBuffer RayTracingAccelerationStructure::CreateScratchBuffer(VkDevice device, VmaAllocator allocator, VkDeviceSize size)
 {
     RayTracingScratchBuffer scratchBuffer{};
@@ -293,6 +446,7 @@ RayTracingScratchBuffer RayTracingAccelerationStructure::CreateScratchBuffer(VkD
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = size;
     bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    SetSharingMode(bufferCreateInfo);
     
     VmaAllocationCreateInfo bufferAllocInfo = {};
     bufferAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
@@ -325,7 +479,7 @@ InstanceBuffer RayTracingAccelerationStructure::CreateInstanceBuffer(VkDevice de
     bufferInfo.size = bufferSize;
     bufferInfo.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
                        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR ;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    SetSharingMode(bufferInfo);
 
     // Spécifier que le buffer doit avoir un addressable device address
     VmaAllocationCreateInfo allocCreateInfo = {};
@@ -613,8 +767,13 @@ void RayTracingAccelerationStructure::CreateShaderBindingTable(VkDevice device,
     m_HitShaderBindingTable.deviceAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
 }
 
-void RayTracingAccelerationStructure::RecordCmdTraceRay(VkDevice device, VmaAllocator vmaAllocator, VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t width, uint32_t height)
+bool RayTracingAccelerationStructure::RecordCmdUpdateTopLevelAS(VkDevice device, VmaAllocator vmaAllocator, VkCommandBuffer commandBuffer, uint32_t imageIndex, VkPipelineStageFlags dstStageMask)
 {
+    if (!m_TopLevelASDirty[imageIndex])
+        return false;
+
+    bool rebuild = m_TopLevelASRefitCount[imageIndex] >= TLAS_REFITS_BEFORE_REBUILD;
+
     VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
     accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
     accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
@@ -627,9 +786,9 @@ void RayTracingAccelerationStructure::RecordCmdTraceRay(VkDevice device, VmaAllo
     buildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
     buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
     buildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
-    buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+    buildGeometryInfo.mode = rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
     buildGeometryInfo.dstAccelerationStructure = m_TopLevelAS[imageIndex].handle;
-    buildGeometryInfo.srcAccelerationStructure = m_TopLevelAS[imageIndex].handle;
+    buildGeometryInfo.srcAccelerationStructure = rebuild ? VK_NULL_HANDLE : m_TopLevelAS[imageIndex].handle;
     buildGeometryInfo.geometryCount = 1;
     buildGeometryInfo.pGeometries = &accelerationStructureGeometry;
 
@@ -644,18 +803,21 @@ void RayTracingAccelerationStructure::RecordCmdTraceRay(VkDevice device, VmaAllo
         &primitiveCount,
         &accelerationStructureBuildSizesInfo);
 
+    // Sized for a full build so the same buffer serves refits and rebuilds
+    VkDeviceSize scratchSize = std::max(accelerationStructureBuildSizesInfo.buildScratchSize, accelerationStructureBuildSizesInfo.updateScratchSize);
+
     RayTracingScratchBuffer& scratchBuffer = m_UpdateScratchBuffers[imageIndex];
 
     if (scratchBuffer.handle == VK_NULL_HANDLE)
     {
-        scratchBuffer = CreateScratchBuffer(device,  vmaAllocator, accelerationStructureBuildSizesInfo.updateScratchSize);
+        scratchBuffer = CreateScratchBuffer(device,  vmaAllocator, scratchSize);
     }
-    else if (scratchBuffer.memoryInfo.size < accelerationStructureBuildSizesInfo.updateScratchSize)
+    else if (scratchBuffer.memoryInfo.size < scratchSize)
     {
         DeleteScratchBuffer(vmaAllocator, scratchBuffer);
         scratchBuffer.handle = VK_NULL_HANDLE;
 
-        scratchBuffer = CreateScratchBuffer(device,  vmaAllocator, accelerationStructureBuildSizesInfo.updateScratchSize);
+        scratchBuffer = CreateScratchBuffer(device,  vmaAllocator, scratchSize);
     }
     
     buildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
@@ -665,13 +827,95 @@ void RayTracingAccelerationStructure::RecordCmdTraceRay(VkDevice device, VmaAllo
     VkAccelerationStructureBuildRangeInfoKHR* pBuildRangeInfos[] = { &buildRangeInfo };
     
     vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildGeometryInfo, pBuildRangeInfos);
-    
-    const uint32_t handleSizeAligned = VulkanUtils::alignedSize(m_RayTracingPipelineProperties.shaderGroupHandleSize, m_RayTracingPipelineProperties.shaderGroupHandleAlignment);
 
-    VkBufferDeviceAddressInfo deviceAddressInfo;
-    deviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-    deviceAddressInfo.pNext = NULL;
-    deviceAddressInfo.buffer = m_RayGenShaderBindingTable.buffer;
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,  // Source stage
+        dstStageMask,                                           // Destination stage
+        0,                                                      // No dependency flags
+        1,                                                      // Memory barrier count
+        &memoryBarrier,                                          // Memory barrier
+        0, NULL,                                                // No buffer barriers
+        0, NULL                                                 // No image barriers
+    );
+
+    m_TopLevelASDirty[imageIndex] = false;
+    m_TopLevelASRefitCount[imageIndex] = rebuild ? 0 : m_TopLevelASRefitCount[imageIndex] + 1;
+
+    return true;
+}
+
+void RayTracingAccelerationStructure::RecordCmdRefitBottomLevelASs(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    if (m_DeformableBottomLevelASIndices.empty())
+        return;
+
+    // Rays of the previous frame may still traverse the BLASes refit in place, and the scratch is shared by every frame
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+    size_t refitCount = m_DeformableBottomLevelASIndices.size();
+
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos(refitCount);
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos(refitCount);
+
+    VkDeviceAddress scratchAddress = AlignUp(m_RefitScratchBuffer.deviceAddress, m_ScratchAlignment);
+
+    for (size_t i = 0; i < refitCount; i++)
+    {
+        VkAccelerationStructureKHR bottomLevelAS = m_BottomLevelASs[m_DeformableBottomLevelASIndices[i]].handle;
+
+        // Same flags as the initial build, an update must not change them
+        VkAccelerationStructureBuildGeometryInfoKHR& buildGeometryInfo = buildGeometryInfos[i];
+        buildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        buildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+        buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+        buildGeometryInfo.srcAccelerationStructure = bottomLevelAS;
+        buildGeometryInfo.dstAccelerationStructure = bottomLevelAS;
+        buildGeometryInfo.geometryCount = static_cast<uint32_t>(m_DeformableGeometrys[i].size());
+        buildGeometryInfo.pGeometries = m_DeformableGeometrys[i].data();
+        buildGeometryInfo.scratchData.deviceAddress = scratchAddress + m_DeformableScratchOffsets[i];
+
+        buildRangeInfos[i] = m_DeformableRangeInfos[i].data();
+    }
+
+    vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(refitCount), buildGeometryInfos.data(), buildRangeInfos.data());
+
+    // The TLAS update reads the new bounds, its own barrier then covers the traversal
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+    m_TopLevelASDirty[imageIndex] = true;
+}
+
+bool RayTracingAccelerationStructure::HasDeformableBottomLevelASs()
+{
+    return !m_DeformableBottomLevelASIndices.empty();
+}
+
+void RayTracingAccelerationStructure::RecordCmdTraceRay(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height)
+{
+    const uint32_t handleSizeAligned = VulkanUtils::alignedSize(m_RayTracingPipelineProperties.shaderGroupHandleSize, m_RayTracingPipelineProperties.shaderGroupHandleAlignment);
 
     VkStridedDeviceAddressRegionKHR raygenShaderSbtEntry{};
     raygenShaderSbtEntry.deviceAddress = m_RayGenShaderBindingTable.deviceAddress;
@@ -690,23 +934,6 @@ void RayTracingAccelerationStructure::RecordCmdTraceRay(VkDevice device, VmaAllo
 
     VkStridedDeviceAddressRegionKHR callableShaderSbtEntry{};
 
-    VkMemoryBarrier memoryBarrier = {};
-    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    memoryBarrier.pNext = NULL;
-    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
-    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
-
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,  // Source stage
-        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,            // Destination stage
-        0,                                                      // No dependency flags
-        1,                                                      // Memory barrier count
-        &memoryBarrier,                                          // Memory barrier
-        0, NULL,                                                // No buffer barriers
-        0, NULL                                                 // No image barriers
-    );
-
     vkCmdTraceRaysKHR(
         commandBuffer,
         &raygenShaderSbtEntry,
@@ -729,68 +956,83 @@ void RayTracingAccelerationStructure::UpdateUniform(const glm::mat4& viewInverse
     memcpy(uniformAllocInfo.pMappedData, &uniformData, sizeof(UniformData));
 }
 
-void RayTracingAccelerationStructure::UpdateTransform(uint32_t imageIndex, const std::vector<uint32_t>& transformIndexs, const std::vector<glm::mat4>& transforms, const std::vector<bool>& nonOccluderIndexs)
+void RayTracingAccelerationStructure::UpdateTransforms(uint32_t imageIndex, const std::vector<Mesh*>& meshes)
 {
-    for (int i = 0; i < transformIndexs.size(); i++)
+    std::vector<uint32_t>& transformVersions = m_InstanceTransformVersions[imageIndex];
+
+    for (size_t i = 0; i < m_BottomLevelASs.size() && i < meshes.size(); i++)
     {
-        uint32_t transformIndex = transformIndexs[i];
-        glm::mat4 transform = transforms[i];
-        
-        VkTransformMatrixKHR transformMatrix = {
-            transform[0][0], transform[1][0], transform[2][0], transform[3][0],
-            transform[0][1], transform[1][1], transform[2][1], transform[3][1],
-            transform[0][2], transform[1][2], transform[2][2], transform[3][2]
-        };
-
-        VkAccelerationStructureInstanceKHR instance;
-        instance.transform = transformMatrix;
-        instance.instanceCustomIndex = 0;
-        instance.mask = 0xFF;
-        instance.instanceShaderBindingTableRecordOffset = 0;
-        instance.accelerationStructureReference = m_BottomLevelASs[transformIndex].deviceAddress;
-
-        bool nonOccluder = false;
-        
-        for (auto nonOccluderIndex : nonOccluderIndexs)
-        {
-            nonOccluder = nonOccluder || (i == nonOccluderIndex);
-            break;
-        }
+        uint32_t transformVersion = meshes[i]->GetTransformVersion();
 
-        VkGeometryInstanceFlagsKHR flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV;
+        if (transformVersion == transformVersions[i])
+            continue;
 
-        if (nonOccluder)
-            flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FLIP_FACING_BIT_KHR;
+        VkAccelerationStructureInstanceKHR instance = CreateInstance(meshes[i], m_BottomLevelASs[i].deviceAddress);
+        memcpy(reinterpret_cast<uint8_t*>(m_InstanceBuffer[imageIndex].memoryInfo.pMappedData) + i * sizeof(VkAccelerationStructureInstanceKHR), &instance, sizeof(VkAccelerationStructureInstanceKHR));
 
-        instance.flags = flags;
-        
-        memcpy(reinterpret_cast<uint8_t*>(m_InstanceBuffer[imageIndex].memoryInfo.pMappedData) + transformIndex * sizeof(VkAccelerationStructureInstanceKHR), &instance, sizeof(VkAccelerationStructureInstanceKHR));
+        transformVersions[i] = transformVersion;
+        m_TopLevelASDirty[imageIndex] = true;
     }
 }
 
+VkAccelerationStructureInstanceKHR RayTracingAccelerationStructure::CreateInstance(Mesh* mesh, uint64_t bottomLevelASAddress)
+{
+    const glm::mat4& model = mesh->GetModel();
+
+    VkTransformMatrixKHR transformMatrix = {
+        model[0][0], model[1][0], model[2][0], model[3][0],
+        model[0][1], model[1][1], model[2][1], model[3][1],
+        model[0][2], model[1][2], model[2][2], model[3][2]
+    };
+
+    VkGeometryInstanceFlagsKHR flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+
+    if (!mesh->IsOccluder())
+        flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FLIP_FACING_BIT_KHR;
+
+    VkAccelerationStructureInstanceKHR instance;
+    instance.transform = transformMatrix;
+    instance.instanceCustomIndex = 0;
+    instance.mask = 0xFF;
+    instance.instanceShaderBindingTableRecordOffset = 0;
+    instance.flags = flags;
+    instance.accelerationStructureReference = bottomLevelASAddress;
+
+    return instance;
+}
+
 void RayTracingAccelerationStructure::UpdateImageDescriptor(VkDevice device, const std::vector<VkImageView>& imageViews)
 {
-    std::vector<VkDescriptorSet> descriptorSet = m_TopLevelASDescriptor.GetDescriptorSets();
-    
     for (size_t i = 0; i < imageViews.size(); i++)
-    {
-        VkWriteDescriptorSet descriptorSetWrite{};
+        UpdateImageDescriptor(device, imageViews[i], static_cast<uint32_t>(i));
+}
 
-        VkDescriptorImageInfo descriptorImageInfo{};
-        descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-        descriptorImageInfo.imageView = imageViews[i];
-        descriptorImageInfo.sampler = VK_NULL_HANDLE;
+void RayTracingAccelerationStructure::UpdateImageDescriptor(VkDevice device, VkImageView imageView, uint32_t frame)
+{
+    VkDescriptorImageInfo descriptorImageInfo{};
+    descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    descriptorImageInfo.imageView = imageView;
+    descriptorImageInfo.sampler = VK_NULL_HANDLE;
+
+    VkWriteDescriptorSet descriptorSetWrite{};
+    descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSetWrite.pNext = NULL;
+    descriptorSetWrite.dstSet = m_TopLevelASDescriptor.GetDescriptorSets()[frame];
+    descriptorSetWrite.dstBinding = 1;
+    descriptorSetWrite.descriptorCount = 1;
+    descriptorSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorSetWrite.pImageInfo = &descriptorImageInfo;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorSetWrite, 0, VK_NULL_HANDLE);
+}
 
-        descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSetWrite.pNext = NULL;
-        descriptorSetWrite.dstSet = descriptorSet[i];
-        descriptorSetWrite.dstBinding = 1;
-        descriptorSetWrite.descriptorCount = 1;
-        descriptorSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        descriptorSetWrite.pImageInfo = &descriptorImageInfo;
+std::vector<VkAccelerationStructureKHR> RayTracingAccelerationStructure::GetTopLevelASs()
+{
+    std::vector<VkAccelerationStructureKHR> topLevelASs;
+    for (const auto& topLevelAS : m_TopLevelAS)
+        topLevelASs.push_back(topLevelAS.handle);
 
-        vkUpdateDescriptorSets(device, 1, &descriptorSetWrite, 0, VK_NULL_HANDLE);
-    }
+    return topLevelASs;
 }
 
 VkPipelineLayout RayTracingAccelerationStructure::GetRayTracingPipelineLayout()
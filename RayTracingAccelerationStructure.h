@@ -6,6 +6,12 @@
 #include "Descriptor.h"
 #include "Shader.h"
 
+// Upper bound of the scratch memory shared by one batch of BLAS builds
+#define BLAS_SCRATCH_ARENA_SIZE (128ull * 1024 * 1024)
+
+// Refits degrade the TLAS quality, it is rebuilt from scratch after this many of them
+#define TLAS_REFITS_BEFORE_REBUILD 64
+
 struct InstanceBuffer
 {
     VmaAllocation memory;
@@ -44,20 +50,37 @@ class RayTracingAccelerationStructure
 {
 public:
 
-    RayTracingAccelerationStructure(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator vmaAllocator, VkQueue computeQueue, VkCommandPool computePool, const std::vector<Mesh*>& meshes, const std::vector<VkImageView>& imageViews, const std::vector<VkDescriptorSetLayout>& layouts);
+    // Buffers are shared by every family of queueFamilyIndices: the structures are built on the compute queue and traversed on the graphics one
+    RayTracingAccelerationStructure(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator vmaAllocator, VkQueue computeQueue, VkCommandPool computePool, const std::vector<uint32_t>& queueFamilyIndices, const std::vector<Mesh*>& meshes, const std::vector<VkImageView>& imageViews, const std::vector<VkDescriptorSetLayout>& layouts);
 
     void BindPipeline(VkCommandBuffer commandBuffer);
 
     void BindTopLevelASDescriptorSet(VkCommandBuffer commandBuffer, uint32_t imageIndex);
     
-    void RecordCmdTraceRay(VkDevice device, VmaAllocator vmaAllocator, VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t width, uint32_t height);
+    // Refit (or periodically rebuild) the top level AS if an instance changed, then make it visible to dstStageMask.
+    // Returns false when nothing moved: no build and no barrier are recorded
+    bool RecordCmdUpdateTopLevelAS(VkDevice device, VmaAllocator vmaAllocator, VkCommandBuffer commandBuffer, uint32_t imageIndex, VkPipelineStageFlags dstStageMask);
+
+    // Refit in place the BLAS of every skinned mesh from this frame's skinned vertices, the TLAS is then refit as well
+    void RecordCmdRefitBottomLevelASs(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    bool HasDeformableBottomLevelASs();
+
+    // The top level AS must be up to date, see RecordCmdUpdateTopLevelAS
+    void RecordCmdTraceRay(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height);
 
     void UpdateUniform(const glm::mat4& viewInverse, const glm::mat4& projInverse, uint32_t imageIndex, const std::vector<Mesh*>& meshes);
 
-    void UpdateTransform(uint32_t imageIndex, const std::vector<uint32_t>& transformIndexs, const std::vector<glm::mat4>& transforms, const std::vector<bool>& nonOccluderIndex);
+    // Write the instances whose mesh transform changed since this frame's TLAS last saw it
+    void UpdateTransforms(uint32_t imageIndex, const std::vector<Mesh*>& meshes);
 
     void UpdateImageDescriptor(VkDevice device, const std::vector<VkImageView>& imageViews);
 
+    // Only the frame's set, the other frames' sets may still be in use
+    void UpdateImageDescriptor(VkDevice device, VkImageView imageView, uint32_t frame);
+
+    std::vector<VkAccelerationStructureKHR> GetTopLevelASs();
+
     VkPipelineLayout GetRayTracingPipelineLayout();
 
     bool* GetActiveRaytracingPtr();
@@ -72,10 +95,18 @@ private:
 
     void CreateAccelerationStructureBuffer(VkDevice device, VmaAllocator allocator, AccelerationStructure &accelerationStructure, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo);
 
+    void CreateAccelerationStructure(VkDevice device, VmaAllocator allocator, AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkDeviceSize size);
+
+    static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment);
+
+    VkAccelerationStructureInstanceKHR CreateInstance(Mesh* mesh, uint64_t bottomLevelASAddress);
+
     RayTracingScratchBuffer CreateScratchBuffer(VkDevice device, VmaAllocator allocator, VkDeviceSize size);
 
     InstanceBuffer CreateInstanceBuffer(VkDevice device, VmaAllocator allocator, std::vector<VkAccelerationStructureInstanceKHR>& instances);
 
+    void SetSharingMode(VkBufferCreateInfo& bufferCreateInfo);
+
     void DeleteScratchBuffer(VmaAllocator allocator, const RayTracingScratchBuffer& scratchBuffer);
 
     void CreateDescriptorSets(VkDevice device, VmaAllocator allocator, const std::vector<VkImageView>& imageViews);
@@ -87,11 +118,25 @@ private:
     bool m_ActiveRayTracing = 0;
 
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR  m_RayTracingPipelineProperties;
+    VkDeviceSize m_ScratchAlignment = 1;
+    std::vector<uint32_t> m_QueueFamilyIndices;
     
     std::vector<AccelerationStructure> m_BottomLevelASs{};
     std::vector<AccelerationStructure> m_TopLevelAS{};
     std::vector<InstanceBuffer> m_InstanceBuffer;
     std::vector<RayTracingScratchBuffer> m_UpdateScratchBuffers;
+
+    // Skinned meshes: their BLAS allows updates, geometry and ranges are kept for the per frame refit
+    std::vector<size_t> m_DeformableBottomLevelASIndices;
+    std::vector<std::vector<VkAccelerationStructureGeometryKHR>> m_DeformableGeometrys;
+    std::vector<std::vector<VkAccelerationStructureBuildRangeInfoKHR>> m_DeformableRangeInfos;
+    std::vector<VkDeviceSize> m_DeformableScratchOffsets;
+    RayTracingScratchBuffer m_RefitScratchBuffer;
+
+    // Per frame in flight: transform version of each instance, pending changes and refits since the last build
+    std::vector<std::vector<uint32_t>> m_InstanceTransformVersions;
+    std::vector<bool> m_TopLevelASDirty;
+    std::vector<uint32_t> m_TopLevelASRefitCount;
     
     Descriptor m_TopLevelASDescriptor;
 
@@ -113,4 +158,6 @@ private:
     PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
     PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
     PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+    PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
 };
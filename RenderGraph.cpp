@@ -0,0 +1,541 @@
+#include "RenderGraph.h"
+#include <algorithm>
+
+static constexpr VkAccessFlags2 WRITE_ACCESS_MASK = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                                    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+void RenderGraph::Reset()
+{
+    m_Passes.clear();
+    m_Resources.clear();
+    m_CulledPassCount = 0;
+}
+
+RenderGraphResource RenderGraph::ImportImage(const std::string& name, VkImage image, VkImageAspectFlags aspect, VkImageLayout finalLayout, VkPipelineStageFlags2 acquireStages)
+{
+    Resource resource;
+    resource.name = name;
+    resource.image = image;
+    resource.aspect = aspect;
+    resource.finalLayout = finalLayout;
+    resource.imported = true;
+
+    // First import starts UNDEFINED, the following ones pick up where the last frame left the image
+    RenderGraphImageState& state = m_ImportedStates[image];
+    if (acquireStages != VK_PIPELINE_STAGE_2_NONE)
+    {
+        state = RenderGraphImageState();
+        state.writeStages = acquireStages;
+    }
+
+    m_Resources.push_back(resource);
+
+    return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::CreateImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+    Resource resource;
+    resource.name = name;
+    resource.aspect = desc.aspect;
+    resource.imported = false;
+    resource.desc = desc;
+
+    m_Resources.push_back(resource);
+
+    return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+}
+
+void RenderGraph::KeepImage(RenderGraphResource resource)
+{
+    m_Resources[resource].kept = true;
+}
+
+uint32_t RenderGraph::AddPass(const std::string& name, std::function<void(VkCommandBuffer)> execute, bool sideEffects)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    pass.sideEffects = sideEffects;
+
+    m_Passes.push_back(std::move(pass));
+
+    return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+void RenderGraph::ReadImage(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage, VkPipelineStageFlags2 stages)
+{
+    m_Passes[pass].accesses.push_back({ resource, usage, stages, false, false });
+}
+
+void RenderGraph::WriteImage(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage, VkPipelineStageFlags2 stages, bool discard)
+{
+    m_Passes[pass].accesses.push_back({ resource, usage, stages, true, discard });
+}
+
+void RenderGraph::Compile(VkDevice device, VmaAllocator allocator, DeletionQueue& deletionQueue, uint64_t frame)
+{
+    CullPasses();
+
+    for (uint32_t p = 0; p < m_Passes.size(); p++)
+    {
+        if (m_Passes[p].culled)
+            continue;
+
+        for (const ImageAccess& access : m_Passes[p].accesses)
+        {
+            Resource& resource = m_Resources[access.resource];
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+        }
+    }
+
+    PlaceTransientImages(device, allocator, deletionQueue, frame);
+}
+
+void RenderGraph::CullPasses()
+{
+    // Walk backward: a pass is kept when it has side effects or writes something a kept pass, the presentation or the
+    // next frame needs
+    std::vector<bool> needed(m_Resources.size(), false);
+    for (size_t i = 0; i < m_Resources.size(); i++)
+        needed[i] = m_Resources[i].kept || (m_Resources[i].imported && m_Resources[i].finalLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+
+    for (size_t p = m_Passes.size(); p-- > 0;)
+    {
+        Pass& pass = m_Passes[p];
+
+        bool keep = pass.sideEffects;
+        for (const ImageAccess& access : pass.accesses)
+        {
+            if (access.write && needed[access.resource])
+                keep = true;
+        }
+
+        pass.culled = !keep;
+        if (!keep)
+        {
+            m_CulledPassCount++;
+            continue;
+        }
+
+        // A discarding write ends what an earlier write produced, reads and loads extend it
+        for (const ImageAccess& access : pass.accesses)
+        {
+            if (access.write && access.discard)
+                needed[access.resource] = false;
+        }
+        for (const ImageAccess& access : pass.accesses)
+        {
+            if (!access.write || !access.discard)
+                needed[access.resource] = true;
+        }
+    }
+}
+
+void RenderGraph::PlaceTransientImages(VkDevice device, VmaAllocator allocator, DeletionQueue& deletionQueue, uint64_t frame)
+{
+    std::vector<RenderGraphResource> transients;
+    for (RenderGraphResource i = 0; i < m_Resources.size(); i++)
+    {
+        if (!m_Resources[i].imported && m_Resources[i].firstPass != UINT32_MAX)
+            transients.push_back(i);
+    }
+
+    std::sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b) {
+        return m_Resources[a].firstPass < m_Resources[b].firstPass;
+    });
+
+    // Greedy first fit: an image takes the first slot whose last user is done before it starts and whose memory type suits it
+    std::vector<VkMemoryRequirements> slotRequirements;
+    std::vector<uint32_t> slotEnds;
+
+    for (RenderGraphResource transient : transients)
+    {
+        Resource& resource = m_Resources[transient];
+
+        VkImageCreateInfo imageCreateInfo = GetImageCreateInfo(resource.desc);
+
+        VkDeviceImageMemoryRequirements deviceImageMemoryRequirements{};
+        deviceImageMemoryRequirements.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+        deviceImageMemoryRequirements.pCreateInfo = &imageCreateInfo;
+
+        VkMemoryRequirements2 memoryRequirements{};
+        memoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+
+        vkGetDeviceImageMemoryRequirements(device, &deviceImageMemoryRequirements, &memoryRequirements);
+
+        const VkMemoryRequirements& requirements = memoryRequirements.memoryRequirements;
+
+        uint32_t slot = 0;
+        for (; slot < slotRequirements.size(); slot++)
+        {
+            if (slotEnds[slot] < resource.firstPass && (slotRequirements[slot].memoryTypeBits & requirements.memoryTypeBits) != 0)
+                break;
+        }
+
+        if (slot == slotRequirements.size())
+        {
+            slotRequirements.push_back(requirements);
+            slotEnds.push_back(resource.lastPass);
+        }
+        else
+        {
+            slotRequirements[slot].size = std::max(slotRequirements[slot].size, requirements.size);
+            slotRequirements[slot].alignment = std::max(slotRequirements[slot].alignment, requirements.alignment);
+            slotRequirements[slot].memoryTypeBits &= requirements.memoryTypeBits;
+            slotEnds[slot] = resource.lastPass;
+        }
+
+        resource.slot = slot;
+    }
+
+    // Same placement as the previous frames: keep the images, nothing to wait for
+    bool samePlacement = transients.size() == m_TransientImages.size() && slotRequirements.size() == m_MemorySlots.size();
+    for (size_t i = 0; samePlacement && i < transients.size(); i++)
+    {
+        const Resource& resource = m_Resources[transients[i]];
+        const TransientImage& transientImage = m_TransientImages[i];
+
+        samePlacement = transientImage.name == resource.name && transientImage.slot == resource.slot &&
+                        transientImage.desc.format == resource.desc.format && transientImage.desc.usage == resource.desc.usage &&
+                        transientImage.desc.aspect == resource.desc.aspect && transientImage.desc.extent.width == resource.desc.extent.width &&
+                        transientImage.desc.extent.height == resource.desc.extent.height;
+    }
+    for (size_t slot = 0; samePlacement && slot < slotRequirements.size(); slot++)
+        samePlacement = m_MemorySlots[slot].requirements.size >= slotRequirements[slot].size;
+
+    if (!samePlacement)
+    {
+        // The old images may still be used by frames in flight, they are destroyed once those are done
+        if (!m_TransientImages.empty() || !m_MemorySlots.empty())
+        {
+            std::vector<TransientImage> oldTransientImages = std::move(m_TransientImages);
+            std::vector<MemorySlot> oldMemorySlots = std::move(m_MemorySlots);
+            m_TransientImages.clear();
+            m_MemorySlots.clear();
+
+            deletionQueue.Push(frame, [device, allocator, oldTransientImages, oldMemorySlots]() {
+                for (const TransientImage& transientImage : oldTransientImages)
+                {
+                    vkDestroyImageView(device, transientImage.view, nullptr);
+                    vkDestroyImage(device, transientImage.image, nullptr);
+                }
+
+                for (const MemorySlot& slot : oldMemorySlots)
+                {
+                    if (slot.allocation != VK_NULL_HANDLE)
+                        vmaFreeMemory(allocator, slot.allocation);
+                }
+            });
+        }
+
+        m_PlacementVersion++;
+
+        m_MemorySlots.resize(slotRequirements.size());
+        for (size_t slot = 0; slot < slotRequirements.size(); slot++)
+        {
+            VmaAllocationCreateInfo allocCreateInfo{};
+            allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+            m_MemorySlots[slot].requirements = slotRequirements[slot];
+
+            if (vmaAllocateMemory(allocator, &slotRequirements[slot], &allocCreateInfo, &m_MemorySlots[slot].allocation, nullptr) != VK_SUCCESS)
+                std::cout << "Render graph transient memory allocation failed !" << '\n';
+        }
+
+        for (RenderGraphResource transient : transients)
+        {
+            const Resource& resource = m_Resources[transient];
+
+            TransientImage transientImage;
+            transientImage.name = resource.name;
+            transientImage.desc = resource.desc;
+            transientImage.slot = resource.slot;
+
+            VkImageCreateInfo imageCreateInfo = GetImageCreateInfo(resource.desc);
+
+            if (vkCreateImage(device, &imageCreateInfo, nullptr, &transientImage.image) != VK_SUCCESS)
+                std::cout << "Render graph transient image creation failed !" << '\n';
+
+            if (vmaBindImageMemory(allocator, m_MemorySlots[resource.slot].allocation, transientImage.image) != VK_SUCCESS)
+                std::cout << "Render graph transient image binding failed !" << '\n';
+
+            VkImageViewCreateInfo imageViewCreateInfo{};
+            imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            imageViewCreateInfo.image = transientImage.image;
+            imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            imageViewCreateInfo.format = resource.desc.format;
+            imageViewCreateInfo.subresourceRange.aspectMask = resource.desc.aspect;
+            imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+            imageViewCreateInfo.subresourceRange.levelCount = 1;
+            imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+            imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &transientImage.view) != VK_SUCCESS)
+                std::cout << "Render graph transient image view creation failed !" << '\n';
+
+            m_TransientImages.push_back(transientImage);
+        }
+    }
+
+    for (size_t i = 0; i < transients.size(); i++)
+    {
+        m_Resources[transients[i]].image = m_TransientImages[i].image;
+        m_Resources[transients[i]].view = m_TransientImages[i].view;
+    }
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+{
+    std::vector<VkImageMemoryBarrier2> barriers;
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+
+    for (uint32_t p = 0; p < m_Passes.size(); p++)
+    {
+        Pass& pass = m_Passes[p];
+        if (pass.culled)
+            continue;
+
+        // Every barrier the pass needs goes out in a single call
+        barriers.clear();
+        for (const ImageAccess& access : pass.accesses)
+        {
+            const Resource& resource = m_Resources[access.resource];
+
+            if (resource.imported)
+            {
+                AddBarrier(resource, access, m_ImportedStates[resource.image], barriers);
+                continue;
+            }
+
+            RenderGraphImageState& state = m_MemorySlots[resource.slot].state;
+            if (resource.firstPass == p)
+                state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            AddBarrier(resource, access, state, barriers);
+        }
+
+        if (!barriers.empty())
+        {
+            dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+            dependencyInfo.pImageMemoryBarriers = barriers.data();
+            vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        }
+
+        pass.execute(commandBuffer);
+    }
+
+    barriers.clear();
+    for (const Resource& resource : m_Resources)
+    {
+        if (!resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+            continue;
+
+        RenderGraphImageState& state = m_ImportedStates[resource.image];
+        if (state.layout == resource.finalLayout)
+            continue;
+
+        VkImageMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = state.writeStages | state.readStages;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.dstAccessMask = VK_ACCESS_2_NONE;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = resource.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange = { resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+        barriers.push_back(barrier);
+
+        // Whoever uses the image next has nothing better to wait on than the transition itself
+        state.layout = resource.finalLayout;
+        state.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        state.writeAccess = VK_ACCESS_2_NONE;
+        state.readStages = VK_PIPELINE_STAGE_2_NONE;
+    }
+
+    if (!barriers.empty())
+    {
+        dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+        dependencyInfo.pImageMemoryBarriers = barriers.data();
+        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+    }
+}
+
+void RenderGraph::AddBarrier(const Resource& resource, const ImageAccess& access, RenderGraphImageState& state, std::vector<VkImageMemoryBarrier2>& barriers)
+{
+    VkImageLayout layout;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 accessMask;
+    GetUsageInfo(access.usage, access.write, access.discard, access.stages, layout, stages, accessMask);
+
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.dstStageMask = stages;
+    barrier.dstAccessMask = accessMask;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = resource.image;
+    barrier.subresourceRange = { resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+    bool layoutChange = state.layout != layout;
+
+    if (access.write || layoutChange)
+    {
+        // Writes and transitions wait on the last write and on every read since
+        barrier.srcStageMask = state.writeStages | state.readStages;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.oldLayout = access.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+
+        if (layoutChange || barrier.srcStageMask != VK_PIPELINE_STAGE_2_NONE)
+            barriers.push_back(barrier);
+
+        state.layout = layout;
+        state.writeStages = stages;
+        if (access.write)
+        {
+            state.writeAccess = accessMask & WRITE_ACCESS_MASK;
+            state.readStages = VK_PIPELINE_STAGE_2_NONE;
+        }
+        else
+        {
+            // The transition is done before these stages, later readers only need to wait on them
+            state.writeAccess = VK_ACCESS_2_NONE;
+            state.readStages = stages;
+        }
+
+        return;
+    }
+
+    // Read after read in the same layout: only stages that have not seen the last write yet need a barrier
+    VkPipelineStageFlags2 missingStages = stages & ~state.readStages;
+    if (missingStages != VK_PIPELINE_STAGE_2_NONE && state.writeStages != VK_PIPELINE_STAGE_2_NONE)
+    {
+        barrier.srcStageMask = state.writeStages;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstStageMask = missingStages;
+        barrier.oldLayout = layout;
+        barriers.push_back(barrier);
+    }
+
+    state.readStages |= stages;
+}
+
+void RenderGraph::GetUsageInfo(RenderGraphUsage usage, bool write, bool discard, VkPipelineStageFlags2 stages, VkImageLayout& layout, VkPipelineStageFlags2& outStages, VkAccessFlags2& access)
+{
+    switch (usage)
+    {
+        case RG_USAGE_COLOR_ATTACHMENT:
+            layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            outStages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+            if (write)
+                access = discard ? VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT : access | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case RG_USAGE_DEPTH_ATTACHMENT:
+            layout = write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            outStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+            access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            if (write)
+                access = discard ? VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : access | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            break;
+        case RG_USAGE_SAMPLED:
+            layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            outStages = stages;
+            access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+            break;
+        case RG_USAGE_STORAGE:
+            layout = VK_IMAGE_LAYOUT_GENERAL;
+            outStages = stages;
+            access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+            if (write)
+                access = discard ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT : access | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+            break;
+        case RG_USAGE_TRANSFER_SRC:
+            layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            outStages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+            access = VK_ACCESS_2_TRANSFER_READ_BIT;
+            break;
+        case RG_USAGE_TRANSFER_DST:
+        default:
+            layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            outStages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+            access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+            break;
+    }
+}
+
+VkImageCreateInfo RenderGraph::GetImageCreateInfo(const RenderGraphImageDesc& desc)
+{
+    VkImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = desc.format;
+    imageCreateInfo.extent = { desc.extent.width, desc.extent.height, 1 };
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = desc.usage;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    return imageCreateInfo;
+}
+
+VkImage RenderGraph::GetImage(RenderGraphResource resource)
+{
+    return m_Resources[resource].image;
+}
+
+VkImageView RenderGraph::GetImageView(RenderGraphResource resource)
+{
+    return m_Resources[resource].view;
+}
+
+uint32_t RenderGraph::GetCulledPassCount()
+{
+    return m_CulledPassCount;
+}
+
+uint32_t RenderGraph::GetPlacementVersion()
+{
+    return m_PlacementVersion;
+}
+
+void RenderGraph::DestroyTransientImages(VkDevice device, VmaAllocator allocator)
+{
+    for (TransientImage& transientImage : m_TransientImages)
+    {
+        vkDestroyImageView(device, transientImage.view, nullptr);
+        vkDestroyImage(device, transientImage.image, nullptr);
+    }
+    m_TransientImages.clear();
+
+    for (MemorySlot& slot : m_MemorySlots)
+    {
+        if (slot.allocation != VK_NULL_HANDLE)
+            vmaFreeMemory(allocator, slot.allocation);
+    }
+    m_MemorySlots.clear();
+}
+
+void RenderGraph::ReleaseImage(VkImage image)
+{
+    m_ImportedStates.erase(image);
+}
+
+void RenderGraph::Cleanup(VkDevice device, VmaAllocator allocator)
+{
+    DestroyTransientImages(device, allocator);
+
+    m_ImportedStates.clear();
+
+    Reset();
+}
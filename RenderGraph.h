@@ -0,0 +1,164 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include "DeletionQueue.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+typedef uint32_t RenderGraphResource;
+
+// How a pass touches an image, each usage maps to one layout and one kind of access
+enum RenderGraphUsage
+{
+    RG_USAGE_COLOR_ATTACHMENT,
+    RG_USAGE_DEPTH_ATTACHMENT,
+    RG_USAGE_SAMPLED,
+    RG_USAGE_STORAGE,
+    RG_USAGE_TRANSFER_SRC,
+    RG_USAGE_TRANSFER_DST
+};
+
+struct RenderGraphImageDesc
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = { 0, 0 };
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// What the next barrier on an image has to wait on
+struct RenderGraphImageState
+{
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Last write, still to be made visible to the following accesses
+    VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+    // Stages already seeing the last write, the next write has to wait on them as well
+    VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+};
+
+// Rebuilt every frame: Reset, import or create the images, add the passes with what they read and write, Compile, Execute.
+// Imported images keep their state across frames, so the barriers between frames are as tight as inside one.
+// Transient images only live between their first and last pass and share memory with the ones whose lifetimes don't overlap.
+class RenderGraph
+{
+public:
+    void Reset();
+
+    // finalLayout is applied once every pass ran. With acquireStages the content is dropped and the first access waits on
+    // these stages only, the ones the acquire semaphore is waited at
+    RenderGraphResource ImportImage(const std::string& name, VkImage image, VkImageAspectFlags aspect, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED, VkPipelineStageFlags2 acquireStages = VK_PIPELINE_STAGE_2_NONE);
+
+    RenderGraphResource CreateImage(const std::string& name, const RenderGraphImageDesc& desc);
+
+    // The content is read after the frame (history, previous G-buffer), the passes writing it are never culled. Imported
+    // images with a finalLayout are kept as well, the others only live as long as a kept pass reads them
+    void KeepImage(RenderGraphResource resource);
+
+    // A pass without side effects is culled when nothing kept reads what it writes
+    uint32_t AddPass(const std::string& name, std::function<void(VkCommandBuffer)> execute, bool sideEffects = false);
+
+    // Shader usages need the stages reading it, attachment and transfer usages know theirs
+    void ReadImage(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage, VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE);
+
+    // discard: the pass overwrites everything (cleared attachment, full screen store), the previous content is not kept
+    void WriteImage(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage, VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE, bool discard = false);
+
+    // Cull the passes and place the transient images, their memory is only reallocated when the placement changes.
+    // Replaced images are retired to deletionQueue under frame, the frames in flight may still use them
+    void Compile(VkDevice device, VmaAllocator allocator, DeletionQueue& deletionQueue, uint64_t frame);
+
+    void Execute(VkCommandBuffer commandBuffer);
+
+    VkImage GetImage(RenderGraphResource resource);
+
+    VkImageView GetImageView(RenderGraphResource resource);
+
+    uint32_t GetCulledPassCount();
+
+    // Changes whenever the transient images are recreated, descriptors holding their views have to be written again
+    uint32_t GetPlacementVersion();
+
+    // The image is about to be destroyed, a new image reusing its handle must not inherit its state
+    void ReleaseImage(VkImage image);
+
+    // Transient memory and imported states are dropped, the images behind them must not be in use anymore
+    void Cleanup(VkDevice device, VmaAllocator allocator);
+
+private:
+    struct ImageAccess
+    {
+        RenderGraphResource resource;
+        RenderGraphUsage usage;
+        VkPipelineStageFlags2 stages;
+        bool write;
+        bool discard;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::function<void(VkCommandBuffer)> execute;
+        std::vector<ImageAccess> accesses;
+        bool sideEffects = false;
+        bool culled = false;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool imported = true;
+        bool kept = false;
+        RenderGraphImageDesc desc;
+        // Transient only: execution range and memory slot
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        uint32_t slot = UINT32_MAX;
+    };
+
+    struct TransientImage
+    {
+        std::string name;
+        RenderGraphImageDesc desc;
+        uint32_t slot = UINT32_MAX;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    struct MemorySlot
+    {
+        VkMemoryRequirements requirements{};
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        // Synchronization of whichever image used the memory last, each new one starts UNDEFINED
+        RenderGraphImageState state;
+    };
+
+    static void GetUsageInfo(RenderGraphUsage usage, bool write, bool discard, VkPipelineStageFlags2 stages, VkImageLayout& layout, VkPipelineStageFlags2& outStages, VkAccessFlags2& access);
+
+    static VkImageCreateInfo GetImageCreateInfo(const RenderGraphImageDesc& desc);
+
+    void CullPasses();
+
+    void PlaceTransientImages(VkDevice device, VmaAllocator allocator, DeletionQueue& deletionQueue, uint64_t frame);
+
+    void DestroyTransientImages(VkDevice device, VmaAllocator allocator);
+
+    static void AddBarrier(const Resource& resource, const ImageAccess& access, RenderGraphImageState& state, std::vector<VkImageMemoryBarrier2>& barriers);
+
+    std::vector<Pass> m_Passes;
+    std::vector<Resource> m_Resources;
+    uint32_t m_CulledPassCount = 0;
+
+    std::unordered_map<VkImage, RenderGraphImageState> m_ImportedStates;
+
+    std::vector<TransientImage> m_TransientImages;
+    std::vector<MemorySlot> m_MemorySlots;
+    uint32_t m_PlacementVersion = 0;
+};
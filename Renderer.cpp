@@ -3,6 +3,8 @@
 #include "Renderer.h"
 #include "MeshLoader.h"
 #include <array>
+#include <thread>
+#include <filesystem>
 
 #undef CreateWindow
 
@@ -82,21 +84,38 @@ static void scrollCallback(GLFWwindow* window, double xoffset, double yoffset)
     ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
 }
 
-Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersion, const std::string& EngineName, uint32_t EngineVersion, int width, int height)
+Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersion, const std::string& EngineName, uint32_t EngineVersion, int width, int height, const HeadlessSettings& headless, const BenchmarkSettings& benchmark)
 {
+    CPU_ZONE("Renderer::Renderer");
+
+    m_Headless = headless;
+    m_Benchmark = benchmark;
+
+    // Warm up frames hold the first keyframe, the last measured frame lands on the last one
+    if (!m_Benchmark.cameraPath.empty() && m_CameraPath.Load(m_Benchmark.cameraPath))
+        m_BenchmarkFrameCount = m_Benchmark.warmupFrames + static_cast<uint64_t>(std::ceil(m_CameraPath.GetDuration() / SCRIPTED_TIME_STEP)) + 1;
+
     InitKeyPressedMap();
 
-    CreateWindow(ApplicationName, width, height);
-    glfwSetWindowUserPointer(m_Window.getWindow(), this);
-    glfwSetFramebufferSizeCallback(m_Window.getWindow(), framebufferResizeCallback);
-    glfwSetCursorPosCallback(m_Window.getWindow(), cursorPosCallback);
-    glfwSetKeyCallback(m_Window.getWindow(), keyCallback);
-    glfwSetMouseButtonCallback(m_Window.getWindow(), mouseButtonCallback);
-    glfwSetScrollCallback(m_Window.getWindow(), scrollCallback);
+    if (!m_Headless.enabled)
+    {
+        CreateWindow(ApplicationName, width, height);
+        glfwSetWindowUserPointer(m_Window.getWindow(), this);
+        glfwSetFramebufferSizeCallback(m_Window.getWindow(), framebufferResizeCallback);
+        glfwSetCursorPosCallback(m_Window.getWindow(), cursorPosCallback);
+        glfwSetKeyCallback(m_Window.getWindow(), keyCallback);
+        glfwSetMouseButtonCallback(m_Window.getWindow(), mouseButtonCallback);
+        glfwSetScrollCallback(m_Window.getWindow(), scrollCallback);
+
+        // Scanout period the input to photon estimate is built on, 60 Hz when the monitor does not tell
+        const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        m_RefreshRate = videoMode && videoMode->refreshRate > 0 ? videoMode->refreshRate : 60;
+    }
 
     CreateInstance(ApplicationName, ApplicationVersion, EngineName, EngineVersion);
 
-    CreateSurface();
+    if (!m_Headless.enabled)
+        CreateSurface();
 
     SelectPhysicalDevice();
 
@@ -106,24 +125,23 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
 
     CreateVmaAllocator();
 
-    m_SwapChain.BuildSwapChain(m_PhysicalDevice, m_Allocator, m_Device, m_Surface, m_Window.getWindow(), m_QueueFamilyIndices);
-
-    CreateDepthRessources();
+    if (m_Headless.enabled)
+        m_SwapChain.BuildOffscreen(m_Allocator, m_Device, { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }, m_QueueFamilyIndices);
+    else
+        m_SwapChain.BuildSwapChain(m_PhysicalDevice, m_Allocator, m_Device, m_Surface, m_Window.getWindow(), m_QueueFamilyIndices);
 
-    CreateRenderPass();
+    SelectDepthFormat();
 
     auto extent = m_SwapChain.GetExtent();
 
     m_GBuffer.BuildGBuffer(MAX_FRAMES_IN_FLIGHT, extent.width, extent.height, m_Allocator, m_Device, { m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value()});
-
-    m_SwapChain.CreateFramebuffer(m_Device, m_RenderPass.getRenderPass(), m_FinalRenderPass.getRenderPass(), m_GBuffer, m_DepthImage.GetImageView());
     
     auto meshes = MeshLoader::loadGltf("./Models/GLTF/DamagedHelmet/glTF/DamagedHelmet.gltf", m_Materials);
 
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         mesh->SetModel(glm::translate(glm::mat4(1.f), glm::vec3(20., 0., 0.)));
         m_Meshes.push_back(mesh);
     }
@@ -135,8 +153,8 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
 
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         mesh->SetModel(glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(5., 5., 5.)), glm::vec3(0.2f)));
         mesh->SetOccluder(false);
         m_Meshes.push_back(mesh);
@@ -172,8 +190,8 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
 
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         mesh->SetModel(glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(-7., 1., 0.)), glm::vec3(7.)));
         m_Meshes.push_back(mesh);
     }
@@ -183,8 +201,8 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
 
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         mesh->SetModel(glm::translate(glm::mat4(1.f), glm::vec3(50., 0., 20.)));
         m_Meshes.push_back(mesh);
     }
@@ -194,8 +212,8 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
 
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         mesh->SetModel(glm::translate(mesh->GetModel(), glm::vec3(10., 0., -3.)));
         m_Meshes.push_back(mesh);
     }
@@ -204,8 +222,8 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
     meshes = MeshLoader::loadGltf("./Models/GLTF/Plane/TwoSidedPlane.gltf", m_Materials);
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(0.f, -7.f, 0.f));
         model = glm::scale(model, glm::vec3(50.f));
         mesh->SetModel(model);
@@ -213,12 +231,41 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
     }
     meshes.clear();
 
+    // Copies are made before any buffer exists, every instance owns its skinned vertices and BLAS
+    meshes = MeshLoader::loadGltf(ANIMATED_CHARACTER_PATH, m_Materials);
+
+    std::vector<Mesh*> characters;
+    for (uint32_t i = 0; i < ANIMATED_CHARACTER_COUNT; i++)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(-30.f + 2.f * (i % 8), -7.f, -10.f - 2.f * (i / 8)));
+
+        for (auto mesh : meshes)
+        {
+            Mesh* character = new Mesh(*mesh);
+            character->SetModel(model);
+            character->SetAnimationTimeOffset(0.37f * i);
+            characters.push_back(character);
+        }
+    }
+
+    for (auto mesh : meshes)
+        delete mesh;
+    meshes.clear();
+
+    for (auto mesh : characters)
+    {
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateSkinningBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        m_Meshes.push_back(mesh);
+    }
+
     meshes = MeshLoader::loadGltf("./Models/GLTF/BoomBox_Axis/BoomBoxWithAxes.gltf", m_Materials);
 
     for (auto mesh : meshes)
     {
-        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
-        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+        mesh->CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
+        mesh->CreateIndexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), m_RayTracingSupported);
         //glm::translate(glm::rotate(glm::mat4(1.0), glm::radians(-90.f), glm::vec3(1., 0., 0.)), glm::vec3(35., 0., 20.)));
         mesh->SetModel(glm::scale(mesh->GetModel(), glm::vec3(100.)));
         m_Meshes.push_back(mesh);
@@ -227,6 +274,9 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
 
     m_DirectionalLights.emplace_back(glm::vec3(-0.1f, -1.f, 0.1f), glm::vec3(1.), 1.f);
 
+    if (!m_RayTracingSupported)
+        m_DirectionalLights[0].SetShadowTechnique(SHADOW_MAP);
+
     CreateQuadMesh();
 
     m_Materials.CreateTexures(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_GraphicPool, m_GraphicsQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
@@ -235,6 +285,20 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
     
     CreatePerMeshDescriptor();
 
+    if (m_MeshShaderSupported)
+    {
+        for (auto mesh : m_Meshes)
+            mesh->CreateMeshletBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value());
+
+        CreateMeshletDescriptor();
+
+        m_MeshShading = m_MeshletCount > 0;
+    }
+
+    m_Skinning = new Skinning(m_Device, m_Allocator, m_Meshes, MAX_FRAMES_IN_FLIGHT);
+
+    m_CascadedShadowMap = new CascadedShadowMap(m_PhysicalDevice, m_Device, m_Allocator, m_QueueFamilyIndices.graphicsFamily.value(), SHADOW_MAP_RESOLUTION, m_PerMeshDescriptor.GetDescriptorSetLayout());
+
     CreatePerPassDescriptor();
 
     CreateGBufferDescriptor();
@@ -252,12 +316,36 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
     std::vector<VkImageView> ImageViews;
     m_SwapChain.GetImageViews(ImageViews);
     
-    m_RayTracingAccelerationStructure = new RayTracingAccelerationStructure(m_Device, m_PhysicalDevice, m_Allocator, m_ComputeQueue, m_ComputePool, m_Meshes, ImageViews, {m_GBufferDescriptor.GetDescriptorSetLayout(), m_PerPassDescriptor.GetDescriptorSetLayout()}); 
+    // Built once, a coarser level is kept only where its error goes unnoticed from any distance
+    for (Mesh* mesh : m_Meshes)
+        mesh->SetAccelerationStructureLod(mesh->FindLod(RAY_TRACING_LOD_ERROR));
+
+    if (m_RayTracingSupported)
+        m_RayTracingAccelerationStructure = new RayTracingAccelerationStructure(m_Device, m_PhysicalDevice, m_Allocator, m_ComputeQueue, m_ComputePool, { m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value() }, m_Meshes, ImageViews, {m_GBufferDescriptor.GetDescriptorSetLayout(), m_PerPassDescriptor.GetDescriptorSetLayout()}); 
+
+    std::vector<VkAccelerationStructureKHR> topLevelASs;
+    if (m_RayQuerySupported)
+        topLevelASs = m_RayTracingAccelerationStructure->GetTopLevelASs();
+
+    m_ComputeLighting = new ComputeLighting(m_Device, ImageViews, {m_GBufferDescriptor.GetDescriptorSetLayout(), m_PerPassDescriptor.GetDescriptorSetLayout()}, topLevelASs);
+
+    m_GpuProfiler.Create(m_PhysicalDevice, m_Device, MAX_FRAMES_IN_FLIGHT, MAX_GPU_TIMER_SCOPES);
+
+    CreateComputeCommandBuffers();
+
+    // Nothing to overlap without animated meshes or acceleration structures
+    m_AsyncCompute = m_Skinning->HasSkinnedMeshes() || m_RayTracingAccelerationStructure;
 
     m_Camera = new QuaternionCamera(glm::vec3(0., 1., 5.), glm::vec3(0., 0., 0.), glm::vec3(0., 1., 0.), 77., extent.width / static_cast<double>(extent.height),  1e-3, 100000.0);
     m_Camera->SetSpeed(15.);
     m_Camera->SetMouseSensibility(5.);
 
+    if (m_Headless.enabled)
+    {
+        CreateCaptureBuffers();
+        return;
+    }
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -292,8 +380,10 @@ Renderer::Renderer(const std::string& ApplicationName, uint32_t ApplicationVersi
     init_info.Queue = m_GraphicsQueue;
     init_info.PipelineCache = NULL;
     init_info.DescriptorPool = m_ImGuiDescriptorPool;
-    init_info.RenderPass = m_FinalRenderPass.getRenderPass();
-    init_info.Subpass = 0;
+    init_info.UseDynamicRendering = true;
+    init_info.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    init_info.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+    init_info.PipelineRenderingCreateInfo.pColorAttachmentFormats = &m_SwapChain.GetSurfaceFormat();
     init_info.MinImageCount = static_cast<uint32_t>(m_SwapChain.GetFinalImageViews().size());
     init_info.ImageCount = static_cast<uint32_t>(m_SwapChain.GetFinalImageViews().size());
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
@@ -309,6 +399,26 @@ Renderer::~Renderer()
     delete m_Camera;
 
     vkQueueWaitIdle(m_GraphicsQueue);
+    vkQueueWaitIdle(m_ComputeQueue);
+
+    if (IsBenchmarking() && m_Device != VK_NULL_HANDLE)
+        FinishBenchmark();
+
+    if (m_Headless.enabled && m_Device != VK_NULL_HANDLE)
+    {
+        UpdateCompletedFrames();
+        WriteCompletedCaptures();
+
+        for (StorageBuffer& captureBuffer : m_CaptureBuffers)
+            vmaDestroyBuffer(m_Allocator, captureBuffer.buffer, captureBuffer.memory);
+        m_CaptureBuffers.clear();
+
+        // Machine readable timings of the run next to its captures
+        m_GpuProfiler.ExportJson(m_Headless.outputDirectory + "/gpu_profile.json");
+    }
+
+    // Resources retired by the last resizes, ImGui must still be alive for their textures
+    m_DeletionQueue.FlushAll();
 
     if (m_Device != VK_NULL_HANDLE && m_Allocator != VK_NULL_HANDLE && m_RayTracingAccelerationStructure)
     {
@@ -316,13 +426,36 @@ Renderer::~Renderer()
         delete m_RayTracingAccelerationStructure;
     }
 
+    if (m_Device != VK_NULL_HANDLE && m_ComputeLighting)
+    {
+        m_ComputeLighting->Cleanup(m_Device);
+        delete m_ComputeLighting;
+    }
+
+    if (m_Device != VK_NULL_HANDLE && m_Allocator != VK_NULL_HANDLE && m_CascadedShadowMap)
+    {
+        m_CascadedShadowMap->Cleanup(m_Device, m_Allocator);
+        delete m_CascadedShadowMap;
+    }
+
+    if (m_Device != VK_NULL_HANDLE && m_Allocator != VK_NULL_HANDLE && m_Skinning)
+    {
+        m_Skinning->Cleanup(m_Device, m_Allocator);
+        delete m_Skinning;
+    }
+
+    if (m_Device != VK_NULL_HANDLE)
+        m_GpuProfiler.Cleanup(m_Device);
+
     if (m_Device != VK_NULL_HANDLE)
     {
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(m_Device, m_RenderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(m_Device, m_ImageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(m_Device, m_InFlightFences[i], nullptr);
         }
+
+        vkDestroySemaphore(m_Device, m_GraphicsTimeline, nullptr);
+        vkDestroySemaphore(m_Device, m_ComputeTimeline, nullptr);
     }
 
     CleanupCommandBuffers();
@@ -354,7 +487,7 @@ Renderer::~Renderer()
     {
         m_PerMeshDescriptor.DestroyDescriptorPool(m_Device);
         m_PerMeshDescriptor.DestroyDescriptorSetLayout(m_Device);
-        m_PerMeshDescriptor.DestroyUniformBuffer(m_Allocator, m_Device);
+        m_FrameAllocator.Cleanup(m_Allocator);
 
         m_PerPassDescriptor.DestroyDescriptorPool(m_Device);
         m_PerPassDescriptor.DestroyDescriptorSetLayout(m_Device);
@@ -363,6 +496,9 @@ Renderer::~Renderer()
 
         m_Materials.Cleanup(m_Allocator, m_Device);
 
+        m_MeshletDescriptor.DestroyDescriptorPool(m_Device);
+        m_MeshletDescriptor.DestroyDescriptorSetLayout(m_Device);
+
         m_GBufferDescriptor.DestroyDescriptorPool(m_Device);
         m_GBufferDescriptor.DestroyDescriptorSetLayout(m_Device);
         m_GBufferDescriptor.DestroyUniformBuffer(m_Allocator, m_Device);
@@ -380,6 +516,12 @@ Renderer::~Renderer()
     if (m_Device != VK_NULL_HANDLE && m_GraphicPipelineFirstPassLayout != VK_NULL_HANDLE)
         vkDestroyPipelineLayout(m_Device, m_GraphicPipelineFirstPassLayout, NULL);
 
+    if (m_Device != VK_NULL_HANDLE && m_GraphicPipelineMeshShading != VK_NULL_HANDLE)
+        vkDestroyPipeline(m_Device, m_GraphicPipelineMeshShading, NULL);
+
+    if (m_Device != VK_NULL_HANDLE && m_GraphicPipelineMeshShadingLayout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(m_Device, m_GraphicPipelineMeshShadingLayout, NULL);
+
     if (m_Device != VK_NULL_HANDLE && m_GraphicPipelineSecondPass != VK_NULL_HANDLE)
         vkDestroyPipeline(m_Device, m_GraphicPipelineSecondPass, NULL);
 
@@ -393,23 +535,20 @@ Renderer::~Renderer()
         vkDestroyPipeline(m_Device, m_GraphicPipelineCubeMap, NULL);
 
     if (m_Device != VK_NULL_HANDLE)
-        m_RenderPass.cleanup(m_Device);
-
-    if (m_Device != VK_NULL_HANDLE)
-        m_FinalRenderPass.cleanup(m_Device);
-
-    if (m_Device != VK_NULL_HANDLE)
-        m_DepthImage.Cleanup(m_Allocator, m_Device);
+        m_RenderGraph.Cleanup(m_Device, m_Allocator);
 
     if (m_Device != VK_NULL_HANDLE)
         m_SwapChain.Cleanup(m_Device, m_Allocator);
 
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (!m_Headless.enabled)
+    {
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
 
-    if (m_Device)
-        vkDestroyDescriptorPool(m_Device, m_ImGuiDescriptorPool, NULL);
+        if (m_Device)
+            vkDestroyDescriptorPool(m_Device, m_ImGuiDescriptorPool, NULL);
+    }
 
     vmaDestroyAllocator(m_Allocator);
 
@@ -422,7 +561,8 @@ Renderer::~Renderer()
     if (m_Instance != VK_NULL_HANDLE)
         vkDestroyInstance(m_Instance, NULL);
 
-    m_Window.destroyWindow();
+    if (!m_Headless.enabled)
+        m_Window.destroyWindow();
     m_Window.terminateGlfw();
 }
 
@@ -443,8 +583,11 @@ void Renderer::CreateInstance(const std::string& ApplicationName, uint32_t Appli
     vkApplicationInfo.engineVersion = EngineVersion;
     vkApplicationInfo.apiVersion = VK_API_VERSION_1_3;
 
-    uint32_t extensionsCount;
-    auto extensionsNames = m_Window.getRequiredInstanceExtesions(extensionsCount);
+    // Surface extensions only, offscreen needs none
+    uint32_t extensionsCount = 0;
+    const char** extensionsNames = NULL;
+    if (!m_Headless.enabled)
+        extensionsNames = m_Window.getRequiredInstanceExtesions(extensionsCount);
 
     uint32_t propertyCount;
     vkEnumerateInstanceLayerProperties(&propertyCount, NULL);
@@ -517,7 +660,33 @@ void Renderer::SelectPhysicalDevice()
 
     if (m_PhysicalDevice == VK_NULL_HANDLE) {
         std::cout << "No GPU can run this program!" << '\n';
+        return;
+    }
+
+    // Limits are read by per frame code, query them once
+    vkGetPhysicalDeviceProperties(m_PhysicalDevice, &m_PhysicalDeviceProperties);
+
+    m_RayTracingSupported = checkRayTracingSupport(m_PhysicalDevice);
+
+    if (m_RayTracingSupported)
+    {
+        m_LightingPath = LIGHTING_RAY_TRACING;
+        m_LightingShaderStages |= VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+        m_LightingPipelineStages |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+    }
+    else
+    {
+        std::cout << "Ray tracing not supported, lighting uses the compute path" << '\n';
     }
+
+    m_RayQuerySupported = m_RayTracingSupported && checkRayQuerySupport(m_PhysicalDevice);
+
+    m_MeshShaderSupported = checkMeshShaderSupport(m_PhysicalDevice);
+
+    if (m_MeshShaderSupported)
+        m_MeshShaderStages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    else
+        std::cout << "Mesh shaders not supported, the G-buffer uses the vertex pipeline" << '\n';
 }
 
 void Renderer::CreateVmaAllocator()
@@ -591,8 +760,12 @@ void Renderer::FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
             queueFamilyIndices.transferFamily = i;
         }
 
+        // Offscreen never presents, the present queue is the graphics one
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE)
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        else
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
 
         if (presentSupport) {
             queueFamilyIndices.presentFamily = i;
@@ -605,6 +778,20 @@ void Renderer::FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
         i++;
     }
 
+    // Single family devices (integrated GPUs, software rasterizers) transfer on the graphics queue
+    if (!queueFamilyIndices.transferFamily.has_value())
+        queueFamilyIndices.transferFamily = queueFamilyIndices.graphicsFamily;
+
+    // A compute family without graphics runs on its own hardware queue, prefer it so compute work overlaps rendering
+    for (uint32_t j = 0; j < queueFamilyCount; j++)
+    {
+        if ((queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            queueFamilyIndices.computeFamily = j;
+            break;
+        }
+    }
+
     m_QueueFamilyIndices = queueFamilyIndices;
 }
 
@@ -643,16 +830,70 @@ void Renderer::CreateLogicalDevice()
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures = {};
     rayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
     rayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;  // Enable ray tracing pipeline
+
+    VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures = {};
+    rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+    rayQueryFeatures.rayQuery = VK_TRUE;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
     
     // Enable buffer device address feature as well
     VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures = {};
     bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
     bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
 
+    // Frame pacing and the async compute hand-offs are timeline semaphores
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+    // The GPU profiler resets its timestamp queries from the host, once for the graphics and the async compute submits
+    VkPhysicalDeviceHostQueryResetFeatures hostQueryResetFeatures = {};
+    hostQueryResetFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
+    hostQueryResetFeatures.hostQueryReset = VK_TRUE;
+    hostQueryResetFeatures.pNext = &bufferDeviceAddressFeatures;
+    timelineSemaphoreFeatures.pNext = &hostQueryResetFeatures;
+
+    // vkCmdPipelineBarrier2 for the render graph barriers
+    VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+    vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features.synchronization2 = VK_TRUE;
+    vulkan13Features.dynamicRendering = VK_TRUE;
+
     // Link the feature structures in the pNext chain
-    deviceFeatures.pNext = &bufferDeviceAddressFeatures;
-    bufferDeviceAddressFeatures.pNext = &rayTracingPipelineFeatures;
-    rayTracingPipelineFeatures.pNext = &accelerationStructureFeatures;
+    deviceFeatures.pNext = &vulkan13Features;
+    vulkan13Features.pNext = &timelineSemaphoreFeatures;
+
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+
+    if (!m_Headless.enabled)
+        enabledExtensions.insert(enabledExtensions.end(), presentDeviceExtensions.begin(), presentDeviceExtensions.end());
+
+    if (m_RayTracingSupported)
+    {
+        bufferDeviceAddressFeatures.pNext = &rayTracingPipelineFeatures;
+        rayTracingPipelineFeatures.pNext = &accelerationStructureFeatures;
+
+        enabledExtensions.insert(enabledExtensions.end(), rayTracingDeviceExtensions.begin(), rayTracingDeviceExtensions.end());
+    }
+
+    if (m_RayQuerySupported)
+    {
+        accelerationStructureFeatures.pNext = &rayQueryFeatures;
+
+        enabledExtensions.insert(enabledExtensions.end(), rayQueryDeviceExtensions.begin(), rayQueryDeviceExtensions.end());
+    }
+
+    if (m_MeshShaderSupported)
+    {
+        meshShaderFeatures.pNext = deviceFeatures.pNext;
+        deviceFeatures.pNext = &meshShaderFeatures;
+
+        enabledExtensions.insert(enabledExtensions.end(), meshShaderDeviceExtensions.begin(), meshShaderDeviceExtensions.end());
+    }
     
     VkDeviceCreateInfo vkDeviceCreateInfo{};
     vkDeviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -662,14 +903,17 @@ void Renderer::CreateLogicalDevice()
     vkDeviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     vkDeviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(enabledLayers.size());
     vkDeviceCreateInfo.ppEnabledLayerNames = enabledLayers.data();
-    vkDeviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    vkDeviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    vkDeviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    vkDeviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (vkCreateDevice(m_PhysicalDevice, &vkDeviceCreateInfo, NULL, &m_Device) != VK_SUCCESS)
     {
         std::cout << "Logical device creation failed !" << '\n';
     }
 
+    if (m_MeshShaderSupported)
+        vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(m_Device, "vkCmdDrawMeshTasksEXT"));
+
     vkGetDeviceQueue(m_Device, m_QueueFamilyIndices.graphicsFamily.value(), 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_Device, m_QueueFamilyIndices.presentFamily.value(), 0, &m_PresentQueue);
     vkGetDeviceQueue(m_Device, m_QueueFamilyIndices.transferFamily.value(), 0, &m_TranferQueue);
@@ -694,284 +938,198 @@ void Renderer::CreateLogicalDevice()
     }
 }
 
-void Renderer::CreateDepthRessources()
-{
-    VkFormat depthStencilFormat = Image::findDepthFormat(m_PhysicalDevice);
-
-    m_DepthImage.CreateImage(m_Allocator, m_SwapChain.GetExtent().width, m_SwapChain.GetExtent().height,
-        depthStencilFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, { m_QueueFamilyIndices.graphicsFamily.value() });
-    m_DepthImage.CreateImageView(m_Device, depthStencilFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-}
-
-void Renderer::CreateRenderPass()
+void Renderer::SelectDepthFormat()
 {
-    VkAttachmentDescription posAttachmentDescription;
-    posAttachmentDescription.flags = 0;
-    posAttachmentDescription.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    posAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    posAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    posAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    posAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    posAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    posAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    posAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentDescription normalAttachmentDescription;
-    normalAttachmentDescription.flags = 0;
-    normalAttachmentDescription.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    normalAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    normalAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    normalAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    normalAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    normalAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    normalAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    normalAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentDescription colorAttachmentDescription;
-    colorAttachmentDescription.flags = 0;
-    colorAttachmentDescription.format = VK_FORMAT_R8G8B8A8_UNORM;
-    colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentDescription pbrAttachmentDescription;
-    pbrAttachmentDescription.flags = 0;
-    pbrAttachmentDescription.format = VK_FORMAT_R8G8B8A8_UNORM;
-    pbrAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    pbrAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    pbrAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    pbrAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    pbrAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    pbrAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    pbrAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentDescription emissiveAttachmentDescription;
-    emissiveAttachmentDescription.flags = 0;
-    emissiveAttachmentDescription.format = VK_FORMAT_R8G8B8A8_UNORM;
-    emissiveAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    emissiveAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    emissiveAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    emissiveAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    emissiveAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    emissiveAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    emissiveAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentDescription depthAttachmentDescription;
-    depthAttachmentDescription.flags = 0;
-    depthAttachmentDescription.format = Image::findDepthFormat(m_PhysicalDevice);
-    depthAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference posGBufferReference{};
-    posGBufferReference.attachment = 0;
-    posGBufferReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference normalGBufferReference{};
-    normalGBufferReference.attachment = 1;
-    normalGBufferReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorGBufferReference{};
-    colorGBufferReference.attachment = 2;
-    colorGBufferReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference pbrGBufferReference{};
-    pbrGBufferReference.attachment = 3;
-    pbrGBufferReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference emissiveGBufferReference{};
-    emissiveGBufferReference.attachment = 4;
-    emissiveGBufferReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthAttachmentRef{};
-    depthAttachmentRef.attachment = 5;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    /*
-    VkAttachmentDescription attachmentDescription;
-    attachmentDescription.flags = 0;
-    attachmentDescription.format = m_SwapChain.GetSurfaceFormat();
-    attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-    VkAttachmentReference attachmentReference;
-    attachmentReference.attachment = 6;
-    attachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    */
-
-    m_RenderPass.addSubPass(VK_PIPELINE_BIND_POINT_GRAPHICS, {}, { posGBufferReference, normalGBufferReference, colorGBufferReference, pbrGBufferReference, emissiveGBufferReference }, {}, { depthAttachmentRef }, { } );
-
-    m_RenderPass.addSubPassDependency(VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_DEPENDENCY_BY_REGION_BIT);
-
-    m_RenderPass.addSubPassDependency(0, VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_DEPENDENCY_BY_REGION_BIT);
-
-    /*
-    VkAttachmentReference inPosGBufferReference{};
-    inPosGBufferReference.attachment = 0;
-    inPosGBufferReference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference inNormalGBufferReference{};
-    inNormalGBufferReference.attachment = 1;
-    inNormalGBufferReference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference inColorGBufferReference{};
-    inColorGBufferReference.attachment = 2;
-    inColorGBufferReference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference inPbrGBufferReference{};
-    inPbrGBufferReference.attachment = 3;
-    inPbrGBufferReference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference inEmissiveGBufferReference{};
-    inEmissiveGBufferReference.attachment = 4;
-    inEmissiveGBufferReference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    m_RenderPass.addSubPass(VK_PIPELINE_BIND_POINT_GRAPHICS, { inPosGBufferReference, inNormalGBufferReference, inColorGBufferReference, inPbrGBufferReference, inEmissiveGBufferReference }, { attachmentReference }, {}, {}, {});
-
-    m_RenderPass.addSubPassDependency(0, 1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_DEPENDENCY_BY_REGION_BIT);
+    m_DepthFormat = Image::findDepthFormat(m_PhysicalDevice);
 
-    m_RenderPass.addSubPassDependency(1, VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_DEPENDENCY_BY_REGION_BIT);
-*/
-
-    
-    m_RenderPass.CreateRenderPass(m_Device, { posAttachmentDescription, normalAttachmentDescription, colorAttachmentDescription, pbrAttachmentDescription, emissiveAttachmentDescription, depthAttachmentDescription }); //, attachmentDescription });
-    
-    VkAttachmentDescription finalAttachmentDescription;
-    finalAttachmentDescription.flags = 0;
-    finalAttachmentDescription.format = m_SwapChain.GetSurfaceFormat();
-    finalAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    finalAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    finalAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    finalAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    finalAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    finalAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    finalAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference finalAttachmentReference;
-    finalAttachmentReference.attachment = 0;
-    finalAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    m_FinalRenderPass.addSubPass(VK_PIPELINE_BIND_POINT_GRAPHICS, {}, { finalAttachmentReference }, {}, {}, {});
-
-    m_FinalRenderPass.CreateRenderPass(m_Device, { finalAttachmentDescription });
+    // Without separate depth/stencil layouts a combined format is transitioned with both aspects
+    m_DepthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (m_DepthFormat != VK_FORMAT_D32_SFLOAT)
+        m_DepthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
 }
 
 void Renderer::CreatePerMeshDescriptor()
 {
     uint32_t numMesh = static_cast<uint32_t>(m_Meshes.size());
 
+    // Every model matrix of the frame in one array indexed by the instance index, the dynamic offset selects the frame's allocation
     VkDescriptorSetLayoutBinding descriptorSetLayoutBinding;
     descriptorSetLayoutBinding.binding = 0;
-    descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     descriptorSetLayoutBinding.descriptorCount = 1;
-    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | m_MeshShaderStages;
     descriptorSetLayoutBinding.pImmutableSamplers = NULL;
 
     m_PerMeshDescriptor.CreateDescriptorSetLayout(m_Device, { descriptorSetLayoutBinding }, 0);
 
     if (numMesh > 0)
     {
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
-        VkDeviceSize minSize = properties.limits.minUniformBufferOffsetAlignment;
+        VkDeviceSize modelsSize = numMesh * sizeof(glm::mat4);
+
+        m_FrameAllocator.Create(m_Allocator, modelsSize, MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_PhysicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+
+        VkDescriptorPoolSize descriptorPoolSize;
+        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        descriptorPoolSize.descriptorCount = 1;
+
+        m_PerMeshDescriptor.CreateDescriptorPool(m_Device, { descriptorPoolSize }, 1);
+
+        m_PerMeshDescriptor.AllocateDescriptorSet(m_Device, { m_PerMeshDescriptor.GetDescriptorSetLayout() });
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = m_FrameAllocator.GetBuffer();
+        bufferInfo.offset = 0;
+        bufferInfo.range = modelsSize;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = m_PerMeshDescriptor.GetDescriptorSets()[0];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+        descriptorWrite.pImageInfo = nullptr; // Optional
+        descriptorWrite.pTexelBufferView = nullptr; // Optional
+
+        vkUpdateDescriptorSets(m_Device, 1, &descriptorWrite, 0, nullptr);
+    }
+}
+void Renderer::CreateMeshletDescriptor()
+{
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings(3);
+
+    // Vertices and meshlet data are only read by the mesh shader, the meshlets by both stages
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        layoutBindings[i].binding = i;
+        layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[i].descriptorCount = 1;
+        layoutBindings[i].stageFlags = i == 1 ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_MESH_BIT_EXT;
+        layoutBindings[i].pImmutableSamplers = NULL;
+    }
+
+    m_MeshletDescriptor.CreateDescriptorSetLayout(m_Device, layoutBindings, 0);
 
-        uint64_t bufferSize = sizeof(glm::mat4);
-        uint64_t paddedSize = (bufferSize + minSize - 1) & ~(minSize - 1);
+    m_MeshletDescriptorIndices.assign(m_Meshes.size(), -1);
+    m_MeshletCount = 0;
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    uint32_t setCount = 0;
+    for (size_t i = 0; i < m_Meshes.size(); i++)
+    {
+        if (!m_Meshes[i]->IsSkinned() && m_Meshes[i]->GetMeshletBuffer() != VK_NULL_HANDLE)
         {
-            m_PerMeshDescriptor.AddUniformBuffer(m_Allocator, m_Meshes.size() * paddedSize);
+            m_MeshletDescriptorIndices[i] = static_cast<int32_t>(setCount++);
+            m_MeshletCount += static_cast<uint32_t>(m_Meshes[i]->GetMeshlets().size());
         }
+    }
 
-        VkDescriptorPoolSize descriptorPoolSize;
-        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        descriptorPoolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    if (setCount == 0)
+        return;
+
+    VkDescriptorPoolSize descriptorPoolSize;
+    descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorPoolSize.descriptorCount = 3 * setCount;
 
-        m_PerMeshDescriptor.CreateDescriptorPool(m_Device, { descriptorPoolSize }, MAX_FRAMES_IN_FLIGHT);
+    m_MeshletDescriptor.CreateDescriptorPool(m_Device, { descriptorPoolSize }, setCount);
 
-        VkDescriptorSetLayout layout = m_PerMeshDescriptor.GetDescriptorSetLayout();
-        std::vector<VkDescriptorSetLayout> layouts;
-        layouts.assign(MAX_FRAMES_IN_FLIGHT, layout);
+    std::vector<VkDescriptorSetLayout> layouts;
+    layouts.assign(setCount, m_MeshletDescriptor.GetDescriptorSetLayout());
 
-        m_PerMeshDescriptor.AllocateDescriptorSet(m_Device, layouts);
+    m_MeshletDescriptor.AllocateDescriptorSet(m_Device, layouts);
 
-        auto uniformBuffers = m_PerMeshDescriptor.GetUniformBuffers();
-        auto descriptorSets = m_PerMeshDescriptor.GetDescriptorSets();
+    const std::vector<VkDescriptorSet>& descriptorSets = m_MeshletDescriptor.GetDescriptorSets();
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < m_Meshes.size(); i++)
+    {
+        if (m_MeshletDescriptorIndices[i] < 0)
+            continue;
+
+        Mesh* mesh = m_Meshes[i];
+
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+        bufferInfos[0].buffer = mesh->GetVertexBuffer();
+        bufferInfos[0].offset = 0;
+        bufferInfos[0].range = VK_WHOLE_SIZE;
+        bufferInfos[1].buffer = mesh->GetMeshletBuffer();
+        bufferInfos[1].offset = 0;
+        bufferInfos[1].range = VK_WHOLE_SIZE;
+        bufferInfos[2].buffer = mesh->GetMeshletDataBuffer();
+        bufferInfos[2].offset = 0;
+        bufferInfos[2].range = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        for (uint32_t binding = 0; binding < 3; binding++)
         {
-            for (size_t j = 0; j < m_Meshes.size(); j++)
-            {
-                VkDescriptorBufferInfo bufferInfo{};
-                bufferInfo.buffer = uniformBuffers[i];
-                bufferInfo.offset = 0;
-                bufferInfo.range = paddedSize;
-
-                VkWriteDescriptorSet descriptorWrite{};
-                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrite.dstSet = descriptorSets[i];
-                descriptorWrite.dstBinding = 0;
-                descriptorWrite.dstArrayElement = 0;
-                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-                descriptorWrite.descriptorCount = 1;
-                descriptorWrite.pBufferInfo = &bufferInfo;
-                descriptorWrite.pImageInfo = nullptr; // Optional
-                descriptorWrite.pTexelBufferView = nullptr; // Optional
-
-                vkUpdateDescriptorSets(m_Device, 1, &descriptorWrite, 0, nullptr);
-            }
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = descriptorSets[m_MeshletDescriptorIndices[i]];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
         }
+
+        vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, NULL);
     }
 }
 
 void Renderer::CreateGBufferDescriptor()
 {
     std::vector<VkDescriptorSetLayoutBinding> attachmentLayoutBinding;
-    attachmentLayoutBinding.resize(1);
+    attachmentLayoutBinding.resize(4);
 
     attachmentLayoutBinding[0].binding = 0;
     attachmentLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    attachmentLayoutBinding[0].descriptorCount = 5;
+    attachmentLayoutBinding[0].descriptorCount = 6;
     attachmentLayoutBinding[0].pImmutableSamplers = NULL;
-    attachmentLayoutBinding[0].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    attachmentLayoutBinding[0].stageFlags = m_LightingShaderStages;
+
+    // Shadow history written this frame
+    attachmentLayoutBinding[1].binding = 1;
+    attachmentLayoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    attachmentLayoutBinding[1].descriptorCount = 1;
+    attachmentLayoutBinding[1].pImmutableSamplers = NULL;
+    attachmentLayoutBinding[1].stageFlags = m_LightingShaderStages;
+
+    // Shadow history of the previous frame
+    attachmentLayoutBinding[2].binding = 2;
+    attachmentLayoutBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    attachmentLayoutBinding[2].descriptorCount = 1;
+    attachmentLayoutBinding[2].pImmutableSamplers = NULL;
+    attachmentLayoutBinding[2].stageFlags = m_LightingShaderStages;
+
+    // Position and normal of the previous frame, used to reject the history
+    attachmentLayoutBinding[3].binding = 3;
+    attachmentLayoutBinding[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    attachmentLayoutBinding[3].descriptorCount = 2;
+    attachmentLayoutBinding[3].pImmutableSamplers = NULL;
+    attachmentLayoutBinding[3].stageFlags = m_LightingShaderStages;
 
     /*
     attachmentLayoutBinding[1].binding = 1;
     attachmentLayoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
     attachmentLayoutBinding[1].descriptorCount = 1;
     attachmentLayoutBinding[1].pImmutableSamplers = NULL;
-    attachmentLayoutBinding[1].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    attachmentLayoutBinding[1].stageFlags = m_LightingShaderStages;
 
     attachmentLayoutBinding[2].binding = 2;
     attachmentLayoutBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
     attachmentLayoutBinding[2].descriptorCount = 1;
     attachmentLayoutBinding[2].pImmutableSamplers = NULL;
-    attachmentLayoutBinding[2].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    attachmentLayoutBinding[2].stageFlags = m_LightingShaderStages;
 
     attachmentLayoutBinding[3].binding = 3;
     attachmentLayoutBinding[3].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
     attachmentLayoutBinding[3].descriptorCount = 1;
     attachmentLayoutBinding[3].pImmutableSamplers = NULL;
-    attachmentLayoutBinding[3].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    attachmentLayoutBinding[3].stageFlags = m_LightingShaderStages;
 
     attachmentLayoutBinding[4].binding = 4;
     attachmentLayoutBinding[4].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
     attachmentLayoutBinding[4].descriptorCount = 1;
     attachmentLayoutBinding[4].pImmutableSamplers = NULL;
-    attachmentLayoutBinding[4].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    attachmentLayoutBinding[4].stageFlags = m_LightingShaderStages;
     */
 
     auto GBufferImages = m_GBuffer.GetGBufferImages();
@@ -980,93 +1138,132 @@ void Renderer::CreateGBufferDescriptor()
 
     VkDescriptorPoolSize poolSize;
     poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize.descriptorCount = static_cast<uint32_t>(GBufferImages.size()) * 5;
+    poolSize.descriptorCount = static_cast<uint32_t>(GBufferImages.size()) * 8;
+
+    VkDescriptorPoolSize historyPoolSize;
+    historyPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    historyPoolSize.descriptorCount = static_cast<uint32_t>(GBufferImages.size()) * 2;
 
-    m_GBufferDescriptor.CreateDescriptorPool(m_Device, { poolSize }, static_cast<uint32_t>(GBufferImages.size()));
+    m_GBufferDescriptor.CreateDescriptorPool(m_Device, { poolSize, historyPoolSize }, static_cast<uint32_t>(GBufferImages.size()));
     
     std::vector<VkDescriptorSetLayout> layouts; 
     layouts.assign(GBufferImages.size(), m_GBufferDescriptor.GetDescriptorSetLayout());
 
     m_GBufferDescriptor.AllocateDescriptorSet(m_Device, layouts);
 
-    UpdateGBufferDescriptor();
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+        UpdateGBufferDescriptor(frame);
 }
 
-void Renderer::UpdateGBufferDescriptor()
+void Renderer::UpdateGBufferDescriptor(uint32_t frame)
 {
-    auto GBufferImages = m_GBuffer.GetGBufferImages();
-    auto descriptorSets = m_GBufferDescriptor.GetDescriptorSets();
-
-    for (size_t i = 0; i < GBufferImages.size(); i++)
-    {
-        VkDescriptorImageInfo posDescriptor{};
-        posDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        posDescriptor.imageView = GBufferImages[i].positionImageBuffer.GetImageView();
-        posDescriptor.sampler = GBufferImages[i].sampler;
-
-        VkDescriptorImageInfo normalDescriptor{};
-        normalDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        normalDescriptor.imageView = GBufferImages[i].normalImageBuffer.GetImageView();
-        normalDescriptor.sampler = GBufferImages[i].sampler;
-
-        VkDescriptorImageInfo colorDescriptor{};
-        colorDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        colorDescriptor.imageView = GBufferImages[i].colorImageBuffer.GetImageView();
-        colorDescriptor.sampler = GBufferImages[i].sampler;
-
-        VkDescriptorImageInfo pbrDescriptor{};
-        pbrDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        pbrDescriptor.imageView = GBufferImages[i].pbrImageBuffer.GetImageView();
-        pbrDescriptor.sampler = GBufferImages[i].sampler;
-
-        VkDescriptorImageInfo emissiveDescriptor{};
-        emissiveDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        emissiveDescriptor.imageView = GBufferImages[i].emissiveImageBuffer.GetImageView();
-        emissiveDescriptor.sampler = GBufferImages[i].sampler;
-
-        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].pImageInfo = &posDescriptor;
+    auto& GBufferImages = m_GBuffer.GetGBufferImages();
+    auto& descriptorSets = m_GBufferDescriptor.GetDescriptorSets();
+
+    VkDescriptorImageInfo posDescriptor{};
+    posDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    posDescriptor.imageView = GBufferImages[frame].positionImageBuffer.GetImageView();
+    posDescriptor.sampler = GBufferImages[frame].sampler;
+
+    VkDescriptorImageInfo normalDescriptor{};
+    normalDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    normalDescriptor.imageView = GBufferImages[frame].normalImageBuffer.GetImageView();
+    normalDescriptor.sampler = GBufferImages[frame].sampler;
+
+    std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = descriptorSets[frame];
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].pImageInfo = &posDescriptor;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = descriptorSets[frame];
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].dstBinding = 0;
+    descriptorWrites[1].dstArrayElement = 1;
+    descriptorWrites[1].pImageInfo = &normalDescriptor;
+
+    // Frames are recorded in order, so the previous frame always used the previous GBuffer
+    size_t previous = (frame + GBufferImages.size() - 1) % GBufferImages.size();
+
+    VkDescriptorImageInfo historyDescriptor{};
+    historyDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    historyDescriptor.imageView = GBufferImages[frame].shadowHistoryImageBuffer.GetImageView();
+    historyDescriptor.sampler = VK_NULL_HANDLE;
+
+    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[2].dstSet = descriptorSets[frame];
+    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[2].descriptorCount = 1;
+    descriptorWrites[2].dstBinding = 1;
+    descriptorWrites[2].dstArrayElement = 0;
+    descriptorWrites[2].pImageInfo = &historyDescriptor;
+
+    VkDescriptorImageInfo prevHistoryDescriptor{};
+    prevHistoryDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    prevHistoryDescriptor.imageView = GBufferImages[previous].shadowHistoryImageBuffer.GetImageView();
+    prevHistoryDescriptor.sampler = VK_NULL_HANDLE;
+
+    descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[3].dstSet = descriptorSets[frame];
+    descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[3].descriptorCount = 1;
+    descriptorWrites[3].dstBinding = 2;
+    descriptorWrites[3].dstArrayElement = 0;
+    descriptorWrites[3].pImageInfo = &prevHistoryDescriptor;
+
+    std::array<VkDescriptorImageInfo, 2> prevGBufferDescriptors{};
+    prevGBufferDescriptors[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    prevGBufferDescriptors[0].imageView = GBufferImages[previous].positionImageBuffer.GetImageView();
+    prevGBufferDescriptors[0].sampler = GBufferImages[previous].sampler;
+    prevGBufferDescriptors[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    prevGBufferDescriptors[1].imageView = GBufferImages[previous].normalImageBuffer.GetImageView();
+    prevGBufferDescriptors[1].sampler = GBufferImages[previous].sampler;
+
+    descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[4].dstSet = descriptorSets[frame];
+    descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[4].descriptorCount = static_cast<uint32_t>(prevGBufferDescriptors.size());
+    descriptorWrites[4].dstBinding = 3;
+    descriptorWrites[4].dstArrayElement = 0;
+    descriptorWrites[4].pImageInfo = prevGBufferDescriptors.data();
+
+    vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+    // The sampler may have been rebuilt, the transient views are written again on the next recording of the frame
+    m_GBufferTransientVersions[frame] = UINT32_MAX;
+}
 
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].dstBinding = 0;
-        descriptorWrites[1].dstArrayElement = 1;
-        descriptorWrites[1].pImageInfo = &normalDescriptor;
+void Renderer::UpdateGBufferTransientDescriptor(uint32_t frame, const std::array<RenderGraphResource, 4>& transientTargets)
+{
+    if (m_GBufferTransientVersions[frame] == m_RenderGraph.GetPlacementVersion())
+        return;
 
-        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[2].dstSet = descriptorSets[i];
-        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[2].descriptorCount = 1;
-        descriptorWrites[2].dstBinding = 0;
-        descriptorWrites[2].dstArrayElement = 2;
-        descriptorWrites[2].pImageInfo = &colorDescriptor;
+    std::array<VkDescriptorImageInfo, 4> transientDescriptors{};
+    for (size_t i = 0; i < transientDescriptors.size(); i++)
+    {
+        transientDescriptors[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        transientDescriptors[i].imageView = m_RenderGraph.GetImageView(transientTargets[i]);
+        transientDescriptors[i].sampler = m_GBuffer.GetGBufferImages()[frame].sampler;
+    }
 
-        descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[3].dstSet = descriptorSets[i];
-        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[3].descriptorCount = 1;
-        descriptorWrites[3].dstBinding = 0;
-        descriptorWrites[3].dstArrayElement = 3;
-        descriptorWrites[3].pImageInfo = &pbrDescriptor;
+    // Color, pbr, emissive and motion follow position and normal in the array
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_GBufferDescriptor.GetDescriptorSets()[frame];
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = static_cast<uint32_t>(transientDescriptors.size());
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 2;
+    descriptorWrite.pImageInfo = transientDescriptors.data();
 
-        descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[4].dstSet = descriptorSets[i];
-        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[4].descriptorCount = 1;
-        descriptorWrites[4].dstBinding = 0;
-        descriptorWrites[4].dstArrayElement = 4;
-        descriptorWrites[4].pImageInfo = &emissiveDescriptor;
+    vkUpdateDescriptorSets(m_Device, 1, &descriptorWrite, 0, nullptr);
 
-        vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-    }
+    m_GBufferTransientVersions[frame] = m_RenderGraph.GetPlacementVersion();
 }
 
 void Renderer::CreateCubeMapGraphicPipeline()
@@ -1194,7 +1391,8 @@ void Renderer::CreateCubeMapGraphicPipeline()
     pPipelineColorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
     pPipelineColorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
-    std::array<VkPipelineColorBlendAttachmentState, 5> pPipelineColorBlendAttachmentStates = { pPipelineColorBlendAttachmentState,
+    std::array<VkPipelineColorBlendAttachmentState, 6> pPipelineColorBlendAttachmentStates = { pPipelineColorBlendAttachmentState,
+                                                                                               pPipelineColorBlendAttachmentState,
                                                                                                pPipelineColorBlendAttachmentState,
                                                                                                pPipelineColorBlendAttachmentState,
                                                                                                pPipelineColorBlendAttachmentState,
@@ -1235,9 +1433,17 @@ void Renderer::CreateCubeMapGraphicPipeline()
     if (vkCreatePipelineLayout(m_Device, &pipelineLayoutFirstPassCreateInfo, NULL, &m_GraphicPipelineCubeMapLayout) != VK_SUCCESS)
         std::cout << "Pipeline layout creation failed !" << '\n';
 
+    // Drawn into the G-buffer without any depth attachment
+    VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
+    pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    pipelineRenderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(GBufferColorFormats.size());
+    pipelineRenderingCreateInfo.pColorAttachmentFormats = GBufferColorFormats.data();
+    pipelineRenderingCreateInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    pipelineRenderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
     VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
     graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    graphicsPipelineCreateInfo.pNext = NULL;
+    graphicsPipelineCreateInfo.pNext = &pipelineRenderingCreateInfo;
     graphicsPipelineCreateInfo.flags = 0;
     graphicsPipelineCreateInfo.stageCount = static_cast<uint32_t>(firstPipelineShaderStageCreateInfos.size());
     graphicsPipelineCreateInfo.pStages = firstPipelineShaderStageCreateInfos.data();
@@ -1251,7 +1457,7 @@ void Renderer::CreateCubeMapGraphicPipeline()
     graphicsPipelineCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
     graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
     graphicsPipelineCreateInfo.layout = m_GraphicPipelineCubeMapLayout;
-    graphicsPipelineCreateInfo.renderPass = m_RenderPass.getRenderPass();
+    graphicsPipelineCreateInfo.renderPass = VK_NULL_HANDLE;
     graphicsPipelineCreateInfo.subpass = 0;
     graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
     graphicsPipelineCreateInfo.basePipelineIndex = -1;
@@ -1269,7 +1475,7 @@ void Renderer::CreatePerPassDescriptor()
     descriptorSetLayoutBinding.binding = 0;
     descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     descriptorSetLayoutBinding.descriptorCount = 1;
-    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | m_LightingShaderStages | m_MeshShaderStages;
     descriptorSetLayoutBinding.pImmutableSamplers = NULL;
 
     VkDescriptorSetLayoutBinding descriptorSetCubeMapLayoutBinding{};
@@ -1283,17 +1489,24 @@ void Renderer::CreatePerPassDescriptor()
     descriptorDirectionalLightsLayoutBinding.binding = 2;
     descriptorDirectionalLightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorDirectionalLightsLayoutBinding.descriptorCount = 1;
-    descriptorDirectionalLightsLayoutBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    descriptorDirectionalLightsLayoutBinding.stageFlags = m_LightingShaderStages;
     descriptorDirectionalLightsLayoutBinding.pImmutableSamplers = NULL;
 
     VkDescriptorSetLayoutBinding descriptorPointLightsLayoutBinding{};
     descriptorPointLightsLayoutBinding.binding = 3;
     descriptorPointLightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorPointLightsLayoutBinding.descriptorCount = 1;
-    descriptorPointLightsLayoutBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    descriptorPointLightsLayoutBinding.stageFlags = m_LightingShaderStages;
     descriptorPointLightsLayoutBinding.pImmutableSamplers = NULL;
 
-    m_PerPassDescriptor.CreateDescriptorSetLayout(m_Device, { descriptorSetLayoutBinding, descriptorSetCubeMapLayoutBinding, descriptorDirectionalLightsLayoutBinding, descriptorPointLightsLayoutBinding }, 0);
+    VkDescriptorSetLayoutBinding descriptorShadowMapLayoutBinding{};
+    descriptorShadowMapLayoutBinding.binding = 4;
+    descriptorShadowMapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorShadowMapLayoutBinding.descriptorCount = 1;
+    descriptorShadowMapLayoutBinding.stageFlags = m_LightingShaderStages;
+    descriptorShadowMapLayoutBinding.pImmutableSamplers = NULL;
+
+    m_PerPassDescriptor.CreateDescriptorSetLayout(m_Device, { descriptorSetLayoutBinding, descriptorSetCubeMapLayoutBinding, descriptorDirectionalLightsLayoutBinding, descriptorPointLightsLayoutBinding, descriptorShadowMapLayoutBinding }, 0);
 
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -1310,7 +1523,7 @@ void Renderer::CreatePerPassDescriptor()
     poolSizes.push_back(poolSize);
 
     poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
     poolSizes.push_back(poolSize);
 
     poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -1336,7 +1549,7 @@ void Renderer::CreatePerPassDescriptor()
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(SceneUniform);
 
-        std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[0].dstSet = descriptorSets[i];
         descriptorWrites[0].dstBinding = 0;
@@ -1384,6 +1597,19 @@ void Renderer::CreatePerPassDescriptor()
         descriptorWrites[3].descriptorCount = 1;
         descriptorWrites[3].pBufferInfo = &pointLightBufferInfo;
 
+        VkDescriptorImageInfo shadowMapInfo{};
+        shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        shadowMapInfo.imageView = m_CascadedShadowMap->GetImageView();
+        shadowMapInfo.sampler = m_CascadedShadowMap->GetSampler();
+
+        descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[4].dstSet = descriptorSets[i];
+        descriptorWrites[4].dstBinding = 4;
+        descriptorWrites[4].dstArrayElement = 0;
+        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[4].descriptorCount = 1;
+        descriptorWrites[4].pImageInfo = &shadowMapInfo;
+
         vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 }
@@ -1542,7 +1768,8 @@ void Renderer::CreateGraphicPipeline()
     pPipelineColorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
     pPipelineColorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
-    std::array<VkPipelineColorBlendAttachmentState, 5> pPipelineColorBlendAttachmentStates = { pPipelineColorBlendAttachmentState,
+    std::array<VkPipelineColorBlendAttachmentState, 6> pPipelineColorBlendAttachmentStates = { pPipelineColorBlendAttachmentState,
+                                                                                               pPipelineColorBlendAttachmentState,
                                                                                                pPipelineColorBlendAttachmentState,
                                                                                                pPipelineColorBlendAttachmentState,
                                                                                                pPipelineColorBlendAttachmentState,
@@ -1583,9 +1810,16 @@ void Renderer::CreateGraphicPipeline()
     if (vkCreatePipelineLayout(m_Device, &pipelineLayoutFirstPassCreateInfo, NULL, &m_GraphicPipelineFirstPassLayout) != VK_SUCCESS)
         std::cout << "Pipeline layout creation failed !" << '\n';
 
+    VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
+    pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    pipelineRenderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(GBufferColorFormats.size());
+    pipelineRenderingCreateInfo.pColorAttachmentFormats = GBufferColorFormats.data();
+    pipelineRenderingCreateInfo.depthAttachmentFormat = m_DepthFormat;
+    pipelineRenderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
     VkGraphicsPipelineCreateInfo graphicsPipelineFirstPassCreateInfo;
     graphicsPipelineFirstPassCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    graphicsPipelineFirstPassCreateInfo.pNext = NULL;
+    graphicsPipelineFirstPassCreateInfo.pNext = &pipelineRenderingCreateInfo;
     graphicsPipelineFirstPassCreateInfo.flags = 0;
     graphicsPipelineFirstPassCreateInfo.stageCount = static_cast<uint32_t>(firstPipelineShaderStageCreateInfos.size());
     graphicsPipelineFirstPassCreateInfo.pStages = firstPipelineShaderStageCreateInfos.data();
@@ -1599,7 +1833,7 @@ void Renderer::CreateGraphicPipeline()
     graphicsPipelineFirstPassCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
     graphicsPipelineFirstPassCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
     graphicsPipelineFirstPassCreateInfo.layout = m_GraphicPipelineFirstPassLayout;
-    graphicsPipelineFirstPassCreateInfo.renderPass = m_RenderPass.getRenderPass();
+    graphicsPipelineFirstPassCreateInfo.renderPass = VK_NULL_HANDLE;
     graphicsPipelineFirstPassCreateInfo.subpass = 0;
     graphicsPipelineFirstPassCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
     graphicsPipelineFirstPassCreateInfo.basePipelineIndex = -1;
@@ -1612,6 +1846,58 @@ void Renderer::CreateGraphicPipeline()
     if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &graphicsPipelineFirstPassCreateInfo, NULL, &m_GraphicPipelineFirstPassLineMode) != VK_SUCCESS)
         std::cout << "Pipeline cration failed !" << '\n';
 
+    // Same G-buffer outputs from meshlets: the task shader culls them, the mesh shader fetches their vertices
+    if (m_MeshShaderSupported)
+    {
+        Shader meshletTaskShader;
+        meshletTaskShader.createModule(m_Device, ".\\Shader\\meshletTask.spv");
+        Shader meshletMeshShader;
+        meshletMeshShader.createModule(m_Device, ".\\Shader\\meshletMesh.spv");
+
+        VkPipelineShaderStageCreateInfo pipelineMeshletTaskShaderStageCreateInfo = pipelineFirstVertexShaderStageCreateInfo;
+        pipelineMeshletTaskShaderStageCreateInfo.stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+        pipelineMeshletTaskShaderStageCreateInfo.module = meshletTaskShader.getShaderModule();
+
+        VkPipelineShaderStageCreateInfo pipelineMeshletMeshShaderStageCreateInfo = pipelineFirstVertexShaderStageCreateInfo;
+        pipelineMeshletMeshShaderStageCreateInfo.stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+        pipelineMeshletMeshShaderStageCreateInfo.module = meshletMeshShader.getShaderModule();
+
+        std::array<VkPipelineShaderStageCreateInfo, 3> meshShadingPipelineShaderStageCreateInfos = { pipelineMeshletTaskShaderStageCreateInfo, pipelineMeshletMeshShaderStageCreateInfo, pipelineFirstFragmentShaderStageCreateInfo };
+
+        std::array<VkDescriptorSetLayout, 4> meshShadingLayouts = { m_PerPassDescriptor.GetDescriptorSetLayout(), m_PerMeshDescriptor.GetDescriptorSetLayout(), m_Materials.GetDescriptorSetsLayout(), m_MeshletDescriptor.GetDescriptorSetLayout() };
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(MeshletPushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutMeshShadingCreateInfo = pipelineLayoutFirstPassCreateInfo;
+        pipelineLayoutMeshShadingCreateInfo.setLayoutCount = static_cast<uint32_t>(meshShadingLayouts.size());
+        pipelineLayoutMeshShadingCreateInfo.pSetLayouts = meshShadingLayouts.data();
+        pipelineLayoutMeshShadingCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutMeshShadingCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(m_Device, &pipelineLayoutMeshShadingCreateInfo, NULL, &m_GraphicPipelineMeshShadingLayout) != VK_SUCCESS)
+            std::cout << "Mesh shading pipeline layout creation failed !" << '\n';
+
+        pipelineRasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+
+        // No vertex input nor input assembly, the mesh shader outputs triangles
+        VkGraphicsPipelineCreateInfo graphicsPipelineMeshShadingCreateInfo = graphicsPipelineFirstPassCreateInfo;
+        graphicsPipelineMeshShadingCreateInfo.stageCount = static_cast<uint32_t>(meshShadingPipelineShaderStageCreateInfos.size());
+        graphicsPipelineMeshShadingCreateInfo.pStages = meshShadingPipelineShaderStageCreateInfos.data();
+        graphicsPipelineMeshShadingCreateInfo.pVertexInputState = NULL;
+        graphicsPipelineMeshShadingCreateInfo.pInputAssemblyState = NULL;
+        graphicsPipelineMeshShadingCreateInfo.pTessellationState = NULL;
+        graphicsPipelineMeshShadingCreateInfo.layout = m_GraphicPipelineMeshShadingLayout;
+
+        if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &graphicsPipelineMeshShadingCreateInfo, NULL, &m_GraphicPipelineMeshShading) != VK_SUCCESS)
+            std::cout << "Mesh shading pipeline creation failed !" << '\n';
+
+        meshletTaskShader.cleanup(m_Device);
+        meshletMeshShader.cleanup(m_Device);
+    }
+
     /*
     std::array<VkDescriptorSetLayout, 2> secondPassLayouts = { m_PerPassDescriptor.GetDescriptorSetLayout(), m_GBufferDescriptor.GetDescriptorSetLayout() };
 
@@ -1651,7 +1937,7 @@ void Renderer::CreateGraphicPipeline()
     graphicsPipelineSecondPassCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
     graphicsPipelineSecondPassCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
     graphicsPipelineSecondPassCreateInfo.layout = m_GraphicPipelineSecondPassLayout;
-    graphicsPipelineSecondPassCreateInfo.renderPass = m_RenderPass.getRenderPass();
+    graphicsPipelineSecondPassCreateInfo.renderPass = VK_NULL_HANDLE;
     graphicsPipelineSecondPassCreateInfo.subpass = 0;
     graphicsPipelineSecondPassCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
     graphicsPipelineSecondPassCreateInfo.basePipelineIndex = -1;
@@ -1678,7 +1964,7 @@ void Renderer::CreateQuadMesh()
     m_simpleQuadMesh.AddVertex(Vertex(glm::vec3(1., -1., 0.), glm::vec3(0.), glm::vec3(0.), glm::vec3(0.), glm::vec2(1., -1.), {0, 0, 0}));
     m_simpleQuadMesh.AddVertex(Vertex(glm::vec3(1., 1., 0.), glm::vec3(0.), glm::vec3(0.), glm::vec3(0.), glm::vec2(1., 1.), {0, 0, 0}));
 
-    m_simpleQuadMesh.CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value());
+    m_simpleQuadMesh.CreateVertexBuffers(m_Allocator, m_Device, m_TransferPool, m_TranferQueue, m_QueueFamilyIndices.transferFamily.value(), m_QueueFamilyIndices.graphicsFamily.value(), m_QueueFamilyIndices.computeFamily.value(), false);
 }
 
 void Renderer::CreateCommandPool()
@@ -1722,201 +2008,575 @@ void Renderer::CreateCommandBuffers()
        std::cout << "Command buffer creation failed !" << '\n';
 }
 
-void Renderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex, ImDrawData* draw_data)
+void Renderer::CreateComputeCommandBuffers()
 {
-    VkFramebuffer framebuffers = m_SwapChain.GetFramebuffers()[currentFrame];
-    auto GBufferDescriptorSet = m_GBufferDescriptor.GetDescriptorSets()[currentFrame];
-
-    VkDescriptorSet perMeshDescriptorSet = VK_NULL_HANDLE;
-    if (!m_PerMeshDescriptor.GetDescriptorSets().empty())
-        perMeshDescriptorSet = m_PerMeshDescriptor.GetDescriptorSets()[currentFrame];
-    auto perPassDescriptorSet = m_PerPassDescriptor.GetDescriptorSets()[currentFrame];
+    m_SkinningCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_AccelerationStructureCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = NULL;
+    commandBufferAllocateInfo.commandPool = m_ComputePool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+
+    if (vkAllocateCommandBuffers(m_Device, &commandBufferAllocateInfo, m_SkinningCommandBuffers.data()) != VK_SUCCESS ||
+        vkAllocateCommandBuffers(m_Device, &commandBufferAllocateInfo, m_AccelerationStructureCommandBuffers.data()) != VK_SUCCESS)
+        std::cout << "Compute command buffer creation failed !" << '\n';
+}
 
-    std::vector<VkImage> Images;
-    m_SwapChain.GetImages(Images);
+void Renderer::RecordComputeCommandBuffers(uint32_t currentFrame)
+{
+    CPU_ZONE("RecordComputeCommandBuffers");
 
     VkCommandBufferBeginInfo beginInfo;
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.pNext = NULL;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = NULL; //ignored if VK_COMMAND_BUFFER_LEVEL_PRIMARY
-
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
-        std::cout << "Failed to begin commandBuffer !" << '\n';
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = NULL;
 
-    std::array<VkClearValue, 7> clearValues{};
-    clearValues[0].color = clearColor;
-    clearValues[1].color = clearColor;
-    clearValues[2].color = clearColor;
-    clearValues[3].color = clearColor;
-    clearValues[4].color = clearColor;
-    clearValues[5].depthStencil = { 1.0f, 0 };
-    clearValues[6].color = clearColor;
-
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_RenderPass.getRenderPass();
-    renderPassInfo.framebuffer = framebuffers;
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = m_SwapChain.GetExtent();
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkCommandBuffer skinningCommandBuffer = m_SkinningCommandBuffers[currentFrame];
 
-    auto extent = m_SwapChain.GetExtent();
+    vkResetCommandBuffer(skinningCommandBuffer, 0);
 
-    VkViewport viewport;
-    viewport.x = 0.0;
-    viewport.y = static_cast<float>(extent.height);
-    viewport.width = static_cast<float>(extent.width);
-    viewport.height = -static_cast<float>(extent.height);
-    viewport.minDepth = 0.0;
-    viewport.maxDepth = 1.f;
+    if (vkBeginCommandBuffer(skinningCommandBuffer, &beginInfo) != VK_SUCCESS)
+        std::cout << "Failed to begin skinning commandBuffer !" << '\n';
 
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    if (m_Skinning->HasSkinnedMeshes())
+    {
+        m_GpuProfiler.BeginScope(skinningCommandBuffer, currentFrame, "Skinning (async compute)");
+        // Vertex input is covered by the semaphore, only the BLAS refit reads the result on this queue
+        m_Skinning->RecordCmdDispatch(skinningCommandBuffer, currentFrame, m_RayTracingSupported ? VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        m_GpuProfiler.EndScope(skinningCommandBuffer, currentFrame);
+    }
+
+    if (vkEndCommandBuffer(skinningCommandBuffer) != VK_SUCCESS)
+        std::cout << "Failed to record skinning command buffer !" << '\n';
+
+    VkCommandBuffer accelerationStructureCommandBuffer = m_AccelerationStructureCommandBuffers[currentFrame];
+
+    vkResetCommandBuffer(accelerationStructureCommandBuffer, 0);
+
+    if (vkBeginCommandBuffer(accelerationStructureCommandBuffer, &beginInfo) != VK_SUCCESS)
+        std::cout << "Failed to begin acceleration structure commandBuffer !" << '\n';
+
+    if (m_RayTracingAccelerationStructure && m_LightingPath != LIGHTING_COMPUTE)
+    {
+        m_GpuProfiler.BeginScope(accelerationStructureCommandBuffer, currentFrame, "AS refit (async compute)");
+
+        if (m_Skinning->HasSkinnedMeshes())
+            m_RayTracingAccelerationStructure->RecordCmdRefitBottomLevelASs(accelerationStructureCommandBuffer, currentFrame);
+
+        // Traversal happens on the graphics queue behind the semaphore, which already makes the build visible
+        m_RayTracingAccelerationStructure->RecordCmdUpdateTopLevelAS(m_Device, m_Allocator, accelerationStructureCommandBuffer, currentFrame, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR);
+
+        m_GpuProfiler.EndScope(accelerationStructureCommandBuffer, currentFrame);
+    }
+
+    if (vkEndCommandBuffer(accelerationStructureCommandBuffer) != VK_SUCCESS)
+        std::cout << "Failed to record acceleration structure command buffer !" << '\n';
+}
+
+void Renderer::SubmitCompute(uint32_t currentFrame)
+{
+    CPU_ZONE("SubmitCompute");
+
+    if (!m_AsyncCompute)
+        return;
+
+    VkPipelineStageFlags graphicsFinishedWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (m_RayTracingSupported)
+        graphicsFinishedWaitStage |= VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+
+    // The previous graphics frame still reads the skinned vertices and BLASes this frame rewrites in place
+    uint64_t graphicsWaitValue = m_SubmittedFrameCount;
+    std::array<uint64_t, 2> signalValues = { m_ComputeTimelineValue + 1, m_ComputeTimelineValue + 2 };
+    m_ComputeTimelineValue += 2;
+
+    std::array<VkTimelineSemaphoreSubmitInfo, 2> timelineInfos{};
+    timelineInfos[0].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfos[0].waitSemaphoreValueCount = 1;
+    timelineInfos[0].pWaitSemaphoreValues = &graphicsWaitValue;
+    timelineInfos[0].signalSemaphoreValueCount = 1;
+    timelineInfos[0].pSignalSemaphoreValues = &signalValues[0];
+    timelineInfos[1].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfos[1].signalSemaphoreValueCount = 1;
+    timelineInfos[1].pSignalSemaphoreValues = &signalValues[1];
+
+    std::array<VkSubmitInfo, 2> submitInfos{};
+    submitInfos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfos[0].pNext = &timelineInfos[0];
+    submitInfos[0].waitSemaphoreCount = 1;
+    submitInfos[0].pWaitSemaphores = &m_GraphicsTimeline;
+    submitInfos[0].pWaitDstStageMask = &graphicsFinishedWaitStage;
+    submitInfos[0].commandBufferCount = 1;
+    submitInfos[0].pCommandBuffers = &m_SkinningCommandBuffers[currentFrame];
+    submitInfos[0].signalSemaphoreCount = 1;
+    submitInfos[0].pSignalSemaphores = &m_ComputeTimeline;
+
+    // Separate batch so the graphics queue only waits on it where the lighting reads the acceleration structures
+    submitInfos[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfos[1].pNext = &timelineInfos[1];
+    submitInfos[1].commandBufferCount = 1;
+    submitInfos[1].pCommandBuffers = &m_AccelerationStructureCommandBuffers[currentFrame];
+    submitInfos[1].signalSemaphoreCount = 1;
+    submitInfos[1].pSignalSemaphores = &m_ComputeTimeline;
+
+    if (vkQueueSubmit(m_ComputeQueue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), VK_NULL_HANDLE) != VK_SUCCESS)
+        std::cout << "Failed to submit compute command buffers !" << '\n';
+}
+
+void Renderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex, ImDrawData* draw_data)
+{
+    CPU_ZONE("RecordCommandBuffer");
+
+    auto GBufferDescriptorSet = m_GBufferDescriptor.GetDescriptorSets()[currentFrame];
+
+    VkDescriptorSet perMeshDescriptorSet = VK_NULL_HANDLE;
+    if (!m_PerMeshDescriptor.GetDescriptorSets().empty())
+        perMeshDescriptorSet = m_PerMeshDescriptor.GetDescriptorSets()[0];
+    auto perPassDescriptorSet = m_PerPassDescriptor.GetDescriptorSets()[currentFrame];
+
+    std::vector<VkImage> Images;
+    m_SwapChain.GetImages(Images);
+
+    VkCommandBufferBeginInfo beginInfo;
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = NULL;
+    beginInfo.flags = 0;
+    beginInfo.pInheritanceInfo = NULL; //ignored if VK_COMMAND_BUFFER_LEVEL_PRIMARY
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        std::cout << "Failed to begin commandBuffer !" << '\n';
+
+    auto extent = m_SwapChain.GetExtent();
+
+    auto& GBufferImages = m_GBuffer.GetGBufferImages();
+    GBUFFER& currentGBuffer = GBufferImages[currentFrame];
+    GBUFFER& previousGBuffer = GBufferImages[(currentFrame + GBufferImages.size() - 1) % GBufferImages.size()];
+
+    // The legacy stage bits are the low bits of the synchronization2 ones
+    VkPipelineStageFlags2 lightingStages = static_cast<VkPipelineStageFlags2>(m_LightingPipelineStages);
+
+    m_RenderGraph.Reset();
+
+    // Position and normal are read again by the next frame, the other targets only live until the lighting
+    std::array<RenderGraphResource, 6> GBufferTargets = {
+        m_RenderGraph.ImportImage("GBuffer position", currentGBuffer.positionImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT),
+        m_RenderGraph.ImportImage("GBuffer normal", currentGBuffer.normalImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT)
+    };
+    m_RenderGraph.KeepImage(GBufferTargets[0]);
+    m_RenderGraph.KeepImage(GBufferTargets[1]);
+
+    std::array<RenderGraphResource, 4> GBufferTransientTargets;
+    for (size_t i = 0; i < GBufferTransientTargets.size(); i++)
+    {
+        GBufferTransientTargets[i] = m_RenderGraph.CreateImage(GBufferTransientNames[i], { GBufferColorFormats[i + 2], extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT });
+        GBufferTargets[i + 2] = GBufferTransientTargets[i];
+    }
+
+    // The transient views only exist once the graph is compiled
+    VkImageView positionView = currentGBuffer.positionImageBuffer.GetImageView();
+    VkImageView normalView = currentGBuffer.normalImageBuffer.GetImageView();
+    auto GetGBufferViews = [this, GBufferTargets, positionView, normalView]()
+    {
+        std::array<VkImageView, 6> views = { positionView, normalView };
+        for (size_t i = 2; i < views.size(); i++)
+            views[i] = m_RenderGraph.GetImageView(GBufferTargets[i]);
+
+        return views;
+    };
+    // Only the geometry pass needs depth, its memory is left to the graph
+    RenderGraphResource depth = m_RenderGraph.CreateImage("Depth", { m_DepthFormat, extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, m_DepthAspect });
+    RenderGraphResource shadowMap = m_RenderGraph.ImportImage("Shadow cascades", m_CascadedShadowMap->GetImage(), VK_IMAGE_ASPECT_DEPTH_BIT);
+    RenderGraphResource shadowHistory = m_RenderGraph.ImportImage("Shadow history", currentGBuffer.shadowHistoryImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT);
+    m_RenderGraph.KeepImage(shadowHistory);
+    RenderGraphResource previousShadowHistory = m_RenderGraph.ImportImage("Previous shadow history", previousGBuffer.shadowHistoryImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT);
+    RenderGraphResource previousPosition = m_RenderGraph.ImportImage("Previous GBuffer position", previousGBuffer.positionImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT);
+    RenderGraphResource previousNormal = m_RenderGraph.ImportImage("Previous GBuffer normal", previousGBuffer.normalImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT);
+    RenderGraphResource sceneImage = m_RenderGraph.ImportImage("Scene", Images[currentFrame], VK_IMAGE_ASPECT_COLOR_BIT);
+    // The acquire semaphore is waited at the color attachment output stage
+    RenderGraphResource swapChainImage = 0;
+    if (!m_Headless.enabled)
+        swapChainImage = m_RenderGraph.ImportImage("Swap chain", m_SwapChain.GetFinalImage()[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    if (m_ResetTemporalHistoryFrame)
+    {
+        uint32_t resetPass = m_RenderGraph.AddPass("Reset temporal history", [this](VkCommandBuffer cmd) {
+            ResetTemporalHistory(cmd);
+        });
+
+        // Every history, not only the ones this frame touches, the later frames read theirs
+        for (auto& GBuffer : GBufferImages)
+        {
+            RenderGraphResource history = m_RenderGraph.ImportImage("Shadow history", GBuffer.shadowHistoryImageBuffer.GetImage(), VK_IMAGE_ASPECT_COLOR_BIT);
+            m_RenderGraph.KeepImage(history);
+            m_RenderGraph.WriteImage(resetPass, history, RG_USAGE_TRANSFER_DST, VK_PIPELINE_STAGE_2_NONE, true);
+        }
+    }
+
+    // Skinning only touches buffers, it is kept as a side effect
+    if (m_Skinning->HasSkinnedMeshes() && !m_AsyncCompute)
+    {
+        m_RenderGraph.AddPass("Skinning + BLAS refit", [this, currentFrame](VkCommandBuffer cmd) {
+            // Skinned vertices feed the shadow cascades, the G-buffer and, when rays are traced, the BLAS refit
+            bool refitBottomLevelASs = m_RayTracingAccelerationStructure && m_LightingPath != LIGHTING_COMPUTE;
+
+            VkPipelineStageFlags skinnedVertexStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            if (m_RayTracingSupported)
+                skinnedVertexStages |= VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+
+            m_GpuProfiler.BeginScope(cmd, currentFrame, "Skinning + BLAS refit");
+
+            m_Skinning->RecordCmdDispatch(cmd, currentFrame, skinnedVertexStages);
+
+            if (refitBottomLevelASs)
+                m_RayTracingAccelerationStructure->RecordCmdRefitBottomLevelASs(cmd, currentFrame);
+
+            m_GpuProfiler.EndScope(cmd, currentFrame);
+        }, true);
+    }
+
+    // Only the first directional light owns cascades, when unused the lighting still binds the map and the graph leaves it UNDEFINED
+    bool shadowMapUsed = !m_DirectionalLights.empty() && m_DirectionalLights[0].GetShadowTechnique() == SHADOW_MAP;
+    if (shadowMapUsed)
+    {
+        uint32_t shadowPass = m_RenderGraph.AddPass("Shadow cascades", [this, currentFrame, perMeshDescriptorSet](VkCommandBuffer cmd) {
+            m_GpuProfiler.BeginScope(cmd, currentFrame, "Shadow cascades");
+            m_CascadedShadowMap->RecordCmdDraw(cmd, m_Meshes, perMeshDescriptorSet, m_ModelsOffset);
+            m_GpuProfiler.EndScope(cmd, currentFrame);
+        });
+
+        m_RenderGraph.WriteImage(shadowPass, shadowMap, RG_USAGE_DEPTH_ATTACHMENT, VK_PIPELINE_STAGE_2_NONE, true);
+    }
+
+    VkViewport viewport;
+    viewport.x = 0.0;
+    viewport.y = static_cast<float>(extent.height);
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = -static_cast<float>(extent.height);
+    viewport.minDepth = 0.0;
+    viewport.maxDepth = 1.f;
 
     VkRect2D scissor;
     scissor.offset = { 0, 0 };
     scissor.extent = extent;
 
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    // The cube map clears the G-buffer and draws without depth
+    uint32_t cubeMapPass = m_RenderGraph.AddPass("Cube map", [this, currentFrame, GetGBufferViews, extent, viewport, scissor, perPassDescriptorSet](VkCommandBuffer cmd) {
+        std::array<VkImageView, 6> GBufferViews = GetGBufferViews();
+
+        std::array<VkRenderingAttachmentInfo, 6> colorAttachments{};
+        for (size_t i = 0; i < colorAttachments.size(); i++)
+        {
+            VkClearValue clearValue{};
+            clearValue.color = clearColor;
+            colorAttachments[i] = VulkanUtils::RenderingAttachmentInfo(GBufferViews[i], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, clearValue);
+        }
+        colorAttachments[5].clearValue.color = { { 0.f, 0.f, 0.f, 0.f } };
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+        renderingInfo.pColorAttachments = colorAttachments.data();
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineCubeMap);
+        m_GpuProfiler.BeginScope(cmd, currentFrame, "Cube map");
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineCubeMapLayout, 0, 1, &perPassDescriptorSet, 0, NULL);
+        vkCmdBeginRendering(cmd, &renderingInfo);
 
-    m_CubeMap->BindVertexBuffer(commandBuffer);
-    m_CubeMap->BindIndexBuffer(commandBuffer);
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    vkCmdDrawIndexed(commandBuffer, 36, 1, 0, 0, 0);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineCubeMap);
 
-    if (m_Wireframe)
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPassLineMode);
-    else
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPass);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineCubeMapLayout, 0, 1, &perPassDescriptorSet, 0, NULL);
 
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
-    VkDeviceSize minSize = properties.limits.minUniformBufferOffsetAlignment;
+        m_CubeMap->BindVertexBuffer(cmd);
+        m_CubeMap->BindIndexBuffer(cmd);
 
-    uint64_t bufferSize = sizeof(glm::mat4);
-    uint64_t paddedSize = (bufferSize + minSize - 1) & ~(minSize - 1);
+        vkCmdDrawIndexed(cmd, 36, 1, 0, 0, 0);
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPassLayout, 0, 1, &perPassDescriptorSet, 0, NULL);
+        vkCmdEndRendering(cmd);
 
-    for (size_t i = 0; i < m_Meshes.size(); i++)
-    {
-        auto mesh = m_Meshes[i];
+        m_GpuProfiler.EndScope(cmd, currentFrame);
+    });
+
+    for (RenderGraphResource target : GBufferTargets)
+        m_RenderGraph.WriteImage(cubeMapPass, target, RG_USAGE_COLOR_ATTACHMENT, VK_PIPELINE_STAGE_2_NONE, true);
+
+    uint32_t GBufferPass = m_RenderGraph.AddPass("GBuffer", [this, currentFrame, GetGBufferViews, depth, extent, viewport, scissor, perPassDescriptorSet, perMeshDescriptorSet](VkCommandBuffer cmd) {
+        std::array<VkImageView, 6> GBufferViews = GetGBufferViews();
+
+        std::array<VkRenderingAttachmentInfo, 6> colorAttachments{};
+        for (size_t i = 0; i < colorAttachments.size(); i++)
+            colorAttachments[i] = VulkanUtils::RenderingAttachmentInfo(GBufferViews[i], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_STORE);
+
+        VkClearValue depthClearValue{};
+        depthClearValue.depthStencil = { 1.0f, 0 };
+
+        // The transient view only exists once the graph is compiled
+        VkRenderingAttachmentInfo depthAttachment = VulkanUtils::RenderingAttachmentInfo(m_RenderGraph.GetImageView(depth), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, depthClearValue);
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+        renderingInfo.pColorAttachments = colorAttachments.data();
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        m_GpuProfiler.BeginScope(cmd, currentFrame, "GBuffer");
+
+        vkCmdBeginRendering(cmd, &renderingInfo);
+
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-        uint32_t offset = static_cast<uint32_t>(i * paddedSize);
+        if (m_Wireframe)
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPassLineMode);
+        else
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPass);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPassLayout, 1, 1, &perMeshDescriptorSet, 1, &offset);
-        mesh->BindVertexBuffer(commandBuffer);
-        mesh->BindIndexBuffer(commandBuffer);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPassLayout, 0, 1, &perPassDescriptorSet, 0, NULL);
 
-        for (const auto& primitive : mesh->GetPrimitives())
+        if (perMeshDescriptorSet != VK_NULL_HANDLE)
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineFirstPassLayout, 1, 1, &perMeshDescriptorSet, 1, &m_ModelsOffset);
+
+        // Wireframe and skinned meshes stay on the vertex pipeline
+        bool meshShading = m_MeshShading && !m_Wireframe;
+
+        for (size_t i = 0; i < m_Meshes.size(); i++)
         {
-            m_Materials.BindMaterial(primitive.materialID, commandBuffer, m_GraphicPipelineFirstPassLayout);
+            if (meshShading && m_MeshletDescriptorIndices[i] >= 0)
+                continue;
+
+            auto mesh = m_Meshes[i];
 
-            vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, static_cast<int32_t>(primitive.vertexOffset), 0);
+            mesh->BindVertexBuffer(cmd);
+            mesh->BindIndexBuffer(cmd);
+
+            const std::vector<Primitive>& primitives = mesh->GetPrimitives();
+
+            for (size_t j = 0; j < primitives.size(); j++)
+            {
+                const Primitive& primitive = primitives[j];
+                PrimitiveLod lod = mesh->GetPrimitiveLod(j, mesh->GetLod());
+
+                m_Materials.BindMaterial(primitive.materialID, cmd, m_GraphicPipelineFirstPassLayout);
+
+                // The first instance is the mesh index, the vertex shader reads its model matrix with it
+                vkCmdDrawIndexed(cmd, lod.indexCount, 1, lod.firstIndex, static_cast<int32_t>(primitive.vertexOffset), static_cast<uint32_t>(i));
+            }
         }
-    }
 
-    vkCmdEndRenderPass(commandBuffer);
+        if (meshShading)
+        {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineMeshShading);
 
-    /*
-    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+            // The push constant range makes the layout incompatible with the vertex pipeline one, every set is bound again
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineMeshShadingLayout, 0, 1, &perPassDescriptorSet, 0, NULL);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineSecondPass);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineSecondPassLayout, 0, 1, &perPassDescriptorSet, 0, NULL);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineSecondPassLayout, 1, 1, &GBufferDescriptorSet, 0, NULL);
-    m_simpleQuadMesh.BindVertexBuffer(commandBuffer);
-    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+            if (perMeshDescriptorSet != VK_NULL_HANDLE)
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineMeshShadingLayout, 1, 1, &perMeshDescriptorSet, 1, &m_ModelsOffset);
 
-    vkCmdEndRenderPass(commandBuffer);
-    */
+            const std::vector<VkDescriptorSet>& meshletDescriptorSets = m_MeshletDescriptor.GetDescriptorSets();
 
-    VkImageSubresourceRange imageSubresourceRange;
-    imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageSubresourceRange.baseMipLevel = 0;
-    imageSubresourceRange.levelCount = 1;
-    imageSubresourceRange.baseArrayLayer = 0;
-    imageSubresourceRange.layerCount = 1;
+            MeshletPushConstants pushConstants{};
+            pushConstants.vertexStride = sizeof(Vertex) / sizeof(float);
+            pushConstants.positionOffset = offsetof(Vertex, pos) / sizeof(float);
+            pushConstants.normalOffset = offsetof(Vertex, normal) / sizeof(float);
+            pushConstants.tangentOffset = offsetof(Vertex, tangent) / sizeof(float);
+            pushConstants.biTangentOffset = offsetof(Vertex, biTangent) / sizeof(float);
+            pushConstants.texCoordOffset = offsetof(Vertex, tex_coord) / sizeof(float);
+            pushConstants.colorOffset = offsetof(Vertex, color) / sizeof(float);
 
-    VkImageMemoryBarrier imageBarrier = {};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageBarrier.oldLayout = m_freshRT[currentFrame] ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;   
-    imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT; 
-    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT; 
-    imageBarrier.image = Images[currentFrame];
-    imageBarrier.subresourceRange = imageSubresourceRange;
+            for (size_t i = 0; i < m_Meshes.size(); i++)
+            {
+                if (m_MeshletDescriptorIndices[i] < 0)
+                    continue;
 
-    m_freshRT[currentFrame] = false;
-    
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,        
-        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
-        0,                                    
-        0, nullptr,                            
-        0, nullptr,                           
-        1, &imageBarrier               
-    );
-
-    m_RayTracingAccelerationStructure->BindPipeline(commandBuffer);
-    m_RayTracingAccelerationStructure->BindTopLevelASDescriptorSet(commandBuffer, currentFrame);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_RayTracingAccelerationStructure->GetRayTracingPipelineLayout(), 1, 1, &GBufferDescriptorSet, 0, NULL);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_RayTracingAccelerationStructure->GetRayTracingPipelineLayout(), 2, 1, &perPassDescriptorSet, 0, NULL);
-    
-    m_RayTracingAccelerationStructure->RecordCmdTraceRay(m_Device, m_Allocator, commandBuffer, currentFrame, extent.width, extent.height);
-
-    imageBarrier = {};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;                   // Layout actuel après le ray tracing
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;  // Layout souhaité pour la render pass
-    imageBarrier.srcQueueFamilyIndex = m_QueueFamilyIndices.graphicsFamily.value();
-    imageBarrier.dstQueueFamilyIndex = m_QueueFamilyIndices.graphicsFamily.value();
-    imageBarrier.image = Images[currentFrame];  // L'image générée par le ray tracing
-    imageBarrier.subresourceRange = imageSubresourceRange;
-    imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;  // Accès en écriture par le ray tracing
-    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;   // Accès en lecture pour la subpass
-    
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,  // Étape de ray tracing en source
-        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,         // Étape de fragment shader pour la render pass
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &imageBarrier
-    );
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicPipelineMeshShadingLayout, 3, 1, &meshletDescriptorSets[m_MeshletDescriptorIndices[i]], 0, NULL);
+
+                pushConstants.meshIndex = static_cast<uint32_t>(i);
+
+                const std::vector<Primitive>& primitives = m_Meshes[i]->GetPrimitives();
+
+                for (size_t j = 0; j < primitives.size(); j++)
+                {
+                    PrimitiveLod lod = m_Meshes[i]->GetPrimitiveLod(j, m_Meshes[i]->GetLod());
+
+                    if (lod.meshletCount == 0)
+                        continue;
+
+                    m_Materials.BindMaterial(primitives[j].materialID, cmd, m_GraphicPipelineMeshShadingLayout);
+
+                    pushConstants.meshletOffset = lod.meshletOffset;
+                    pushConstants.meshletCount = lod.meshletCount;
+                    vkCmdPushConstants(cmd, m_GraphicPipelineMeshShadingLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MeshletPushConstants), &pushConstants);
+
+                    // One task shader invocation per meshlet, each workgroup launches the mesh workgroups of its visible ones
+                    vkCmdDrawMeshTasksEXT(cmd, (lod.meshletCount + MESHLET_TASK_WORKGROUP_SIZE - 1) / MESHLET_TASK_WORKGROUP_SIZE, 1, 1);
+                }
+            }
+        }
+
+        vkCmdEndRendering(cmd);
 
-    VkFramebuffer finalFramebuffers = m_SwapChain.GetFinalFramebuffers()[imageIndex];
+        m_GpuProfiler.EndScope(cmd, currentFrame);
+    });
 
-    std::array<VkClearValue, 1> finalClearValues{};
-    finalClearValues[0].color = clearColor;
+    // The cube map left the targets to be loaded
+    for (RenderGraphResource target : GBufferTargets)
+        m_RenderGraph.WriteImage(GBufferPass, target, RG_USAGE_COLOR_ATTACHMENT);
+    m_RenderGraph.WriteImage(GBufferPass, depth, RG_USAGE_DEPTH_ATTACHMENT, VK_PIPELINE_STAGE_2_NONE, true);
+
+    // Offscreen, nothing reads the scene image most frames, the lighting is kept anyway so every frame costs the same
+    uint32_t lightingPass = m_RenderGraph.AddPass("Lighting", [this, currentFrame, extent, GBufferDescriptorSet, perPassDescriptorSet](VkCommandBuffer cmd) {
+        if (m_LightingPath == LIGHTING_RAY_TRACING)
+        {
+            m_GpuProfiler.BeginScope(cmd, currentFrame, "Lighting (ray tracing)");
 
-    VkRenderPassBeginInfo finalRenderPassInfo{};
-    finalRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    finalRenderPassInfo.renderPass = m_FinalRenderPass.getRenderPass();
-    finalRenderPassInfo.framebuffer = finalFramebuffers;
-    finalRenderPassInfo.renderArea.offset = { 0, 0 };
-    finalRenderPassInfo.renderArea.extent = m_SwapChain.GetExtent();
-    finalRenderPassInfo.clearValueCount = static_cast<uint32_t>(finalClearValues.size());
-    finalRenderPassInfo.pClearValues = finalClearValues.data();
+            if (!m_AsyncCompute)
+                m_RayTracingAccelerationStructure->RecordCmdUpdateTopLevelAS(m_Device, m_Allocator, cmd, currentFrame, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
 
-    vkCmdBeginRenderPass(commandBuffer, &finalRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            m_RayTracingAccelerationStructure->BindPipeline(cmd);
+            m_RayTracingAccelerationStructure->BindTopLevelASDescriptorSet(cmd, currentFrame);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_RayTracingAccelerationStructure->GetRayTracingPipelineLayout(), 1, 1, &GBufferDescriptorSet, 0, NULL);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_RayTracingAccelerationStructure->GetRayTracingPipelineLayout(), 2, 1, &perPassDescriptorSet, 0, NULL);
+
+            m_RayTracingAccelerationStructure->RecordCmdTraceRay(cmd, extent.width, extent.height);
+        }
+        else
+        {
+            bool rayQuery = m_LightingPath == LIGHTING_RAY_QUERY;
 
-    ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffer);
+            // The inline TLAS refit stays inside the scope so both ray traced paths are timed the same way
+            m_GpuProfiler.BeginScope(cmd, currentFrame, rayQuery ? "Lighting (ray query)" : "Lighting (compute)");
 
-    vkCmdEndRenderPass(commandBuffer);
+            if (rayQuery && !m_AsyncCompute)
+                m_RayTracingAccelerationStructure->RecordCmdUpdateTopLevelAS(m_Device, m_Allocator, cmd, currentFrame, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+            m_ComputeLighting->BindPipeline(cmd, rayQuery);
+            m_ComputeLighting->BindOutputDescriptorSet(cmd, currentFrame);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputeLighting->GetComputePipelineLayout(), 1, 1, &GBufferDescriptorSet, 0, NULL);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputeLighting->GetComputePipelineLayout(), 2, 1, &perPassDescriptorSet, 0, NULL);
+
+            m_ComputeLighting->RecordCmdDispatch(cmd, extent.width, extent.height);
+        }
+
+        m_GpuProfiler.EndScope(cmd, currentFrame);
+    }, m_Headless.enabled);
+
+    for (RenderGraphResource target : GBufferTargets)
+        m_RenderGraph.ReadImage(lightingPass, target, RG_USAGE_SAMPLED, lightingStages);
+    // The previous G-buffer rejects the history, it is still UNDEFINED on the first frame and the graph transitions it anyway
+    m_RenderGraph.ReadImage(lightingPass, previousPosition, RG_USAGE_SAMPLED, lightingStages);
+    m_RenderGraph.ReadImage(lightingPass, previousNormal, RG_USAGE_SAMPLED, lightingStages);
+    m_RenderGraph.ReadImage(lightingPass, previousShadowHistory, RG_USAGE_STORAGE, lightingStages);
+    m_RenderGraph.WriteImage(lightingPass, shadowHistory, RG_USAGE_STORAGE, lightingStages);
+    m_RenderGraph.WriteImage(lightingPass, sceneImage, RG_USAGE_STORAGE, lightingStages, true);
+    m_RenderGraph.ReadImage(lightingPass, shadowMap, RG_USAGE_SAMPLED, lightingStages);
+
+    if (m_Headless.enabled)
+    {
+        // Read back once the frame is done, WriteCompletedCaptures turns it into a PNG
+        if (m_Headless.capturedFrames.count(m_SubmittedFrameCount + 1) && !m_CaptureBuffers.empty())
+        {
+            VkImage captureImage = Images[currentFrame];
+            VkBuffer captureBuffer = m_CaptureBuffers[currentFrame].buffer;
+
+            uint32_t capturePass = m_RenderGraph.AddPass("Capture", [captureImage, captureBuffer, extent](VkCommandBuffer cmd) {
+                VkBufferImageCopy region{};
+                region.bufferOffset = 0;
+                region.bufferRowLength = 0;
+                region.bufferImageHeight = 0;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = 0;
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = { 0, 0, 0 };
+                region.imageExtent = { extent.width, extent.height, 1 };
+
+                vkCmdCopyImageToBuffer(cmd, captureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, captureBuffer, 1, &region);
+
+                // The semaphore signal only makes the copy available, the host read needs it visible
+                VkMemoryBarrier memoryBarrier{};
+                memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+            }, true);
+
+            m_RenderGraph.ReadImage(capturePass, sceneImage, RG_USAGE_TRANSFER_SRC);
+            m_PendingCaptures.push_back({ m_SubmittedFrameCount + 1, currentFrame });
+        }
+    }
+    else
+    {
+        // The scene is shown through an ImGui image, the swap chain only ever receives the UI
+        uint32_t UIPass = m_RenderGraph.AddPass("ImGui", [this, currentFrame, imageIndex, draw_data](VkCommandBuffer cmd) {
+            VkClearValue finalClearValue{};
+            finalClearValue.color = clearColor;
+
+            VkRenderingAttachmentInfo finalAttachment = VulkanUtils::RenderingAttachmentInfo(m_SwapChain.GetFinalImageViews()[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, finalClearValue);
+
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.renderArea.offset = { 0, 0 };
+            renderingInfo.renderArea.extent = m_SwapChain.GetExtent();
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &finalAttachment;
+
+            m_GpuProfiler.BeginScope(cmd, currentFrame, "ImGui");
+
+            vkCmdBeginRendering(cmd, &renderingInfo);
+
+            ImGui_ImplVulkan_RenderDrawData(draw_data, cmd);
+
+            vkCmdEndRendering(cmd);
+
+            m_GpuProfiler.EndScope(cmd, currentFrame);
+        });
+
+        m_RenderGraph.ReadImage(UIPass, sceneImage, RG_USAGE_SAMPLED, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+        m_RenderGraph.WriteImage(UIPass, swapChainImage, RG_USAGE_COLOR_ATTACHMENT, VK_PIPELINE_STAGE_2_NONE, true);
+    }
+
+    m_RenderGraph.Compile(m_Device, m_Allocator, m_DeletionQueue, m_SubmittedFrameCount);
+
+    // The lighting samples the transient targets through the frame's G-buffer set, which is not in use anymore
+    UpdateGBufferTransientDescriptor(currentFrame, GBufferTransientTargets);
+
+    m_RenderGraph.Execute(commandBuffer);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         std::cout << "Failed to end command buffer !" << '\n';
 }
 
+void Renderer::ResetTemporalHistory(VkCommandBuffer commandBuffer)
+{
+    VkImageSubresourceRange imageSubresourceRange;
+    imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageSubresourceRange.baseMipLevel = 0;
+    imageSubresourceRange.levelCount = 1;
+    imageSubresourceRange.baseArrayLayer = 0;
+    imageSubresourceRange.layerCount = 1;
+
+    VkClearColorValue fullyLit = { { 1.f, 1.f, 1.f, 1.f } };
+
+    for (auto& GBuffer : m_GBuffer.GetGBufferImages())
+        vkCmdClearColorImage(commandBuffer, GBuffer.shadowHistoryImageBuffer.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &fullyLit, 1, &imageSubresourceRange);
+}
+
 void Renderer::CleanupCommandBuffers() const
 {
     if (m_Device != VK_NULL_HANDLE && m_GraphicPool != VK_NULL_HANDLE)
@@ -1928,72 +2588,285 @@ void Renderer::CleanupCommandBuffers() const
 
 void Renderer::CreateSyncObject()
 {
+    // Binary semaphores are only left where the swap chain requires them
     m_ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     m_RenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_InFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    m_FrameSubmitCounts.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    m_FrameInputTimes.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(m_Device, &fenceInfo, nullptr, &m_InFlightFences[i]) != VK_SUCCESS) {
+            vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS) {
 
             std::cout << "Sync object creation failed !" << '\n';
         }
     }
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo{};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineInfo.pNext = &semaphoreTypeInfo;
+
+    if (vkCreateSemaphore(m_Device, &timelineInfo, nullptr, &m_GraphicsTimeline) != VK_SUCCESS ||
+        vkCreateSemaphore(m_Device, &timelineInfo, nullptr, &m_ComputeTimeline) != VK_SUCCESS) {
+
+        std::cout << "Timeline semaphore creation failed !" << '\n';
+    }
 }
 
 bool Renderer::WindowShouldClose()
 {
+    if (IsBenchmarking() && m_SubmittedFrameCount >= m_BenchmarkFrameCount)
+        return true;
+
+    if (m_Headless.enabled && !IsBenchmarking())
+        return m_SubmittedFrameCount >= m_Headless.frameCount;
+
     return glfwWindowShouldClose(m_Window.getWindow());
 }
 
-void Renderer::Draw()
+void Renderer::RecreateSwapChain()
 {
-    glfwPollEvents();
+    CPU_ZONE("RecreateSwapChain");
 
-    vkWaitForFences(m_Device, 1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
+    auto start = std::chrono::high_resolution_clock::now();
 
-    uint32_t imageIndex;
+    // The replaced images are destroyed once every frame submitted so far is done, the graph forgets them now
+    // so an image created later with a reused handle does not inherit their state
+    std::vector<VkImage> retiredImages = m_SwapChain.GetFinalImage();
+    std::vector<VkImage> sceneImages;
+    m_SwapChain.GetImages(sceneImages);
+    retiredImages.insert(retiredImages.end(), sceneImages.begin(), sceneImages.end());
+    for (auto& GBuffer : m_GBuffer.GetGBufferImages())
+    {
+        retiredImages.insert(retiredImages.end(), { GBuffer.positionImageBuffer.GetImage(), GBuffer.normalImageBuffer.GetImage(), GBuffer.shadowHistoryImageBuffer.GetImage() });
+    }
+    for (VkImage image : retiredImages)
+        m_RenderGraph.ReleaseImage(image);
+
+    m_SwapChain.RebuildSwapChain(m_PhysicalDevice, m_Allocator, m_Device, m_Surface, m_Window.getWindow(), m_QueueFamilyIndices, m_DeletionQueue, m_SubmittedFrameCount);
+    m_ResetTemporalHistory = true;
 
-    VkResult result = vkAcquireNextImageKHR(m_Device, m_SwapChain.GetSwapChain(), UINT64_MAX,
-        m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+    // Pipelines and attachments are bound by format only, resizing just reallocates the images
+    auto extent = m_SwapChain.GetExtent();
+    m_GBuffer.ReBuildGBuffer(MAX_FRAMES_IN_FLIGHT, extent.width, extent.height, m_Allocator, m_Device, { m_QueueFamilyIndices.graphicsFamily.value() }, m_DeletionQueue, m_SubmittedFrameCount);
 
+    m_SwapChain.CreateImGuiImageDescriptor(m_Device);
+
+    // A frame's descriptor sets may still be bound by its command buffer in flight, each one is rewritten once its fence is waited
+    m_OutdatedFrameDescriptors = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+
+    m_LastResizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Renderer::UpdateFrameDescriptors(uint32_t frame)
+{
     std::vector<VkImageView> ImageViews;
+    m_SwapChain.GetImageViews(ImageViews);
+
+    if (m_RayTracingAccelerationStructure)
+        m_RayTracingAccelerationStructure->UpdateImageDescriptor(m_Device, ImageViews[frame], frame);
+    m_ComputeLighting->UpdateImageDescriptor(m_Device, ImageViews[frame], frame);
+
+    UpdateGBufferDescriptor(frame);
+}
+
+void Renderer::UpdateCompletedFrames()
+{
+    uint64_t completedFrameCount = m_CompletedFrameCount;
+    vkGetSemaphoreCounterValue(m_Device, m_GraphicsTimeline, &completedFrameCount);
+
+    // Seen done now, at the latest: exact when the CPU was blocked on it, an upper bound otherwise
+    auto now = std::chrono::high_resolution_clock::now();
+    for (uint64_t frame = m_CompletedFrameCount + 1; frame <= completedFrameCount; frame++)
+    {
+        m_InputLatency = std::chrono::duration<double, std::milli>(now - m_FrameInputTimes[frame % MAX_FRAMES_IN_FLIGHT]).count();
+        m_AverageInputLatency += 0.05 * (m_InputLatency - m_AverageInputLatency);
+    }
+
+    m_CompletedFrameCount = std::max(m_CompletedFrameCount, completedFrameCount);
+}
+
+void Renderer::WaitForFrame(uint64_t frame)
+{
+    CPU_ZONE("Wait frame");
+
+    UpdateCompletedFrames();
+
+    if (m_CompletedFrameCount >= frame)
+        return;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_GraphicsTimeline;
+    waitInfo.pValues = &frame;
+
+    if (vkWaitSemaphores(m_Device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+        std::cout << "Failed to wait for frame " << frame << " !" << '\n';
+
+    UpdateCompletedFrames();
+}
+
+void Renderer::CreateCaptureBuffers()
+{
+    if (m_Headless.capturedFrames.empty())
+        return;
+
+    VkExtent2D extent = m_SwapChain.GetExtent();
+
+    // One per frame slot, a capture is written out before its slot records again
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    m_CaptureBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
-    {
-        m_SwapChain.RebuildSwapChain(m_PhysicalDevice, m_Allocator, m_Device, m_Surface, m_Window.getWindow(), m_QueueFamilyIndices);
-        m_freshRT.fill(true);
-        m_SwapChain.GetImageViews(ImageViews);
-        m_RayTracingAccelerationStructure->UpdateImageDescriptor(m_Device, ImageViews);
-        CleanupCommandBuffers();
-        m_DepthImage.Cleanup(m_Allocator, m_Device);
-        CreateDepthRessources();
-        auto extent = m_SwapChain.GetExtent();
-        m_GBuffer.ReBuildGBuffer(MAX_FRAMES_IN_FLIGHT, extent.width, extent.height, m_Allocator, m_Device, { m_QueueFamilyIndices.graphicsFamily.value() });
-        m_SwapChain.CreateFramebuffer(m_Device, m_RenderPass.getRenderPass(), m_FinalRenderPass.getRenderPass(), m_GBuffer, m_DepthImage.GetImageView());
-        CreateCommandBuffers();
-        UpdateGBufferDescriptor();
-        m_SwapChain.CreateImGuiImageDescriptor(m_Device);
+    for (StorageBuffer& captureBuffer : m_CaptureBuffers)
+    {
+        if (vmaCreateBuffer(m_Allocator, &bufferInfo, &allocInfo, &captureBuffer.buffer, &captureBuffer.memory, &captureBuffer.memoryInfo) != VK_SUCCESS)
+            std::cout << "Capture buffer creation failed !" << '\n';
+    }
+
+    std::filesystem::create_directories(m_Headless.outputDirectory);
+}
+
+void Renderer::WriteCompletedCaptures()
+{
+    CPU_ZONE("Write captures");
+
+    VkExtent2D extent = m_SwapChain.GetExtent();
+
+    auto capture = m_PendingCaptures.begin();
+    while (capture != m_PendingCaptures.end())
+    {
+        if (capture->frame > m_CompletedFrameCount)
+        {
+            ++capture;
+            continue;
+        }
+
+        const StorageBuffer& captureBuffer = m_CaptureBuffers[capture->slot];
+        vmaInvalidateAllocation(m_Allocator, captureBuffer.memory, 0, VK_WHOLE_SIZE);
+
+        // The lighting leaves alpha undefined, the images are compared as opaque
+        unsigned char* pixels = static_cast<unsigned char*>(captureBuffer.memoryInfo.pMappedData);
+        for (size_t i = 0; i < static_cast<size_t>(extent.width) * extent.height; i++)
+            pixels[4 * i + 3] = 255;
+
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "/frame_%05llu.png", static_cast<unsigned long long>(capture->frame));
+        std::string path = m_Headless.outputDirectory + fileName;
+
+        if (!stbi_write_png(path.c_str(), static_cast<int>(extent.width), static_cast<int>(extent.height), 4, pixels, static_cast<int>(extent.width) * 4))
+            std::cout << "Capture " << path << " write failed !" << '\n';
+
+        capture = m_PendingCaptures.erase(capture);
+    }
+}
+
+bool Renderer::IsScripted()
+{
+    return m_Headless.enabled || IsBenchmarking();
+}
+
+bool Renderer::IsBenchmarking()
+{
+    return m_BenchmarkFrameCount > 0;
+}
+
+void Renderer::UpdateScriptedCamera(uint64_t frame)
+{
+    if (IsBenchmarking())
+    {
+        glm::vec3 position, target;
+        uint64_t measuredFrame = frame > m_Benchmark.warmupFrames ? frame - m_Benchmark.warmupFrames - 1 : 0;
+        m_CameraPath.Evaluate(static_cast<double>(measuredFrame) * SCRIPTED_TIME_STEP, position, target);
+
+        m_Camera->LookAt(position, target);
         return;
     }
-    else if (result != VK_SUCCESS) {
-        std::cout << "Failed to acquire next image !" << '\n';
+
+    // One orbit around the scene over the whole run
+    double angle = 2. * glm::pi<double>() * static_cast<double>(frame) / static_cast<double>(std::max<uint32_t>(m_Headless.frameCount, 1));
+    glm::vec3 target = glm::vec3(10.f, 0.f, 0.f);
+    glm::vec3 position = target + glm::vec3(static_cast<float>(cos(angle)) * 30.f, 8.f, static_cast<float>(sin(angle)) * 30.f);
+
+    m_Camera->LookAt(position, target);
+}
+
+void Renderer::FinishBenchmark()
+{
+    // Slots in submission order, each one still holding a frame that was never read
+    std::vector<uint32_t> slots(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        slots[i] = i;
+    std::sort(slots.begin(), slots.end(), [&](uint32_t a, uint32_t b) { return m_FrameSubmitCounts[a] < m_FrameSubmitCounts[b]; });
+
+    for (uint32_t slot : slots)
+    {
+        if (m_GpuProfiler.ReadResults(m_Device, slot) && m_FrameSubmitCounts[slot] > m_Benchmark.warmupFrames)
+            m_BenchmarkRecorder.AddGpuTime(m_GpuProfiler.GetFrameTime());
     }
 
-    m_DeltaTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_LastTime).count();
-    m_LastTime = std::chrono::high_resolution_clock::now();
-    ProcessKeyInput();
+    if (m_BenchmarkRecorder.Export(m_Benchmark.outputPath, SCRIPTED_TIME_STEP, m_Benchmark.warmupFrames))
+        std::cout << "Benchmark of " << m_BenchmarkRecorder.GetCpuFrameCount() << " frames written to " << m_Benchmark.outputPath << '\n';
+}
 
-    m_Camera->UpdatePosition(static_cast<float>(m_DeltaTime));
-    UpdateUniform();
+void Renderer::LimitFrameRate()
+{
+    CPU_ZONE("Frame rate limit");
+
+    auto now = std::chrono::high_resolution_clock::now();
+
+    if (m_FrameRateLimit <= 0)
+    {
+        m_NextFrameStart = now;
+        return;
+    }
+
+    // The scheduler wakes up late, sleep until a millisecond before and yield the rest
+    auto sleepEnd = m_NextFrameStart - std::chrono::milliseconds(1);
+    if (now < sleepEnd)
+        std::this_thread::sleep_until(sleepEnd);
+
+    while (std::chrono::high_resolution_clock::now() < m_NextFrameStart)
+        std::this_thread::yield();
+
+    // A late frame does not make the next ones shorter to catch up
+    auto frameStart = std::max(m_NextFrameStart, std::chrono::high_resolution_clock::now());
+    auto frameTime = std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(1. / m_FrameRateLimit));
+    m_NextFrameStart = frameStart + frameTime;
+}
+
+double Renderer::GetPresentLatencyEstimate()
+{
+    double refreshInterval = 1000. / m_RefreshRate;
+
+    // Immediate shows the frame as soon as it is done, the tear line lands mid screen on average.
+    // The other modes wait for the next vblank, half a refresh on average, then scan out down to mid screen
+    if (m_SwapChain.GetPresentMode() == VK_PRESENT_MODE_IMMEDIATE_KHR)
+        return 0.5 * refreshInterval;
+
+    return refreshInterval;
+}
+
+ImDrawData* Renderer::BuildUserInterface()
+{
+    CPU_ZONE("ImGui build");
 
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -2008,8 +2881,177 @@ void Renderer::Draw()
 
         ImGui::Checkbox("Wireframe", &m_Wireframe);
 
+        ImGui::BeginDisabled(m_MeshletCount == 0);
+        ImGui::Checkbox("Mesh shading", &m_MeshShading);
+        ImGui::EndDisabled();
+
+        if (m_MeshletCount > 0)
+            ImGui::Text("Meshlets: %u", m_MeshletCount);
+
+        ImGui::SliderFloat("LOD error (px)", &m_LodPixelError, 0., 16.);
+        ImGui::Text("Triangles: %u", m_LodTriangleCount);
+
         ImGui::SliderFloat("CameraSpeed", m_Camera->GetSpeed(), 0., 100.);
 
+        if (ImGui::Checkbox("Temporal shadows", &m_TemporalShadows))
+            m_ResetTemporalHistory = true;
+
+        const char* lightingPaths[] = { "Ray tracing", "Compute", "Compute (ray query)" };
+        int lightingPath = static_cast<int>(m_LightingPath);
+        int lightingPathCount = m_RayQuerySupported ? 3 : 2;
+
+        ImGui::BeginDisabled(!m_RayTracingSupported);
+        if (ImGui::Combo("Lighting", &lightingPath, lightingPaths, lightingPathCount))
+        {
+            m_LightingPath = static_cast<LightingPath>(lightingPath);
+            // Only the ray traced path keeps the shadow history up to date
+            m_ResetTemporalHistory = true;
+        }
+        ImGui::EndDisabled();
+
+        const char* shadowTechniques[] = { "Ray traced", "Shadow map" };
+
+        for (size_t i = 0; i < m_DirectionalLights.size(); i++)
+        {
+            int shadowTechnique = static_cast<int>(m_DirectionalLights[i].GetShadowTechnique());
+            std::string label = "Directional light " + std::to_string(i) + " shadows";
+
+            // Cascades only follow the first directional light, without ray tracing the others stay unshadowed
+            ImGui::BeginDisabled(!m_RayTracingSupported || i > 0);
+            if (ImGui::Combo(label.c_str(), &shadowTechnique, shadowTechniques, IM_ARRAYSIZE(shadowTechniques)))
+                m_DirectionalLights[i].SetShadowTechnique(static_cast<ShadowTechnique>(shadowTechnique));
+            ImGui::EndDisabled();
+        }
+
+        ImGui::SliderFloat("Shadow distance", &m_ShadowDistance, 10.f, 1000.f);
+
+        if (m_Skinning->HasSkinnedMeshes())
+            ImGui::Text("Animated meshes: %u", m_Skinning->GetSkinnedMeshCount());
+
+        ImGui::BeginDisabled(!m_Skinning->HasSkinnedMeshes() && !m_RayTracingAccelerationStructure);
+        ImGui::Checkbox("Async compute (skinning, AS refit)", &m_AsyncCompute);
+        ImGui::EndDisabled();
+
+        // Fewer frames in flight trade throughput for latency, the per-frame resources stay allocated for MAX_FRAMES_IN_FLIGHT
+        ImGui::SliderInt("Frames in flight", &m_FramesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+        ImGui::Text("Input to GPU done: %.2f ms (avg %.2f ms)", m_InputLatency, m_AverageInputLatency);
+
+        const std::vector<VkPresentModeKHR>& presentModes = m_SwapChain.GetSupportedPresentModes();
+        VkPresentModeKHR requestedPresentMode = m_SwapChain.GetRequestedPresentMode();
+
+        if (ImGui::BeginCombo("Present mode", SwapChain::GetPresentModeName(m_SwapChain.GetPresentMode())))
+        {
+            for (VkPresentModeKHR presentMode : presentModes)
+            {
+                if (ImGui::Selectable(SwapChain::GetPresentModeName(presentMode), presentMode == requestedPresentMode) && presentMode != requestedPresentMode)
+                {
+                    m_SwapChain.SetPresentMode(presentMode);
+                    m_PresentModeChanged = true;
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        // Capped a bit under the refresh rate, FIFO never queues frames and each one is sampled as late as it can be
+        ImGui::SliderInt("Frame rate limit", &m_FrameRateLimit, 0, 2 * m_RefreshRate, m_FrameRateLimit > 0 ? "%d fps" : "Off");
+        ImGui::SameLine();
+        if (ImGui::Button("Refresh rate"))
+            m_FrameRateLimit = m_RefreshRate;
+
+        ImGui::Text("Input to photon (estimate): %.2f ms at %d Hz", m_AverageInputLatency + GetPresentLatencyEstimate(), m_RefreshRate);
+
+        if (m_LastResizeTime > 0.)
+            ImGui::Text("Last resize: %.3f ms (%zu deferred deletions)", m_LastResizeTime, m_DeletionQueue.GetPendingCount());
+
+        for (const auto& result : m_GpuProfiler.GetResults())
+            ImGui::Text("%s: %.3f ms (avg %.3f, min %.3f, p99 %.3f)", result.name.c_str(), result.milliseconds, result.average, result.minimum, result.p99);
+
+        if (ImGui::CollapsingHeader("GPU history"))
+        {
+            for (const auto& result : m_GpuProfiler.GetResults())
+            {
+                char overlay[32];
+                snprintf(overlay, sizeof(overlay), "p99 %.3f ms", result.p99);
+                ImGui::PlotLines(result.name.c_str(), result.history.data(), static_cast<int>(result.history.size()), static_cast<int>(result.historyOffset),
+                    overlay, 0.f, static_cast<float>(result.p99) * 1.5f, ImVec2(0.f, 40.f));
+            }
+        }
+
+        ImGui::BeginDisabled(m_GpuProfiler.GetResults().empty());
+        if (ImGui::Button("Export CSV"))
+            m_GpuProfiler.ExportCsv("gpu_profile.csv");
+        ImGui::SameLine();
+        if (ImGui::Button("Export JSON"))
+            m_GpuProfiler.ExportJson("gpu_profile.json");
+        ImGui::EndDisabled();
+
+        // Zones of the last frames and of the loading when the capture started on the command line
+        bool cpuZones = CpuProfiler::IsEnabled();
+        if (ImGui::Checkbox("CPU zones", &cpuZones))
+            CpuProfiler::SetEnabled(cpuZones);
+        ImGui::SameLine();
+        if (ImGui::Button("Export CPU trace"))
+            CpuProfiler::ExportChromeTrace("cpu_trace.json");
+
+        // Scopes of both queues on one time axis, async compute overlapping the graphics passes shows up as stacked bars
+        double frameEnd = m_GpuProfiler.GetFrameTime();
+
+        if (frameEnd > 0.)
+        {
+            ImDrawList* drawList = ImGui::GetWindowDrawList();
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            float width = std::max(ImGui::GetContentRegionAvail().x, 1.f);
+            float rowHeight = ImGui::GetTextLineHeight() + 2.f;
+            float rowCount = 0.f;
+
+            for (const auto& result : m_GpuProfiler.GetResults())
+            {
+                if (!result.current)
+                    continue;
+
+                float x0 = origin.x + static_cast<float>(result.start / frameEnd) * width;
+                float x1 = std::max(origin.x + static_cast<float>(result.end / frameEnd) * width, x0 + 1.f);
+                float y = origin.y + rowCount * rowHeight;
+                bool asyncScope = result.name.find("async") != std::string::npos;
+
+                drawList->AddRectFilled(ImVec2(x0, y), ImVec2(x1, y + rowHeight - 2.f), asyncScope ? IM_COL32(200, 120, 40, 255) : IM_COL32(60, 120, 200, 255));
+                drawList->AddText(ImVec2(origin.x, y), IM_COL32_WHITE, result.name.c_str());
+
+                rowCount += 1.f;
+            }
+
+            ImGui::Dummy(ImVec2(width, rowCount * rowHeight));
+            ImGui::Text("Frame graph: %.3f ms", frameEnd);
+        }
+
+        // Keyframes for the benchmark, taken from the live camera
+        if (ImGui::CollapsingHeader("Camera path"))
+        {
+            ImGui::BeginDisabled(IsBenchmarking());
+            ImGui::Text("%zu keyframes, %.2f s", m_CameraPath.GetKeyframeCount(), m_CameraPath.GetDuration());
+            ImGui::InputDouble("Keyframe spacing (s)", &m_RecordedKeyframeSpacing, 0.5, 1., "%.2f");
+            m_RecordedKeyframeSpacing = std::max(m_RecordedKeyframeSpacing, 0.01);
+
+            if (ImGui::Button("Add keyframe"))
+            {
+                CameraKeyframe keyframe;
+                keyframe.time = m_CameraPath.IsEmpty() ? 0. : m_CameraPath.GetDuration() + m_RecordedKeyframeSpacing;
+                keyframe.position = m_Camera->GetPosition();
+                keyframe.target = m_Camera->GetPosition() + m_Camera->GetForward();
+                m_CameraPath.AddKeyframe(keyframe);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear"))
+                m_CameraPath.Clear();
+            ImGui::SameLine();
+            if (ImGui::Button("Save"))
+                m_CameraPath.Save("camera_path.json");
+            ImGui::EndDisabled();
+
+            if (IsBenchmarking())
+                ImGui::Text("Benchmark: frame %llu / %llu", static_cast<unsigned long long>(m_SubmittedFrameCount), static_cast<unsigned long long>(m_BenchmarkFrameCount));
+        }
+
         ImGui::End();
     }
 
@@ -2048,39 +3090,183 @@ void Renderer::Draw()
     }
 
     ImGui::Render();
-    ImDrawData* main_draw_data = ImGui::GetDrawData();
+
+    return ImGui::GetDrawData();
+}
+
+void Renderer::Draw()
+{
+    CPU_ZONE("Draw");
+
+    LimitFrameRate();
+
+    // The slot's previous frame is always among the m_FramesInFlight last ones, the CPU only blocks once it got that far ahead
+    uint64_t frameValue = m_SubmittedFrameCount + 1;
+    uint64_t framesInFlight = static_cast<uint64_t>(m_FramesInFlight);
+    WaitForFrame(std::max(frameValue > framesInFlight ? frameValue - framesInFlight : 0, m_FrameSubmitCounts[m_CurrentFrame]));
+
+    m_DeletionQueue.Flush(m_CompletedFrameCount);
+
+    if (m_OutdatedFrameDescriptors & (1u << m_CurrentFrame))
+    {
+        UpdateFrameDescriptors(m_CurrentFrame);
+        m_OutdatedFrameDescriptors &= ~(1u << m_CurrentFrame);
+    }
+
+    // The slot's queries belong to the frame it was last submitted with
+    if (m_GpuProfiler.ReadResults(m_Device, m_CurrentFrame) && IsBenchmarking() && m_FrameSubmitCounts[m_CurrentFrame] > m_Benchmark.warmupFrames)
+        m_BenchmarkRecorder.AddGpuTime(m_GpuProfiler.GetFrameTime());
+
+    // Host time of the frame, the waits on the GPU and on the swap chain left out
+    auto cpuStart = std::chrono::high_resolution_clock::now();
+    std::chrono::high_resolution_clock::duration acquireTime{};
+
+    if (m_Headless.enabled)
+        WriteCompletedCaptures();
+
+    uint32_t imageIndex = 0;
+    VkResult result = VK_SUCCESS;
+
+    // Offscreen frames end in the scene image, there is no swap chain image to acquire
+    if (!m_Headless.enabled)
+    {
+        auto acquireStart = std::chrono::high_resolution_clock::now();
+        {
+            CPU_ZONE("Acquire");
+            result = vkAcquireNextImageKHR(m_Device, m_SwapChain.GetSwapChain(), UINT64_MAX,
+                m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
+        acquireTime = std::chrono::high_resolution_clock::now() - acquireStart;
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // No frame this time, the window events still have to be processed
+            glfwPollEvents();
+            RecreateSwapChain();
+            return;
+        }
+        else if (result != VK_SUCCESS) {
+            std::cout << "Failed to acquire next image !" << '\n';
+        }
+
+        // Input is sampled once every wait of the frame is behind, FIFO back pressure in the acquire included.
+        // The frame's latency runs from here to the GPU being done with it
+        CPU_ZONE("Poll events");
+        glfwPollEvents();
+    }
+
+    auto inputTime = std::chrono::high_resolution_clock::now();
+
+    if (IsScripted())
+    {
+        // Fixed timestep, every run renders the same frames whatever the device speed
+        m_DeltaTime = SCRIPTED_TIME_STEP;
+        UpdateScriptedCamera(frameValue);
+    }
+    else
+    {
+        m_DeltaTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_LastTime).count();
+        m_LastTime = std::chrono::high_resolution_clock::now();
+        ProcessKeyInput();
+
+        m_Camera->UpdatePosition(static_cast<float>(m_DeltaTime));
+    }
+
+    // The user interface below may ask for a reset again, it goes to the next frame
+    m_ResetTemporalHistoryFrame = m_ResetTemporalHistory;
+    m_ResetTemporalHistory = false;
+
+    UpdateUniform();
+
+    ImDrawData* main_draw_data = nullptr;
+    if (!m_Headless.enabled)
+        main_draw_data = BuildUserInterface();
+
+    // Before either command buffer is recorded, both take their scopes from this frame's queries
+    m_GpuProfiler.BeginFrame(m_Device, m_CurrentFrame);
 
     vkResetCommandBuffer(m_CommandBuffers[m_CurrentFrame], 0);
 
     RecordCommandBuffer(m_CommandBuffers[m_CurrentFrame], m_CurrentFrame, imageIndex, main_draw_data);
 
-    VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentFrame] };
+    if (m_AsyncCompute)
+        RecordComputeCommandBuffers(m_CurrentFrame);
+
+    SubmitCompute(m_CurrentFrame);
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<uint64_t> waitValues;
+    // Signaled every frame, so turning async compute on never races the frame still in flight
+    std::vector<VkSemaphore> signalSemaphores = { m_GraphicsTimeline };
+    std::vector<uint64_t> signalValues = { frameValue };
+
+    // Binary semaphores ignore their value, offscreen frames neither wait on an acquire nor signal a present
+    if (!m_Headless.enabled)
+    {
+        waitSemaphores.push_back(m_ImageAvailableSemaphores[m_CurrentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        waitValues.push_back(0);
+        signalSemaphores.push_back(m_RenderFinishedSemaphores[m_CurrentFrame]);
+        signalValues.push_back(0);
+    }
+
+    if (m_AsyncCompute)
+    {
+        // Skinned vertices are read from the shadow cascades on, the acceleration structures only by the lighting
+        // so their refit overlaps the shadow and G-buffer passes
+        waitSemaphores.push_back(m_ComputeTimeline);
+        waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        waitValues.push_back(m_ComputeTimelineValue - 1);
+        waitSemaphores.push_back(m_ComputeTimeline);
+        waitStages.push_back(m_LightingPipelineStages);
+        waitValues.push_back(m_ComputeTimelineValue);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
 
     VkSubmitInfo submitsInfo;
     submitsInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitsInfo.pNext = NULL;
-    submitsInfo.waitSemaphoreCount = 1;
-    submitsInfo.pWaitSemaphores = waitSemaphores;
-    submitsInfo.pWaitDstStageMask = waitStages;
+    submitsInfo.pNext = &timelineInfo;
+    submitsInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitsInfo.pWaitSemaphores = waitSemaphores.data();
+    submitsInfo.pWaitDstStageMask = waitStages.data();
     submitsInfo.commandBufferCount = 1;
     submitsInfo.pCommandBuffers = &m_CommandBuffers[m_CurrentFrame];
-    submitsInfo.signalSemaphoreCount = 1;
-    submitsInfo.pSignalSemaphores = signalSemaphores;
-
-    vkResetFences(m_Device, 1, &m_InFlightFences[m_CurrentFrame]);
+    submitsInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitsInfo.pSignalSemaphores = signalSemaphores.data();
 
     // Soumettre les commandes
-    if (vkQueueSubmit(m_GraphicsQueue, 1, &submitsInfo, m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS) {
-        std::cout << "Failed to submit draw command buffer!" << '\n';
+    {
+        CPU_ZONE("Submit");
+        if (vkQueueSubmit(m_GraphicsQueue, 1, &submitsInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            std::cout << "Failed to submit draw command buffer!" << '\n';
+        }
+    }
+
+    if (IsBenchmarking() && frameValue > m_Benchmark.warmupFrames)
+        m_BenchmarkRecorder.AddCpuTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cpuStart - acquireTime).count());
+
+    m_SubmittedFrameCount = frameValue;
+    m_FrameSubmitCounts[m_CurrentFrame] = frameValue;
+    m_FrameInputTimes[frameValue % MAX_FRAMES_IN_FLIGHT] = inputTime;
+
+    if (m_Headless.enabled)
+    {
+        m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        return;
     }
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &m_RenderFinishedSemaphores[m_CurrentFrame];
 
     VkSwapchainKHR swapChains[] = { m_SwapChain.GetSwapChain() };
     presentInfo.swapchainCount = 1;
@@ -2088,25 +3274,17 @@ void Renderer::Draw()
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr; // Optionnel
 
-    result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_FramebufferResized)
-    {
-        m_SwapChain.RebuildSwapChain(m_PhysicalDevice, m_Allocator, m_Device, m_Surface, m_Window.getWindow(), m_QueueFamilyIndices);
-        m_freshRT.fill(true);
-        m_SwapChain.GetImageViews(ImageViews);
-        m_RayTracingAccelerationStructure->UpdateImageDescriptor(m_Device, ImageViews);
-        CleanupCommandBuffers();
-        m_DepthImage.Cleanup(m_Allocator, m_Device);
-        CreateDepthRessources();
-        auto extent = m_SwapChain.GetExtent();
-        m_GBuffer.ReBuildGBuffer(MAX_FRAMES_IN_FLIGHT, extent.width, extent.height, m_Allocator, m_Device, { m_QueueFamilyIndices.graphicsFamily.value() });
-        m_SwapChain.CreateFramebuffer(m_Device, m_RenderPass.getRenderPass(), m_FinalRenderPass.getRenderPass(), m_GBuffer, m_DepthImage.GetImageView());
-        CreateCommandBuffers();
-        UpdateGBufferDescriptor();
-        m_SwapChain.CreateImGuiImageDescriptor(m_Device);
+    {
+        CPU_ZONE("Present");
+        result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+    }
+
+    // The frame was submitted, the next one moves on to the following slot instead of waiting on this one
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_FramebufferResized || m_PresentModeChanged)
+    {
+        RecreateSwapChain();
         m_FramebufferResized = false;
-        return;
+        m_PresentModeChanged = false;
     }
     else if (result != VK_SUCCESS) {
         std::cout << "Failed to present image!" << '\n';
@@ -2117,12 +3295,32 @@ void Renderer::Draw()
 
 void Renderer::UpdateUniform()
 {
+    CPU_ZONE("UpdateUniform");
+
+    m_SceneUniform.prevView = m_SceneUniform.view;
+    m_SceneUniform.prevProjection = m_SceneUniform.projection;
     m_SceneUniform.view = m_Camera->GetView();
     m_SceneUniform.projection = m_Camera->GetProjection();
     m_SceneUniform.position = m_Camera->GetPosition();
-    m_SceneUniform.time = (float) clock() / CLOCKS_PER_SEC;
+    m_SceneUniform.time = IsScripted() ? static_cast<float>(m_FrameIndex * SCRIPTED_TIME_STEP) : (float) clock() / CLOCKS_PER_SEC;
     m_SceneUniform.numDirectionalLights = static_cast<int>(m_DirectionalLights.size());
     m_SceneUniform.numPointLights = static_cast<int>(m_PointLights.size());
+    m_SceneUniform.frameIndex = static_cast<int>(m_FrameIndex++);
+    m_SceneUniform.historyValid = m_ResetTemporalHistoryFrame ? 0 : 1;
+    m_SceneUniform.temporalShadows = m_TemporalShadows ? 1 : 0;
+
+    m_Skinning->Update(m_CurrentFrame, m_SceneUniform.time);
+
+    if (!m_DirectionalLights.empty())
+    {
+        m_CascadedShadowMap->Update(m_Camera, m_DirectionalLights[0].GetDirection(), m_ShadowDistance);
+
+        const auto& cascadeViewProjections = m_CascadedShadowMap->GetViewProjections();
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+            m_SceneUniform.cascadeViewProj[i] = cascadeViewProjections[i];
+        m_SceneUniform.cascadeSplits = m_CascadedShadowMap->GetSplits();
+        m_SceneUniform.cascadeTexelSizes = m_CascadedShadowMap->GetTexelSizes();
+    }
 
     glm::vec3 lPos = glm::vec3(cos(m_SceneUniform.time) * 7., 5., sin(m_SceneUniform.time) * 7.);
     
@@ -2145,39 +3343,47 @@ void Renderer::UpdateUniform()
         uniformPointLights.emplace_back(pointLight.GetUniformPointLight());
     memcpy(lightsAllocationInfos[static_cast<size_t>(2) * m_CurrentFrame + 1].pMappedData, uniformPointLights.data(), sizeof(UniformPointLight) * m_PointLights.size());
     
-    m_RayTracingAccelerationStructure->UpdateUniform(glm::inverse(m_Camera->GetView()), glm::inverse(m_Camera->GetProjection()), m_CurrentFrame, m_Meshes);
+    if (m_RayTracingAccelerationStructure)
+        m_RayTracingAccelerationStructure->UpdateUniform(glm::inverse(m_Camera->GetView()), glm::inverse(m_Camera->GetProjection()), m_CurrentFrame, m_Meshes);
 
     if (!m_Meshes.empty())
     {
-
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
-        VkDeviceSize minSize = properties.limits.minUniformBufferOffsetAlignment;
-
-        uint64_t paddedSize = (sizeof(glm::mat4) + minSize - 1) & ~(minSize - 1);;
-
-        char* modelsData = static_cast<char*>(malloc(m_Meshes.size() * paddedSize));
-
         m_Meshes[0]->SetModel(glm::rotate(m_Meshes[0]->GetModel(), glm::radians<float>(static_cast<float>(m_DeltaTime) * 32.36f), glm::vec3(0., 1., 0.)));
 
         m_Meshes[1]->SetModel(glm::scale(glm::translate(glm::mat4(1.f), lPos), glm::vec3(0.2f)));
 
         m_Meshes.back()->SetModel(glm::rotate(m_Meshes.back()->GetModel(), glm::radians<float>(static_cast<float>(m_DeltaTime) * 32.36f), glm::vec3(0., 1., 0.)));
         
-        std::vector transforms = { m_Meshes[0]->GetModel(), m_Meshes[1]->GetModel(), m_Meshes.back()->GetModel() };
-        std::vector<uint32_t> transformIndexs = { 0, 1, static_cast<uint32_t>(m_Meshes.size() - 1) };
-        m_RayTracingAccelerationStructure->UpdateTransform(m_CurrentFrame, transformIndexs, transforms, {true});
+        // Pixels covered by one world unit at a distance of one, along the height of the screen
+        float projectionScale = static_cast<float>(m_SwapChain.GetExtent().height) / (2.f * std::tan(glm::radians(static_cast<float>(m_Camera->GetFov())) * 0.5f));
 
-        for (size_t i = 0; i < m_Meshes.size(); i++)
+        m_LodTriangleCount = 0;
+
+        for (Mesh* mesh : m_Meshes)
         {
-            uint64_t bufferSize = sizeof(glm::mat4);
-            char* p = modelsData + i * paddedSize;
-            memcpy(p, &(m_Meshes[i]->GetModel()), bufferSize);
+            uint32_t lod = mesh->SelectLod(m_Camera->GetPosition(), projectionScale, m_LodPixelError);
+
+            for (size_t i = 0; i < mesh->GetPrimitives().size(); i++)
+                m_LodTriangleCount += mesh->GetPrimitiveLod(i, lod).indexCount / 3;
         }
 
-        memcpy(m_PerMeshDescriptor.GetUniformAllocationInfos()[m_CurrentFrame].pMappedData, modelsData, m_Meshes.size() * paddedSize);
+        if (m_RayTracingAccelerationStructure)
+            m_RayTracingAccelerationStructure->UpdateTransforms(m_CurrentFrame, m_Meshes);
 
-        free(modelsData);
+        // This frame's fence has been waited on, its region of the ring can be reused
+        m_FrameAllocator.BeginFrame(m_CurrentFrame);
+
+        LinearAllocation modelsAllocation = m_FrameAllocator.Allocate(m_Meshes.size() * sizeof(glm::mat4));
+
+        if (modelsAllocation.data)
+        {
+            glm::mat4* models = static_cast<glm::mat4*>(modelsAllocation.data);
+
+            for (size_t i = 0; i < m_Meshes.size(); i++)
+                models[i] = m_Meshes[i]->GetModel();
+
+            m_ModelsOffset = static_cast<uint32_t>(modelsAllocation.offset);
+        }
     }
 }
 
@@ -2223,7 +3429,7 @@ void Renderer::ProcessKeyInput()
         m_KeyPressedMap[i].previous = m_KeyPressedMap[i].current;
 }
 
-bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device)
+bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions)
 {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -2231,7 +3437,7 @@ bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device)
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -2254,10 +3460,11 @@ bool Renderer::isDeviceSuitable(VkPhysicalDevice device)
     
     vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
 
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
+    bool extensionsSupported = checkDeviceExtensionSupport(device, deviceExtensions);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    // Offscreen, any device able to render will do, software implementations included
+    bool swapChainAdequate = m_Headless.enabled;
+    if (extensionsSupported && !m_Headless.enabled && checkDeviceExtensionSupport(device, presentDeviceExtensions)) {
         SwapChainSupportDetails swapChainSupport = m_SwapChain.QuerySupportDetails(device, m_Surface);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
@@ -2270,3 +3477,58 @@ bool Renderer::isDeviceSuitable(VkPhysicalDevice device)
 
     return suitable;
 }
+
+bool Renderer::checkRayTracingSupport(VkPhysicalDevice device)
+{
+    if (!checkDeviceExtensionSupport(device, rayTracingDeviceExtensions))
+        return false;
+
+    VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+    accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+
+    VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures{};
+    rayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+    rayTracingPipelineFeatures.pNext = &accelerationStructureFeatures;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &rayTracingPipelineFeatures;
+
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+    return rayTracingPipelineFeatures.rayTracingPipeline && accelerationStructureFeatures.accelerationStructure;
+}
+
+bool Renderer::checkRayQuerySupport(VkPhysicalDevice device)
+{
+    if (!checkDeviceExtensionSupport(device, rayQueryDeviceExtensions))
+        return false;
+
+    VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{};
+    rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &rayQueryFeatures;
+
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+    return rayQueryFeatures.rayQuery;
+}
+
+bool Renderer::checkMeshShaderSupport(VkPhysicalDevice device)
+{
+    if (!checkDeviceExtensionSupport(device, meshShaderDeviceExtensions))
+        return false;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &meshShaderFeatures;
+
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
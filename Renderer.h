@@ -5,7 +5,6 @@
 #include "GlfwWindow.h"
 #include "QueueVulkan.h"
 #include "SwapChain.h"
-#include "RenderPass.h"
 #include "Shader.h"
 #include "Mesh.h"
 #include "Materials.h"
@@ -15,6 +14,16 @@
 #include "GBuffer.h"
 #include "CubeMap.h"
 #include "RayTracingAccelerationStructure.h"
+#include "ComputeLighting.h"
+#include "CascadedShadowMap.h"
+#include "Skinning.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "LinearAllocator.h"
+#include "RenderGraph.h"
+#include "DeletionQueue.h"
+#include "CameraPath.h"
+#include "Benchmark.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -37,12 +46,31 @@ const std::vector<std::string> wantedLayers = { "VK_LAYER_LUNARG_monitor" };
 #endif
 
 const std::vector<const char*> deviceExtensions = {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 	VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
+	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,  // Required for descriptor indexing in ray tracing
+	VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,  // Core in 1.3, ImGui loads the KHR entry points
+};
+
+// Not needed offscreen
+const std::vector<const char*> presentDeviceExtensions = {
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+};
+
+// Optional: without them lighting falls back to the compute path
+const std::vector<const char*> rayTracingDeviceExtensions = {
 	VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
 	VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
 	VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
-	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,  // Required for descriptor indexing in ray tracing
+};
+
+// Optional on top of ray tracing: shadow rays traced inline from the compute lighting path
+const std::vector<const char*> rayQueryDeviceExtensions = {
+	VK_KHR_RAY_QUERY_EXTENSION_NAME,
+};
+
+// Optional: without it the G-buffer is only drawn through the vertex pipeline
+const std::vector<const char*> meshShaderDeviceExtensions = {
+	VK_EXT_MESH_SHADER_EXTENSION_NAME,
 };
 
 struct VulkanRayTracingFunctions {
@@ -55,6 +83,50 @@ struct VulkanRayTracingFunctions {
 
 #define MAX_FRAMES_IN_FLIGHT 3
 
+#define MAX_GPU_TIMER_SCOPES 10
+
+// Seconds of animation between two scripted frames, offscreen or along a camera path
+#define SCRIPTED_TIME_STEP (1. / 60.)
+
+#define SHADOW_MAP_RESOLUTION 2048
+
+// Skinning stress test: copies of this character are spread on a grid, each one skinned and refit on its own
+#define ANIMATED_CHARACTER_PATH "./Models/GLTF/CesiumMan/glTF/CesiumMan.gltf"
+#define ANIMATED_CHARACTER_COUNT 64
+
+// Meshlets culled by one task shader workgroup, one per invocation
+#define MESHLET_TASK_WORKGROUP_SIZE 32
+
+// Level of detail drawn: the largest error of a level, projected on screen, stays under this many pixels
+#define LOD_PIXEL_ERROR 1.f
+
+// Geometric error allowed for the level the ray tracing acceleration structures are built with, in world units. Within
+// the normal offset of the shadow rays, the rays start on the same side of the coarser surface
+#define RAY_TRACING_LOD_ERROR 0.01f
+
+// Meshlet range of the drawn primitive and the vertex layout handed to meshlet.task and meshlet.mesh, offsets and stride
+// are counted in floats
+struct MeshletPushConstants
+{
+	uint32_t meshletOffset;
+	uint32_t meshletCount;
+	uint32_t meshIndex;
+	uint32_t vertexStride;
+	uint32_t positionOffset;
+	uint32_t normalOffset;
+	uint32_t tangentOffset;
+	uint32_t biTangentOffset;
+	uint32_t texCoordOffset;
+	uint32_t colorOffset;
+};
+
+enum LightingPath
+{
+	LIGHTING_RAY_TRACING = 0,
+	LIGHTING_COMPUTE = 1,
+	LIGHTING_RAY_QUERY = 2
+};
+
 typedef struct alignas(16) s_SceneUniform
 {
 	alignas(16) glm::mat4 view;          
@@ -63,8 +135,35 @@ typedef struct alignas(16) s_SceneUniform
 	alignas(4) float time;
 	alignas(4) int numDirectionalLights;
 	alignas(4) int numPointLights;
+	alignas(16) glm::mat4 prevView;
+	alignas(16) glm::mat4 prevProjection;
+	alignas(4) int frameIndex;
+	alignas(4) int historyValid;
+	alignas(4) int temporalShadows;
+	alignas(16) glm::mat4 cascadeViewProj[SHADOW_CASCADE_COUNT];
+	alignas(16) glm::vec4 cascadeSplits;
+	alignas(16) glm::vec4 cascadeTexelSizes;
 } SceneUniform;
 
+// Offscreen run: no window, surface or swap chain, frameCount frames along a fixed camera path
+struct HeadlessSettings
+{
+	bool enabled = false;
+	uint32_t frameCount = 300;
+	// Frame numbers, counted from 1, read back and written to outputDirectory as PNG
+	std::set<uint64_t> capturedFrames;
+	std::string outputDirectory = "./Captures";
+};
+
+// Replay of a camera path, windowed or offscreen: warmupFrames frames at its start then one frame per SCRIPTED_TIME_STEP
+// until its end, the frame times of the latter written to outputPath
+struct BenchmarkSettings
+{
+	std::string cameraPath;
+	uint32_t warmupFrames = 60;
+	std::string outputPath = "./benchmark.json";
+};
+
 typedef struct s_KeyPress
 {
 	bool current, previous;
@@ -74,7 +173,8 @@ class Renderer
 {
 
 public:
-	Renderer(const std::string& ApplicationName = "DefaultApplication", uint32_t ApplicationVersion = 0, const std::string& EngineName = "DefaultEngine", uint32_t EngineVersion = 0, int width = 1080, int height = 720);
+	// With headless.enabled width and height size the offscreen images
+	Renderer(const std::string& ApplicationName = "DefaultApplication", uint32_t ApplicationVersion = 0, const std::string& EngineName = "DefaultEngine", uint32_t EngineVersion = 0, int width = 1080, int height = 720, const HeadlessSettings& headless = HeadlessSettings(), const BenchmarkSettings& benchmark = BenchmarkSettings());
 
 	~Renderer();
 
@@ -92,9 +192,7 @@ public:
 
 	void CreateLogicalDevice();
 
-	void CreateDepthRessources();
-
-	void CreateRenderPass();
+	void SelectDepthFormat();
 
 	void CreatePerPassDescriptor();
 
@@ -102,7 +200,14 @@ public:
 
 	void CreateGBufferDescriptor();
 
-	void UpdateGBufferDescriptor();
+	// One set per mesh with meshlets: its vertices, meshlets and meshlet data
+	void CreateMeshletDescriptor();
+
+	// Only the frame's set, it must not be in use
+	void UpdateGBufferDescriptor(uint32_t frame);
+
+	// Views of the transient targets, only written when the graph placed them again since the set was last written
+	void UpdateGBufferTransientDescriptor(uint32_t frame, const std::array<RenderGraphResource, 4>& transientTargets);
 
 	void CreateCubeMapGraphicPipeline();
 
@@ -114,19 +219,69 @@ public:
 
 	void CreateCommandBuffers();
 
+	// Skinning and acceleration structure command buffers of the async compute queue, kept across swap chain rebuilds
+	void CreateComputeCommandBuffers();
+
+	void RecordComputeCommandBuffers(uint32_t currentFrame);
+
+	// Submit this frame's async compute work behind the previous graphics frame, nothing when async compute is off
+	void SubmitCompute(uint32_t currentFrame);
+
+	// Read the graphics timeline, every frame seen done for the first time gets its input latency
+	void UpdateCompletedFrames();
+
+	// Block until the graphics timeline reaches frame, only when it has not already
+	void WaitForFrame(uint64_t frame);
+
+	// Offscreen only: host visible copies of the captured frames
+	void CreateCaptureBuffers();
+
+	// Write the captures whose frame is done
+	void WriteCompletedCaptures();
+
+	// Offscreen or benchmark frames: fixed time step, the camera follows m_CameraPath or orbits the scene
+	bool IsScripted();
+
+	bool IsBenchmarking();
+
+	void UpdateScriptedCamera(uint64_t frame);
+
+	// Once the device is idle: the frames still in flight get their GPU time, then the results are written
+	void FinishBenchmark();
+
+	// ImGui windows of the frame, never called offscreen
+	ImDrawData* BuildUserInterface();
+
+	// Hold the frame start back to m_FrameRateLimit, nothing when the limit is off
+	void LimitFrameRate();
+
+	// Milliseconds from the GPU being done to the frame reaching mid screen, from the present mode and the refresh rate
+	double GetPresentLatencyEstimate();
+
 	void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex, ImDrawData* draw_data);
 
+	// Clear every shadow history, the render graph has already moved them to TRANSFER_DST
+	void ResetTemporalHistory(VkCommandBuffer commandBuffer);
+
 	void CleanupCommandBuffers() const;
 
 	void CreateSyncObject();
 
 	bool WindowShouldClose();
 
+	// Swap chain, G-buffer and everything bound to them, timed into m_LastResizeTime
+	void RecreateSwapChain();
+
+	// Descriptors pointing at the images RecreateSwapChain replaced, called once the frame's fence is waited
+	void UpdateFrameDescriptors(uint32_t frame);
+
 	void Draw();
 
 	void UpdateUniform();
 
 	bool m_FramebufferResized = false;
+	// A new present mode was requested, the swap chain is rebuilt after this frame's present
+	bool m_PresentModeChanged = false;
 
 	Camera* GetCamera() const;
 
@@ -141,7 +296,13 @@ public:
 	bool gameViewportHovered = false;
 
 private:
-	static bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	static bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions);
+
+	bool checkRayTracingSupport(VkPhysicalDevice device);
+
+	bool checkRayQuerySupport(VkPhysicalDevice device);
+
+	bool checkMeshShaderSupport(VkPhysicalDevice device);
 
 	bool isDeviceSuitable(VkPhysicalDevice device);
 
@@ -156,6 +317,7 @@ private:
 	GlfwWindow m_Window;
 	VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 	VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_PhysicalDeviceProperties{};
 	VmaAllocator m_Allocator;
 	QueueFamilyIndices m_QueueFamilyIndices;
 	VkDevice m_Device = VK_NULL_HANDLE;
@@ -164,8 +326,8 @@ private:
 	VkQueue m_TranferQueue = VK_NULL_HANDLE;
 	VkQueue m_ComputeQueue = VK_NULL_HANDLE;
 	SwapChain m_SwapChain;
-	RenderPass m_RenderPass;
-	RenderPass m_FinalRenderPass;
+	// Rebuilt every frame, owns the barriers between its passes and the images' state across frames
+	RenderGraph m_RenderGraph;
 	VkPipeline m_GraphicPipelineFirstPass = VK_NULL_HANDLE;
 	VkPipeline m_GraphicPipelineFirstPassLineMode = VK_NULL_HANDLE;
 	VkPipeline m_GraphicPipelineSecondPass = VK_NULL_HANDLE;
@@ -179,22 +341,111 @@ private:
 	std::vector<VkCommandBuffer> m_CommandBuffers;
 	std::vector<VkSemaphore> m_ImageAvailableSemaphores;
 	std::vector<VkSemaphore> m_RenderFinishedSemaphores;
-	std::vector<VkFence> m_InFlightFences;
-	Image m_DepthImage;
+	// Graphics timeline value N is frame N done, frames are counted from 1 and each slot remembers the last one it submitted
+	VkSemaphore m_GraphicsTimeline = VK_NULL_HANDLE;
+	uint64_t m_SubmittedFrameCount = 0;
+	uint64_t m_CompletedFrameCount = 0;
+	std::vector<uint64_t> m_FrameSubmitCounts;
+	// What resizes replaced, destroyed once the frames submitted before are done
+	DeletionQueue m_DeletionQueue;
+	// One bit per frame slot whose descriptor sets still point at replaced images
+	uint32_t m_OutdatedFrameDescriptors = 0;
+
+	//ASYNC COMPUTE
+	std::vector<VkCommandBuffer> m_SkinningCommandBuffers;
+	std::vector<VkCommandBuffer> m_AccelerationStructureCommandBuffers;
+	// Two values per async frame: skinning done, then acceleration structures ready
+	VkSemaphore m_ComputeTimeline = VK_NULL_HANDLE;
+	uint64_t m_ComputeTimelineValue = 0;
+	bool m_AsyncCompute = false;
+	// Depth is a transient of the render graph, only its format is chosen up front
+	VkFormat m_DepthFormat = VK_FORMAT_UNDEFINED;
+	VkImageAspectFlags m_DepthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
 	Descriptor m_PerMeshDescriptor;
+	// Per frame transient data, the model matrices of the frame start at m_ModelsOffset
+	LinearAllocator m_FrameAllocator;
+	uint32_t m_ModelsOffset = 0;
 	Descriptor m_PerPassDescriptor;
 	Descriptor m_GBufferDescriptor;
+	// Placement version of the transient views each frame's set holds
+	std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> m_GBufferTransientVersions{};
 	GBuffer m_GBuffer;
 	Mesh m_simpleQuadMesh;
 
-	std::array<bool, MAX_FRAMES_IN_FLIGHT> m_freshRT = {true, true, true};
-
 	//RAY TRACING
-	RayTracingAccelerationStructure* m_RayTracingAccelerationStructure;
+	RayTracingAccelerationStructure* m_RayTracingAccelerationStructure = nullptr;
+	bool m_RayTracingSupported = false;
+	bool m_RayQuerySupported = false;
+
+	//MESH SHADING
+	bool m_MeshShaderSupported = false;
+	// Stages the scene and model matrices are also read from, none without mesh shaders
+	VkShaderStageFlags m_MeshShaderStages = 0;
+	bool m_MeshShading = false;
+	Descriptor m_MeshletDescriptor;
+	// Meshlet descriptor set of each mesh, -1 for the ones drawn through the vertex pipeline
+	std::vector<int32_t> m_MeshletDescriptorIndices;
+	uint32_t m_MeshletCount = 0;
+	VkPipeline m_GraphicPipelineMeshShading = VK_NULL_HANDLE;
+	VkPipelineLayout m_GraphicPipelineMeshShadingLayout = VK_NULL_HANDLE;
+	PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT = nullptr;
+
+	//LEVEL OF DETAIL
+	float m_LodPixelError = LOD_PIXEL_ERROR;
+	// Triangles of the selected levels, summed over the meshes
+	uint32_t m_LodTriangleCount = 0;
+
+	//LIGHTING
+	ComputeLighting* m_ComputeLighting = nullptr;
+	LightingPath m_LightingPath = LIGHTING_COMPUTE;
+	VkShaderStageFlags m_LightingShaderStages = VK_SHADER_STAGE_COMPUTE_BIT;
+	VkPipelineStageFlags m_LightingPipelineStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	//SHADOWS
+	CascadedShadowMap* m_CascadedShadowMap = nullptr;
+	float m_ShadowDistance = 150.f;
+
+	//ANIMATION
+	Skinning* m_Skinning = nullptr;
+
+	GpuProfiler m_GpuProfiler;
 
 	Camera* m_Camera;
 	SceneUniform m_SceneUniform;
 
+	bool m_TemporalShadows = true;
+	// Requested at any time, latched once per frame so the uniform and the clear of the history agree
+	bool m_ResetTemporalHistory = true;
+	bool m_ResetTemporalHistoryFrame = false;
+	uint32_t m_FrameIndex = 0;
+	// How far the CPU may run ahead of the GPU, at most MAX_FRAMES_IN_FLIGHT
+	int m_FramesInFlight = MAX_FRAMES_IN_FLIGHT;
+	// Input sampling time of the frames in flight, indexed by frame value
+	std::vector<std::chrono::high_resolution_clock::time_point> m_FrameInputTimes;
+	double m_InputLatency = 0.;
+	double m_AverageInputLatency = 0.;
+	// Frames per second, 0 leaves the frame rate unlimited
+	int m_FrameRateLimit = 0;
+	std::chrono::high_resolution_clock::time_point m_NextFrameStart = std::chrono::high_resolution_clock::now();
+	int m_RefreshRate = 60;
+	HeadlessSettings m_Headless;
+	std::vector<StorageBuffer> m_CaptureBuffers;
+	struct PendingCapture
+	{
+		uint64_t frame;
+		uint32_t slot;
+	};
+	std::vector<PendingCapture> m_PendingCaptures;
+	BenchmarkSettings m_Benchmark;
+	// Warm up included
+	uint64_t m_BenchmarkFrameCount = 0;
+	BenchmarkRecorder m_BenchmarkRecorder;
+	// Played back by the benchmark, or recorded from the live camera in the UI
+	CameraPath m_CameraPath;
+	double m_RecordedKeyframeSpacing = 2.;
+	// Milliseconds spent in the last RecreateSwapChain
+	double m_LastResizeTime = 0.;
+
 	std::map<int, KeyPress> m_KeyPressedMap;
 
 	uint32_t m_CurrentFrame = 0;
@@ -9,6 +9,7 @@ layout(location = 1) out vec4 outNormal;
 layout(location = 2) out vec4 outColor;
 layout(location = 3) out vec4 outPbr;
 layout(location = 4) out vec4 outEmissive;
+layout(location = 5) out vec2 outMotion;
 
 void main()
 {
@@ -17,4 +18,5 @@ void main()
     outColor = texture(cubeMapTexture, WorldFragPos);
     outPbr = vec4(0.);
     outEmissive = vec4(0.);
+    outMotion = vec2(0.);
 }
\ No newline at end of file
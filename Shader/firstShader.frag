@@ -5,6 +5,8 @@ layout(location = 1) in vec2 TexCoord;
 layout(location = 2) in vec3 FragColor;
 layout(location = 3) in vec3 WorldFragPos;
 layout(location = 4) in mat3 ModelToTangentLocal;
+layout(location = 7) in vec4 CurrentClipPos;
+layout(location = 8) in vec4 PreviousClipPos;
 
 layout(set = 2, binding = 0) uniform Material
 {
@@ -29,6 +31,14 @@ layout(location = 1) out vec4 outNormal;
 layout(location = 2) out vec4 outColor;
 layout(location = 3) out vec4 outPbr;
 layout(location = 4) out vec4 outEmissive;
+layout(location = 5) out vec2 outMotion;
+
+// Same convention as the raygen shader: uv.y grows towards -ndc.y
+vec2 ClipToUV(vec4 clipPos)
+{
+    vec2 ndc = clipPos.xy / clipPos.w;
+    return vec2(ndc.x, -ndc.y) * 0.5 + 0.5;
+}
 
 void main() {
     vec3 Normal = useNormalTexture == 1 ? normalize(ModelToTangentLocal * (texture(texSampler[2], TexCoord).rgb * 2. - 1.)) : Normal;
@@ -45,4 +55,5 @@ void main() {
     outColor = Color;
     outPbr = vec4(MetallicRoughness, AO, 0.);
     outEmissive = vec4(Emissive, 0.);
+    outMotion = ClipToUV(CurrentClipPos) - ClipToUV(PreviousClipPos);
 }
\ No newline at end of file
@@ -12,10 +12,13 @@ layout(location = 1) out vec2 TexCoord;
 layout(location = 2) out vec3 FragColor;
 layout(location = 3) out vec3 WorldFragPos;
 layout(location = 4) out mat3 ModelToTangentLocal;
+layout(location = 7) out vec4 CurrentClipPos;
+layout(location = 8) out vec4 PreviousClipPos;
 
-layout (set=1, binding=0) uniform Models
+// Model matrices of every mesh drawn this frame, the draw's first instance is the mesh index
+layout (std430, set=1, binding=0) readonly buffer Models
 {
-    mat4 model;
+    mat4 models[];
 };
 
 layout (set=0, binding=0) uniform Scene
@@ -27,14 +30,21 @@ layout (set=0, binding=0) uniform Scene
     float time;
     int numDirectionalLights;
     int numPointLights;
+    mat4 prevView;
+    mat4 prevProjection;
 };
 
 void main() {
+    mat4 model = models[gl_InstanceIndex];
+
     vec4 pos = model * vec4(inPosition, 1.0);
     WorldFragPos = pos.xyz / pos.w;
 
     gl_Position = projection * view * pos;
 
+    CurrentClipPos = gl_Position;
+    PreviousClipPos = prevProjection * prevView * pos;
+
     mat3 orthoModelMV = mat3(transpose(inverse(model)));
     Normal = normalize(orthoModelMV * inNormal);
     TexCoord = inTexCoord;
@@ -0,0 +1,102 @@
+// Shared by the lighting passes (raygen, compute)
+
+const float PI = 3.1415926535897932384626433832795;
+const float MIN_FLT = 1.175494351e-32;
+
+#define SHADOW_CASCADE_COUNT 4
+
+const int SHADOW_RAY_TRACED = 0;
+const int SHADOW_MAP = 1;
+
+struct UniformDirectionalLight {
+	vec3 Color;
+	int padding;
+	vec3 Direction;
+	int padding1;
+	int shadowTechnique;
+};
+
+struct UniformPointLight {
+	vec3 Color;
+	int padding;
+	vec3 Position;
+	int padding1;
+};
+
+float D(float NH, float alpha)
+{
+	float alphaSq = alpha*alpha;
+	float d = NH*NH * (alphaSq - 1.) + 1.;
+	return alphaSq / (PI * d*d);
+}
+
+float G1(float X, float k)
+{
+	return X / (X * (1. - k) + k);
+}
+
+float GGX(float NL, float NV, float Roughness)
+{
+	float k = (Roughness + 1.);
+	k = k*k / 8.;
+	return G1(NL, k) * G1(NV, k);
+}
+
+vec3 FUnreal(float VH, vec3 F0)
+{
+	return F0 + (1. - F0) * pow(2, (-5.55473 * VH - 6.98316) * VH);
+}
+
+vec3 BRDF(vec3 N, vec3 V, vec3 L, float NL, float NV, vec3 F0, vec3 fDiff, float alpha, float Roughness)
+{
+	vec3 H = normalize(V + L);
+
+	float NH = max(0., dot(N, H));
+	float VH = max(0., dot(V, H));
+
+	vec3 F = FUnreal(VH, F0);
+
+	vec3 fSpec = vec3(D(NH, alpha) * GGX(NL, NV, Roughness) / (4. * NL * NV + MIN_FLT));
+	return mix(fDiff, fSpec, F);
+}
+
+vec3 LinearToSRGB(vec3 color)
+{
+	color.x = (color.x <= 0.0031308) ? 12.92 * color.x : 1.055 * pow(color.x, 1 / 2.4) - 0.055;
+	color.y = (color.y <= 0.0031308) ? 12.92 * color.y : 1.055 * pow(color.y, 1 / 2.4) - 0.055;
+	color.z = (color.z <= 0.0031308) ? 12.92 * color.z : 1.055 * pow(color.z, 1 / 2.4) - 0.055;
+	return color;
+}
+
+// Cascade picked from the view depth, normal offset of about one texel then 3x3 PCF (each tap is a bilinear compare)
+// textureGrad with null gradients: no implicit LOD outside fragment shaders
+float CascadeShadow(sampler2DArrayShadow shadowMap, mat4 cascadeViewProj[SHADOW_CASCADE_COUNT], vec4 splits, vec4 texelSizes, vec3 worldPos, vec3 N, float viewDepth)
+{
+	int cascade = 0;
+	for (int i = 0; i < SHADOW_CASCADE_COUNT - 1; i++)
+	{
+		if (viewDepth > splits[i])
+			cascade = i + 1;
+	}
+
+	if (viewDepth > splits[SHADOW_CASCADE_COUNT - 1])
+		return 1.;
+
+	vec4 lightPos = cascadeViewProj[cascade] * vec4(worldPos + N * texelSizes[cascade] * 1.5, 1.);
+	vec3 ndc = lightPos.xyz / lightPos.w;
+	vec2 uv = ndc.xy * 0.5 + 0.5;
+
+	if (ndc.z > 1.)
+		return 1.;
+
+	vec2 texelSize = 1. / vec2(textureSize(shadowMap, 0).xy);
+
+	float visibility = 0.;
+	for (int x = -1; x <= 1; x++)
+	{
+		for (int y = -1; y <= 1; y++)
+			visibility += textureGrad(shadowMap, vec4(uv + vec2(x, y) * texelSize, float(cascade), ndc.z), vec2(0.), vec2(0.));
+	}
+
+	return visibility / 9.;
+}
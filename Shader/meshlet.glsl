@@ -0,0 +1,60 @@
+// Shared by meshlet.task and meshlet.mesh, matches Meshlet and MeshletPushConstants on the C++ side
+
+#define TASK_WORKGROUP_SIZE 32
+#define MESH_WORKGROUP_SIZE 32
+#define MAX_VERTICES 64
+#define MAX_TRIANGLES 124
+
+struct Meshlet
+{
+	vec4 boundingSphere;
+	vec4 cone;
+	uint vertexOffset;
+	uint triangleOffset;
+	uint vertexCount;
+	uint triangleCount;
+};
+
+layout (set=0, binding=0) uniform Scene
+{
+	mat4 view;
+	mat4 projection;
+	vec3 camPosition;
+	int padding1;
+	float time;
+	int numDirectionalLights;
+	int numPointLights;
+	mat4 prevView;
+	mat4 prevProjection;
+};
+
+layout (std430, set=1, binding=0) readonly buffer Models
+{
+	mat4 models[];
+};
+
+// Vertices are read as raw floats, the C++ layout is given by the push constants
+layout (std430, set=3, binding=0) readonly buffer Vertices { float vertices[]; };
+layout (std430, set=3, binding=1) readonly buffer Meshlets { Meshlet meshlets[]; };
+// Per meshlet: its vertex indices, then one word per triangle with 3 local 8 bit indices
+layout (std430, set=3, binding=2) readonly buffer MeshletData { uint meshletData[]; };
+
+layout(push_constant) uniform PushConstants
+{
+	uint meshletOffset;
+	uint meshletCount;
+	uint meshIndex;
+	uint vertexStride;
+	uint positionOffset;
+	uint normalOffset;
+	uint tangentOffset;
+	uint biTangentOffset;
+	uint texCoordOffset;
+	uint colorOffset;
+};
+
+// Meshlets of one task workgroup left after culling, absolute indices
+struct TaskPayload
+{
+	uint meshletIndices[TASK_WORKGROUP_SIZE];
+};
@@ -0,0 +1,17 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+
+layout (std430, set=0, binding=0) readonly buffer Models
+{
+    mat4 models[];
+};
+
+layout(push_constant) uniform Cascade
+{
+    mat4 lightViewProj;
+};
+
+void main() {
+    gl_Position = lightViewProj * models[gl_InstanceIndex] * vec4(inPosition, 1.0);
+}
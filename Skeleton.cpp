@@ -0,0 +1,126 @@
+#include "Skeleton.h"
+#include <algorithm>
+#include <cmath>
+
+Skeleton::Skeleton(const std::vector<SkeletonNode>& nodes, const std::vector<int>& joints, const std::vector<glm::mat4>& inverseBindMatrices)
+{
+	m_Nodes = nodes;
+	m_Joints = joints;
+	m_InverseBindMatrices = inverseBindMatrices;
+
+	m_InverseBindMatrices.resize(m_Joints.size(), glm::mat4(1.f));
+}
+
+void Skeleton::AddAnimation(const Animation& animation)
+{
+	m_Animations.push_back(animation);
+}
+
+uint32_t Skeleton::GetJointCount()
+{
+	return static_cast<uint32_t>(m_Joints.size());
+}
+
+float Skeleton::GetDuration()
+{
+	return m_Animations.empty() ? 0.f : m_Animations[0].duration;
+}
+
+void Skeleton::ComputeJointMatrices(float time, std::vector<glm::mat4>& jointMatrices)
+{
+	std::vector<SkeletonNode> nodes = m_Nodes;
+
+	if (!m_Animations.empty() && m_Animations[0].duration > 0.f)
+	{
+		const Animation& animation = m_Animations[0];
+		float animationTime = std::fmod(std::max(time, 0.f), animation.duration);
+
+		for (const AnimationChannel& channel : animation.channels)
+		{
+			if (channel.node < 0 || channel.node >= static_cast<int>(nodes.size()) || channel.times.empty())
+				continue;
+
+			glm::vec4 value = SampleChannel(channel, animationTime);
+			SkeletonNode& node = nodes[channel.node];
+
+			switch (channel.path)
+			{
+				case ANIMATION_TRANSLATION:
+					node.translation = glm::vec3(value);
+					break;
+				case ANIMATION_ROTATION:
+					node.rotation = glm::quat(value.w, value.x, value.y, value.z);
+					break;
+				case ANIMATION_SCALE:
+					node.scale = glm::vec3(value);
+					break;
+			}
+		}
+	}
+
+	std::vector<glm::mat4> localTransforms(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].hasMatrix)
+		{
+			localTransforms[i] = nodes[i].matrix;
+			continue;
+		}
+
+		glm::mat4 localTransform = glm::translate(glm::mat4(1.f), nodes[i].translation);
+		localTransform = localTransform * glm::mat4_cast(nodes[i].rotation);
+		localTransforms[i] = glm::scale(localTransform, nodes[i].scale);
+	}
+
+	std::vector<glm::mat4> globalTransforms(nodes.size());
+	std::vector<bool> computed(nodes.size(), false);
+
+	jointMatrices.resize(m_Joints.size());
+	for (size_t i = 0; i < m_Joints.size(); i++)
+		jointMatrices[i] = ComputeGlobalTransform(m_Joints[i], localTransforms, globalTransforms, computed) * m_InverseBindMatrices[i];
+}
+
+glm::mat4 Skeleton::ComputeGlobalTransform(int node, const std::vector<glm::mat4>& localTransforms, std::vector<glm::mat4>& globalTransforms, std::vector<bool>& computed)
+{
+	if (node < 0 || node >= static_cast<int>(localTransforms.size()))
+		return glm::mat4(1.f);
+
+	if (!computed[node])
+	{
+		int parent = m_Nodes[node].parent;
+		glm::mat4 parentTransform = parent >= 0 ? ComputeGlobalTransform(parent, localTransforms, globalTransforms, computed) : glm::mat4(1.f);
+
+		globalTransforms[node] = parentTransform * localTransforms[node];
+		computed[node] = true;
+	}
+
+	return globalTransforms[node];
+}
+
+glm::vec4 Skeleton::SampleChannel(const AnimationChannel& channel, float time)
+{
+	size_t keyCount = std::min(channel.times.size(), channel.values.size());
+
+	if (keyCount == 1 || time <= channel.times[0])
+		return channel.values[0];
+	if (time >= channel.times[keyCount - 1])
+		return channel.values[keyCount - 1];
+
+	size_t next = std::upper_bound(channel.times.begin(), channel.times.begin() + keyCount, time) - channel.times.begin();
+	size_t previous = next - 1;
+
+	if (channel.step)
+		return channel.values[previous];
+
+	float t = (time - channel.times[previous]) / (channel.times[next] - channel.times[previous]);
+
+	if (channel.path == ANIMATION_ROTATION)
+	{
+		const glm::vec4& a = channel.values[previous];
+		const glm::vec4& b = channel.values[next];
+		glm::quat rotation = glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+		return glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	}
+
+	return glm::mix(channel.values[previous], channel.values[next], t);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include "VkGLM.h"
+
+enum AnimationPath
+{
+	ANIMATION_TRANSLATION,
+	ANIMATION_ROTATION,
+	ANIMATION_SCALE
+};
+
+struct AnimationChannel
+{
+	int node;
+	AnimationPath path;
+	bool step;
+	std::vector<float> times;
+	// xyz for translation and scale, xyzw quaternion for rotation
+	std::vector<glm::vec4> values;
+};
+
+struct Animation
+{
+	float duration = 0.f;
+	std::vector<AnimationChannel> channels;
+};
+
+struct SkeletonNode
+{
+	int parent = -1;
+	glm::vec3 translation = glm::vec3(0.f);
+	glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+	glm::vec3 scale = glm::vec3(1.f);
+	// Nodes given as a matrix cannot be animated, it replaces the TRS
+	bool hasMatrix = false;
+	glm::mat4 matrix = glm::mat4(1.f);
+};
+
+class Skeleton
+{
+public:
+	Skeleton(const std::vector<SkeletonNode>& nodes, const std::vector<int>& joints, const std::vector<glm::mat4>& inverseBindMatrices);
+
+	void AddAnimation(const Animation& animation);
+
+	uint32_t GetJointCount();
+
+	float GetDuration();
+
+	// Sample the first animation at time (looping) and write joint global * inverse bind for every joint
+	void ComputeJointMatrices(float time, std::vector<glm::mat4>& jointMatrices);
+
+private:
+
+	glm::mat4 ComputeGlobalTransform(int node, const std::vector<glm::mat4>& localTransforms, std::vector<glm::mat4>& globalTransforms, std::vector<bool>& computed);
+
+	static glm::vec4 SampleChannel(const AnimationChannel& channel, float time);
+
+	std::vector<SkeletonNode> m_Nodes;
+	std::vector<int> m_Joints;
+	std::vector<glm::mat4> m_InverseBindMatrices;
+	std::vector<Animation> m_Animations;
+};
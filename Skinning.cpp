@@ -0,0 +1,214 @@
+#include "Skinning.h"
+
+Skinning::Skinning(VkDevice device, VmaAllocator allocator, const std::vector<Mesh*>& meshes, uint32_t framesInFlight)
+{
+    m_FramesInFlight = framesInFlight;
+
+    for (Mesh* mesh : meshes)
+    {
+        if (mesh->IsSkinned() && mesh->GetSkinnedVertexBuffer() != VK_NULL_HANDLE)
+            m_SkinnedMeshes.push_back(mesh);
+    }
+
+    if (m_SkinnedMeshes.empty())
+        return;
+
+    CreateDescriptorSets(device, allocator);
+    CreateComputePipeline(device);
+}
+
+bool Skinning::HasSkinnedMeshes()
+{
+    return !m_SkinnedMeshes.empty();
+}
+
+uint32_t Skinning::GetSkinnedMeshCount()
+{
+    return static_cast<uint32_t>(m_SkinnedMeshes.size());
+}
+
+void Skinning::Update(uint32_t currentFrame, float time)
+{
+    const std::vector<StorageBuffer>& jointBuffers = m_SkinningDescriptor.GetUniformStorageBuffers();
+
+    for (size_t i = 0; i < m_SkinnedMeshes.size(); i++)
+    {
+        Mesh* mesh = m_SkinnedMeshes[i];
+
+        mesh->GetSkeleton()->ComputeJointMatrices(time + mesh->GetAnimationTimeOffset(), m_JointMatrices);
+
+        const StorageBuffer& jointBuffer = jointBuffers[i * m_FramesInFlight + currentFrame];
+        memcpy(jointBuffer.memoryInfo.pMappedData, m_JointMatrices.data(), m_JointMatrices.size() * sizeof(glm::mat4));
+    }
+}
+
+void Skinning::RecordCmdDispatch(VkCommandBuffer commandBuffer, uint32_t currentFrame, VkPipelineStageFlags dstStageMask)
+{
+    if (m_SkinnedMeshes.empty())
+        return;
+
+    // The previous frame may still draw or build from the skinned vertices this dispatch overwrites
+    vkCmdPipelineBarrier(commandBuffer, dstStageMask, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipeline);
+
+    const std::vector<VkDescriptorSet>& descriptorSets = m_SkinningDescriptor.GetDescriptorSets();
+
+    SkinningPushConstants pushConstants{};
+    pushConstants.vertexStride = sizeof(Vertex) / sizeof(float);
+    pushConstants.positionOffset = offsetof(Vertex, pos) / sizeof(float);
+    pushConstants.normalOffset = offsetof(Vertex, normal) / sizeof(float);
+    pushConstants.tangentOffset = offsetof(Vertex, tangent) / sizeof(float);
+    pushConstants.biTangentOffset = offsetof(Vertex, biTangent) / sizeof(float);
+
+    for (size_t i = 0; i < m_SkinnedMeshes.size(); i++)
+    {
+        pushConstants.vertexCount = static_cast<uint32_t>(m_SkinnedMeshes[i]->GetVertex().size());
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipelineLayout, 0, 1, &descriptorSets[i * m_FramesInFlight + currentFrame], 0, NULL);
+        vkCmdPushConstants(commandBuffer, m_ComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SkinningPushConstants), &pushConstants);
+
+        vkCmdDispatch(commandBuffer, (pushConstants.vertexCount + SKINNING_WORKGROUP_SIZE - 1) / SKINNING_WORKGROUP_SIZE, 1, 1);
+    }
+
+    // Vertex input reads attributes, acceleration structure builds read their geometry as shader reads
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStageMask, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+}
+
+void Skinning::CreateDescriptorSets(VkDevice device, VmaAllocator allocator)
+{
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings(4);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        layoutBindings[i].binding = i;
+        layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[i].descriptorCount = 1;
+        layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        layoutBindings[i].pImmutableSamplers = NULL;
+    }
+
+    m_SkinningDescriptor.CreateDescriptorSetLayout(device, layoutBindings, 0);
+
+    uint32_t setCount = static_cast<uint32_t>(m_SkinnedMeshes.size()) * m_FramesInFlight;
+
+    VkDescriptorPoolSize descriptorPoolSize;
+    descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorPoolSize.descriptorCount = 4 * setCount;
+
+    m_SkinningDescriptor.CreateDescriptorPool(device, { descriptorPoolSize }, setCount);
+
+    std::vector<VkDescriptorSetLayout> layouts;
+    layouts.assign(setCount, m_SkinningDescriptor.GetDescriptorSetLayout());
+
+    m_SkinningDescriptor.AllocateDescriptorSet(device, layouts);
+
+    for (Mesh* mesh : m_SkinnedMeshes)
+    {
+        VkDeviceSize jointBufferSize = std::max<uint32_t>(mesh->GetSkeleton()->GetJointCount(), 1) * sizeof(glm::mat4);
+
+        for (uint32_t frame = 0; frame < m_FramesInFlight; frame++)
+            m_SkinningDescriptor.AddStorageBuffer(allocator, jointBufferSize);
+    }
+
+    const std::vector<VkDescriptorSet>& descriptorSets = m_SkinningDescriptor.GetDescriptorSets();
+    const std::vector<StorageBuffer>& jointBuffers = m_SkinningDescriptor.GetUniformStorageBuffers();
+
+    for (size_t i = 0; i < m_SkinnedMeshes.size(); i++)
+    {
+        Mesh* mesh = m_SkinnedMeshes[i];
+
+        for (uint32_t frame = 0; frame < m_FramesInFlight; frame++)
+        {
+            size_t setIndex = i * m_FramesInFlight + frame;
+
+            std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+            bufferInfos[0].buffer = mesh->GetVertexBuffer();
+            bufferInfos[0].offset = 0;
+            bufferInfos[0].range = VK_WHOLE_SIZE;
+            bufferInfos[1].buffer = mesh->GetSkinBuffer();
+            bufferInfos[1].offset = 0;
+            bufferInfos[1].range = VK_WHOLE_SIZE;
+            bufferInfos[2].buffer = jointBuffers[setIndex].buffer;
+            bufferInfos[2].offset = 0;
+            bufferInfos[2].range = VK_WHOLE_SIZE;
+            bufferInfos[3].buffer = mesh->GetSkinnedVertexBuffer();
+            bufferInfos[3].offset = 0;
+            bufferInfos[3].range = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+            for (uint32_t binding = 0; binding < 4; binding++)
+            {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = descriptorSets[setIndex];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, NULL);
+        }
+    }
+}
+
+void Skinning::CreateComputePipeline(VkDevice device)
+{
+    VkDescriptorSetLayout descriptorSetLayout = m_SkinningDescriptor.GetDescriptorSetLayout();
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(SkinningPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+    pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCI.setLayoutCount = 1;
+    pipelineLayoutCI.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutCI.pushConstantRangeCount = 1;
+    pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &m_ComputePipelineLayout) != VK_SUCCESS)
+        std::cout << "Skinning pipeline layout creation failed !" << '\n';
+
+    Shader computeShader;
+    computeShader.createModule(device, ".\\Shader\\skinning.spv");
+
+    VkPipelineShaderStageCreateInfo computeShaderStageCreateInfo;
+    computeShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeShaderStageCreateInfo.pNext = NULL;
+    computeShaderStageCreateInfo.flags = 0;
+    computeShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeShaderStageCreateInfo.module = computeShader.getShaderModule();
+    computeShaderStageCreateInfo.pName = "main";
+    computeShaderStageCreateInfo.pSpecializationInfo = NULL;
+
+    VkComputePipelineCreateInfo computePipelineCI{};
+    computePipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineCI.stage = computeShaderStageCreateInfo;
+    computePipelineCI.layout = m_ComputePipelineLayout;
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr, &m_ComputePipeline) != VK_SUCCESS)
+        std::cout << "Skinning pipeline creation failed !" << '\n';
+
+    computeShader.cleanup(device);
+}
+
+void Skinning::Cleanup(VkDevice device, VmaAllocator allocator)
+{
+    if (m_SkinnedMeshes.empty())
+        return;
+
+    vkDestroyPipeline(device, m_ComputePipeline, NULL);
+    vkDestroyPipelineLayout(device, m_ComputePipelineLayout, NULL);
+
+    m_SkinningDescriptor.DestroyStorageBuffer(allocator, device);
+    m_SkinningDescriptor.DestroyDescriptorPool(device);
+    m_SkinningDescriptor.DestroyDescriptorSetLayout(device);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include "Descriptor.h"
+#include "Shader.h"
+#include "Mesh.h"
+
+#define SKINNING_WORKGROUP_SIZE 64
+
+// Vertex layout handed to skinning.comp, offsets and stride are counted in floats
+struct SkinningPushConstants
+{
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t positionOffset;
+    uint32_t normalOffset;
+    uint32_t tangentOffset;
+    uint32_t biTangentOffset;
+};
+
+class Skinning
+{
+public:
+
+    // Only the skinned meshes are kept, each one gets a joint matrix buffer per frame in flight
+    Skinning(VkDevice device, VmaAllocator allocator, const std::vector<Mesh*>& meshes, uint32_t framesInFlight);
+
+    bool HasSkinnedMeshes();
+
+    uint32_t GetSkinnedMeshCount();
+
+    // Sample every skeleton at time and write this frame's joint matrices
+    void Update(uint32_t currentFrame, float time);
+
+    // Skin every mesh into its own vertex buffer, then make the result visible to dstStageMask
+    void RecordCmdDispatch(VkCommandBuffer commandBuffer, uint32_t currentFrame, VkPipelineStageFlags dstStageMask);
+
+    void Cleanup(VkDevice device, VmaAllocator allocator);
+
+private:
+
+    void CreateDescriptorSets(VkDevice device, VmaAllocator allocator);
+
+    void CreateComputePipeline(VkDevice device);
+
+    std::vector<Mesh*> m_SkinnedMeshes;
+    uint32_t m_FramesInFlight = 0;
+
+    std::vector<glm::mat4> m_JointMatrices;
+
+    Descriptor m_SkinningDescriptor;
+
+    VkPipeline m_ComputePipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_ComputePipelineLayout = VK_NULL_HANDLE;
+};
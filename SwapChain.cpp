@@ -8,6 +8,7 @@ SwapChain::SwapChain()
 {
     m_SurfaceFormat = VK_FORMAT_UNDEFINED;
     m_PresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+    m_RequestedPresentMode = DEFAULT_PRESENT_MODE;
     m_Extent = { 0, 0 };
 }
 
@@ -17,6 +18,8 @@ void SwapChain::BuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator all
 
     VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
     VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
+    m_PresentMode = presentMode;
+    m_SupportedPresentModes = swapChainSupport.presentModes;
     VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities, window);
 
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -52,7 +55,8 @@ void SwapChain::BuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator all
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the presentation engine hand over the images still queued on a retired swap chain
+    createInfo.oldSwapchain = m_SwapchainKHR;
 
     if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &m_SwapchainKHR) != VK_SUCCESS) 
     {
@@ -90,15 +94,29 @@ void SwapChain::BuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator all
         }
     }
 
+    CreateSceneImages(allocator, device, queueFamilyIndices);
+}
+
+void SwapChain::BuildOffscreen(VmaAllocator allocator, VkDevice device, VkExtent2D extent, const QueueFamilyIndices& queueFamilyIndices)
+{
+    // Same layout as the lighting shaders' rgba8 storage image, read back as is
+    m_SurfaceFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    m_Extent = extent;
+
+    CreateSceneImages(allocator, device, queueFamilyIndices);
+}
+
+void SwapChain::CreateSceneImages(VmaAllocator allocator, VkDevice device, const QueueFamilyIndices& queueFamilyIndices)
+{
     m_RTImages.resize(MAX_FRAMES_IN_FLIGHT);
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        m_RTImages[i].CreateImage(allocator, extent.width, extent.height, surfaceFormat.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, { queueFamilyIndices.graphicsFamily.value()});
-        m_RTImages[i].CreateImageView(device, surfaceFormat.format, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_RTImages[i].CreateImage(allocator, m_Extent.width, m_Extent.height, m_SurfaceFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, { queueFamilyIndices.graphicsFamily.value()});
+        m_RTImages[i].CreateImageView(device, m_SurfaceFormat, VK_IMAGE_ASPECT_COLOR_BIT);
     }
 }
 
-void SwapChain::RebuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator allocator, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window, const QueueFamilyIndices& queueFamilyIndices)
+void SwapChain::RebuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator allocator, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window, const QueueFamilyIndices& queueFamilyIndices, DeletionQueue& deletionQueue, uint64_t frame)
 {
     int width = 0, height = 0;
     glfwGetFramebufferSize(window, &width, &height);
@@ -107,83 +125,42 @@ void SwapChain::RebuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator a
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
-
-    Cleanup(device, allocator);
+    // The frames in flight still sample the scene images and present the swap chain images, nothing is destroyed before they are done
+    VkSwapchainKHR oldSwapchain = m_SwapchainKHR;
+    std::vector<VkImageView> oldImageViews = std::move(m_ImageViews);
+    std::vector<Image> oldRTImages = std::move(m_RTImages);
+    std::vector<VkSampler> oldSamplers = std::move(m_Sampler);
+    std::vector<VkDescriptorSet> oldImGuiDescriptors = std::move(m_ImGuiDescriptor);
+    m_ImageViews.clear();
+    m_RTImages.clear();
+    m_Sampler.clear();
+    m_ImGuiDescriptor.clear();
+    m_Images.clear();
 
     BuildSwapChain(physicalDevice, allocator, device, surface, window, queueFamilyIndices);
-}
-
-void SwapChain::CreateFramebuffer(VkDevice device, VkRenderPass renderPass, VkRenderPass finalRenderPass, GBuffer& GBuffer, VkImageView depthAttachment)
-{
-    m_Framebuffers.resize(MAX_FRAMES_IN_FLIGHT);
-
-    auto GBufferImages = GBuffer.GetGBufferImages();
 
-    for (int i = 0; i < m_Framebuffers.size(); i++)
-    {
-        std::array<VkImageView, 6> attachments = { 
-            GBufferImages[i].positionImageBuffer.GetImageView(),  
-            GBufferImages[i].normalImageBuffer.GetImageView(),
-            GBufferImages[i].colorImageBuffer.GetImageView(),
-            GBufferImages[i].pbrImageBuffer.GetImageView(),
-            GBufferImages[i].emissiveImageBuffer.GetImageView(),
-            depthAttachment};
-
-        VkFramebufferCreateInfo framebufferCreateInfo;
-        framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferCreateInfo.pNext = NULL;
-        framebufferCreateInfo.flags = 0;
-        framebufferCreateInfo.renderPass = renderPass;
-        framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferCreateInfo.pAttachments = attachments.data();
-        framebufferCreateInfo.width = m_Extent.width;
-        framebufferCreateInfo.height = m_Extent.height;
-        framebufferCreateInfo.layers = 1;
-
-        if (vkCreateFramebuffer(device, &framebufferCreateInfo, NULL, &m_Framebuffers[i]) != VK_SUCCESS)
+    deletionQueue.Push(frame, [device, allocator, oldSwapchain, oldImageViews, oldRTImages, oldSamplers, oldImGuiDescriptors]() mutable {
+        for (VkDescriptorSet descriptorSet : oldImGuiDescriptors)
         {
-            std::cout << "Framebuffer creation failed !" << std::endl;
+            if (descriptorSet != VK_NULL_HANDLE)
+                ImGui_ImplVulkan_RemoveTexture(descriptorSet);
         }
-    }
 
-    m_FinalFramebuffers.resize(m_Images.size());
-    for (int i = 0; i < m_FinalFramebuffers.size(); i++)
-    {
-        std::array<VkImageView, 1> attachments = {
-            m_ImageViews[i]
-        };
+        for (VkSampler sampler : oldSamplers)
+            vkDestroySampler(device, sampler, NULL);
 
-        VkFramebufferCreateInfo framebufferCreateInfo;
-        framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferCreateInfo.pNext = NULL;
-        framebufferCreateInfo.flags = 0;
-        framebufferCreateInfo.renderPass = finalRenderPass;
-        framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferCreateInfo.pAttachments = attachments.data();
-        framebufferCreateInfo.width = m_Extent.width;
-        framebufferCreateInfo.height = m_Extent.height;
-        framebufferCreateInfo.layers = 1;
-
-        if (vkCreateFramebuffer(device, &framebufferCreateInfo, NULL, &m_FinalFramebuffers[i]) != VK_SUCCESS)
-        {
-            std::cout << "Framebuffer creation failed !" << std::endl;
-        }
-    }
+        for (Image& image : oldRTImages)
+            image.Cleanup(allocator, device);
+
+        for (VkImageView imageView : oldImageViews)
+            vkDestroyImageView(device, imageView, NULL);
+
+        vkDestroySwapchainKHR(device, oldSwapchain, NULL);
+    });
 }
 
 void SwapChain::Cleanup(VkDevice device, VmaAllocator allocator)
 {
-    for (int i = 0; i < m_Framebuffers.size(); i++)
-        vkDestroyFramebuffer(device, m_Framebuffers[i], NULL);
-
-    m_Framebuffers.clear();
-
-    for (int i = 0; i < m_FinalFramebuffers.size(); i++)
-        vkDestroyFramebuffer(device, m_FinalFramebuffers[i], NULL);
-
-    m_FinalFramebuffers.clear();
-
     for (int i = 0; i < m_ImageViews.size(); i++)
     {
         vkDestroyImageView(device, m_ImageViews[i], NULL);
@@ -247,11 +224,6 @@ const void SwapChain::GetImageViews(std::vector<VkImageView>& outImageViews)
     }
 }
 
-const std::vector<VkFramebuffer>& SwapChain::GetFramebuffers()
-{
-    return m_Framebuffers;
-}
-
 const std::vector<VkImage>& SwapChain::GetFinalImage()
 {
     return m_Images;
@@ -262,11 +234,6 @@ const std::vector<VkImageView>& SwapChain::GetFinalImageViews()
     return m_ImageViews;
 }
 
-const std::vector<VkFramebuffer>& SwapChain::GetFinalFramebuffers()
-{
-    return m_FinalFramebuffers;
-}
-
 void SwapChain::CreateImGuiImageDescriptor(VkDevice device)
 {
     m_Sampler.resize(m_RTImages.size());
@@ -334,9 +301,17 @@ VkSurfaceFormatKHR SwapChain::ChooseSwapSurfaceFormat(const std::vector<VkSurfac
 
 VkPresentModeKHR SwapChain::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == PRESENT_MODE) {
-            return availablePresentMode;
+    // Closest mode to the requested one: the other non blocking one, then FIFO which every surface supports
+    std::vector<VkPresentModeKHR> candidates = { m_RequestedPresentMode };
+
+    if (m_RequestedPresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    else if (m_RequestedPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+        candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+
+    for (VkPresentModeKHR candidate : candidates) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), candidate) != availablePresentModes.end()) {
+            return candidate;
         }
     }
 
@@ -363,3 +338,40 @@ VkExtent2D SwapChain::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilit
         return actualExtent;
     }
 }
+
+void SwapChain::SetPresentMode(VkPresentModeKHR presentMode)
+{
+    m_RequestedPresentMode = presentMode;
+}
+
+VkPresentModeKHR SwapChain::GetRequestedPresentMode()
+{
+    return m_RequestedPresentMode;
+}
+
+VkPresentModeKHR SwapChain::GetPresentMode()
+{
+    return m_PresentMode;
+}
+
+const std::vector<VkPresentModeKHR>& SwapChain::GetSupportedPresentModes()
+{
+    return m_SupportedPresentModes;
+}
+
+const char* SwapChain::GetPresentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "Immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "Mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO relaxed";
+    default:
+        return "Other";
+    }
+}
@@ -2,13 +2,14 @@
 
 #include "VulkanBase.h"
 #include "QueueVulkan.h"
-#include "GBuffer.h"
+#include "Image.h"
+#include "DeletionQueue.h"
 #include <iostream>
 #include <vector>
 #include <array>
 
-//#define PRESENT_MODE VK_PRESENT_MODE_FIFO_KHR
-#define PRESENT_MODE VK_PRESENT_MODE_MAILBOX_KHR
+// Requested until SetPresentMode picks another one, falls back when the surface does not support it
+#define DEFAULT_PRESENT_MODE VK_PRESENT_MODE_MAILBOX_KHR
 
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
@@ -23,9 +24,11 @@ public:
 
 	void BuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator allocator, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window, const QueueFamilyIndices& queueFamilyIndices);
 
-	void RebuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator allocator, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window, const QueueFamilyIndices& queueFamilyIndices);
+	// Scene images only, no surface nor swap chain: nothing is presented and GetFinalImage stays empty
+	void BuildOffscreen(VmaAllocator allocator, VkDevice device, VkExtent2D extent, const QueueFamilyIndices& queueFamilyIndices);
 
-	void CreateFramebuffer(VkDevice device, VkRenderPass renderPass, VkRenderPass finalRenderPass, GBuffer& GBuffer, VkImageView depthAttachment);
+	// The old swap chain is handed to the new one, it and the images sized after it are retired to deletionQueue under frame
+	void RebuildSwapChain(VkPhysicalDevice physicalDevice, VmaAllocator allocator, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window, const QueueFamilyIndices& queueFamilyIndices, DeletionQueue& deletionQueue, uint64_t frame);
 
 	SwapChainSupportDetails QuerySupportDetails(VkPhysicalDevice device, VkSurfaceKHR surface);
 
@@ -41,18 +44,26 @@ public:
 
 	const void GetImageViews(std::vector<VkImageView>& outImageViews);
 
-	const std::vector<VkFramebuffer>& GetFramebuffers();
-
 	const std::vector<VkImage>& GetFinalImage();
 
 	const std::vector<VkImageView>& GetFinalImageViews();
 
-	const std::vector<VkFramebuffer>& GetFinalFramebuffers();
-
 	void CreateImGuiImageDescriptor(VkDevice device);
 
 	const VkDescriptorSet& GetImGuiImageDescriptor(uint32_t i);
 
+	// Taken into account by the next (re)build
+	void SetPresentMode(VkPresentModeKHR presentMode);
+
+	VkPresentModeKHR GetRequestedPresentMode();
+
+	// What the last build negotiated, can differ from the requested mode
+	VkPresentModeKHR GetPresentMode();
+
+	const std::vector<VkPresentModeKHR>& GetSupportedPresentModes();
+
+	static const char* GetPresentModeName(VkPresentModeKHR presentMode);
+
 private:
 
 	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
@@ -61,8 +72,13 @@ private:
 
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window);
 
+	// What the lighting writes and the UI shows, one per frame in flight at m_Extent and m_SurfaceFormat
+	void CreateSceneImages(VmaAllocator allocator, VkDevice device, const QueueFamilyIndices& queueFamilyIndices);
+
 	VkFormat m_SurfaceFormat;
 	VkPresentModeKHR m_PresentMode;
+	VkPresentModeKHR m_RequestedPresentMode;
+	std::vector<VkPresentModeKHR> m_SupportedPresentModes;
 	VkExtent2D m_Extent;
 	VkSwapchainKHR m_SwapchainKHR = VK_NULL_HANDLE;
 	std::vector<VkImage> m_Images;
@@ -70,7 +86,5 @@ private:
 	std::vector<Image> m_RTImages;
 	std::vector<VkSampler> m_Sampler;
 	std::vector<VkDescriptorSet> m_ImGuiDescriptor;
-	std::vector<VkFramebuffer> m_Framebuffers;
-	std::vector<VkFramebuffer> m_FinalFramebuffers;
 };
 
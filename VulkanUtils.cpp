@@ -209,6 +209,20 @@ uint32_t VulkanUtils::alignedSize(uint32_t size, uint32_t align)
     return ((size - 1) / align + 1) * align;
 }
 
+VkRenderingAttachmentInfo VulkanUtils::RenderingAttachmentInfo(VkImageView imageView, VkImageLayout imageLayout, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp, VkClearValue clearValue)
+{
+    VkRenderingAttachmentInfo renderingAttachmentInfo{};
+    renderingAttachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    renderingAttachmentInfo.imageView = imageView;
+    renderingAttachmentInfo.imageLayout = imageLayout;
+    renderingAttachmentInfo.resolveMode = VK_RESOLVE_MODE_NONE;
+    renderingAttachmentInfo.loadOp = loadOp;
+    renderingAttachmentInfo.storeOp = storeOp;
+    renderingAttachmentInfo.clearValue = clearValue;
+
+    return renderingAttachmentInfo;
+}
+
 std::string VulkanUtils::boolToString(bool b)
 {
     return (b == 0 ? "false" : "true");
@@ -23,6 +23,9 @@ public:
 
 	static uint32_t alignedSize(uint32_t size, uint32_t align);
 
+	// One attachment of vkCmdBeginRendering, the image is expected in imageLayout already
+	static VkRenderingAttachmentInfo RenderingAttachmentInfo(VkImageView imageView, VkImageLayout imageLayout, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp, VkClearValue clearValue = {});
+
 private:
 	static std::string boolToString(bool b);
 };
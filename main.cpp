@@ -1,12 +1,57 @@
 #include <iostream>
 #include <chrono>
+#include <sstream>
 #include "Renderer.h"
 
+// --headless [--frames N] [--capture 1,60,120] [--output directory]
+// --benchmark camera_path.json [--warmup N] [--benchmark-output file.json], windowed or with --headless
+// --cpu-trace file.json records CPU zones from the start, loading included, and writes them on exit
+static void ParseArguments(int argc, char* argv[], HeadlessSettings& headless, BenchmarkSettings& benchmark, std::string& cpuTracePath)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--headless")
+            headless.enabled = true;
+        else if (argument == "--frames" && hasValue)
+            headless.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (argument == "--output" && hasValue)
+            headless.outputDirectory = argv[++i];
+        else if (argument == "--benchmark" && hasValue)
+            benchmark.cameraPath = argv[++i];
+        else if (argument == "--warmup" && hasValue)
+            benchmark.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (argument == "--benchmark-output" && hasValue)
+            benchmark.outputPath = argv[++i];
+        else if (argument == "--cpu-trace" && hasValue)
+            cpuTracePath = argv[++i];
+        else if (argument == "--capture" && hasValue)
+        {
+            std::stringstream frames(argv[++i]);
+            std::string frame;
+            while (std::getline(frames, frame, ','))
+                headless.capturedFrames.insert(std::stoull(frame));
+        }
+        else
+            std::cout << "Unknown argument " << argument << " ignored" << '\n';
+    }
+}
+
 int main(int argc, char* argv[]) 
 {
+    HeadlessSettings headless;
+    BenchmarkSettings benchmark;
+    std::string cpuTracePath;
+    ParseArguments(argc, argv, headless, benchmark, cpuTracePath);
+
+    CpuProfiler::SetThreadName("Main");
+    CpuProfiler::SetEnabled(!cpuTracePath.empty());
+
     system(".\\CompileShaders");
 
-    Renderer renderer = Renderer("MyFirstVulkanApp", VK_MAKE_API_VERSION(0, 1, 3, 0), "MyEngine", VK_MAKE_API_VERSION(0, 1, 3, 0), int(1280), int(720));
+    Renderer renderer = Renderer("MyFirstVulkanApp", VK_MAKE_API_VERSION(0, 1, 3, 0), "MyEngine", VK_MAKE_API_VERSION(0, 1, 3, 0), int(1280), int(720), headless, benchmark);
 
     //double fpsMoy;
     //double alpha = 0.005;
@@ -38,5 +83,8 @@ int main(int argc, char* argv[])
         */
     }
 
+    if (!cpuTracePath.empty())
+        CpuProfiler::ExportChromeTrace(cpuTracePath);
+
 	return 0;
 }
\ No newline at end of file